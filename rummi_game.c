@@ -6,6 +6,8 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -13,70 +15,235 @@
 #include <sys/time.h>
 #include <time.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 // ----------------------------------------------------------------------
 // Macros
 // ----------------------------------------------------------------------
-#define NUM_JUGADORES 4          // Número fijo de jugadores
-#define MAX_FICHAS 108           // Total fichas en el mazo (standard para Rummy)
-// Tiempo por turno en segundos (modificable)
-int QUANTUM = 20;
+#define MAX_JUGADORES 8          // Jugadores por partida como máximo (las reglas fijan cuántos)
+#define QUANTUM_INICIAL 20 // Tiempo por turno en segundos (el planificador lo ajusta)
 #define PUNTOS_MINIMOS_APEADA 30 // Mínimo para primera apeada
 
-#define FICHAS_INICIALES 14 // Fichas al repartir (puede variar según reglas)
-#define MAX_COLOR 15        // Longitud máxima para nombre de color
 #define MAX_NOMBRE 50       // Longitud máxima para nombre jugador
+#define INTERVALO_PCB_MS 500 // Cada cuánto vuelca el escritor de PCBs a disco
 
 #define MAX_FICHAS_GRUPO 4     // Máximo fichas en grupo (ej: 4 sietes)
 #define MAX_FICHAS_ESCALERA 13 // Máximo en escalera (A-2-...-K)
-#define MAX_GRUPOS 10          // Máximo grupos en mesa
-#define MAX_ESCALERAS 10       // Máximo escaleras en mesa
 #define VALOR_COMODIN 0        // Valor numérico para comodines
 #define MIN_FICHAS_GRUPO 3     // Mínimo fichas para un grupo
 #define MIN_FICHAS_ESCALERA 3  // Mínimo fichas para escalera
 
+#define NUM_COLORES 4                                  // Colores de fichas normales
+#define NUM_RANGOS 13                                  // Números por color (1-13)
+#define FICHAS_POR_JUEGO (NUM_COLORES * NUM_RANGOS)    // 52 fichas por juego completo
+#define MAX_BARAJAS 2                                  // Juegos completos en el mazo como máximo
+#define MAX_COMODINES 4                                // Comodines en el mazo como máximo
+#define PRIMER_COMODIN (MAX_BARAJAS * FICHAS_POR_JUEGO) // ID del primer comodín (104)
+#define MAX_FICHAS (PRIMER_COMODIN + MAX_COMODINES)    // Fichas en el mazo más grande (108)
+
+// Toda combinación tiene al menos tres fichas: ni una mano ni la mesa pueden
+// juntar más de MAX_FICHAS / 3 grupos o escaleras
+#define MAX_GRUPOS (MAX_FICHAS / MIN_FICHAS_GRUPO)
+#define MAX_ESCALERAS (MAX_FICHAS / MIN_FICHAS_ESCALERA)
+#define CAPACIDAD_INICIAL_BANCO 4 // Combinaciones reservadas al empezar; el banco crece solo
+
+// Reglas por defecto: cuatro jugadores, 14 fichas cada uno, dos barajas y cuatro comodines
+#define REGLAS_ESTANDAR {4, 14, 2, 4}
+
 #define TURNO_MAXIMO 30 // 30 segundos por turno
 
+// Las manos, la mesa y la memo de apeadas (lo que usan los núcleos que mide
+// --benchmark) piden memoria con asignar, asignar_ceros y reasignar: cada
+// asignación que tiene éxito suma uno al contador de su hilo
+static __thread uint64_t asignaciones_hilo;
+
+static inline void *contar_asignacion(void *memoria)
+{
+    if (memoria != NULL)
+        asignaciones_hilo++;
+    return memoria;
+}
+
+static inline void *asignar(size_t tamano)
+{
+    return contar_asignacion(malloc(tamano));
+}
+
+static inline void *asignar_ceros(size_t cantidad, size_t tamano)
+{
+    return contar_asignacion(calloc(cantidad, tamano));
+}
+
+static inline void *reasignar(void *memoria, size_t tamano)
+{
+    return contar_asignacion(realloc(memoria, tamano));
+}
+
 // ----------------------------------------------------------------------
 // Estructuras y Tipos
 // ----------------------------------------------------------------------
 
+typedef enum
+{
+    ROJO,
+    NEGRO,
+    AZUL,
+    AMARILLO,
+    COLOR_COMODIN
+} color_t;
+
+// Ficha codificada en un byte: ID 0..107 que distingue las dos copias físicas.
+// Fichas normales: copia * 52 + color * 13 + (numero - 1). IDs 104..107: comodines.
+typedef uint8_t ficha_t;
+
+// Número de la ficha (1-13), VALOR_COMODIN para comodines
+static inline int ficha_numero(ficha_t ficha)
+{
+    return ficha >= PRIMER_COMODIN ? VALOR_COMODIN : ficha % NUM_RANGOS + 1;
+}
+
+// Color de la ficha, COLOR_COMODIN para comodines
+static inline color_t ficha_color(ficha_t ficha)
+{
+    return ficha >= PRIMER_COMODIN ? COLOR_COMODIN : (color_t)((ficha / NUM_RANGOS) % NUM_COLORES);
+}
+
+// Construye el ID de una ficha normal a partir de copia (0-1), color y número (1-13)
+static inline ficha_t ficha_crear(int copia, color_t color, int numero)
+{
+    return (ficha_t)(copia * FICHAS_POR_JUEGO + color * NUM_RANGOS + (numero - 1));
+}
+
+// Nombre del color; solo se usa al mostrar fichas
+static inline const char *ficha_nombre_color(ficha_t ficha)
+{
+    static const char *nombres[] = {"rojo", "negro", "azul", "amarillo", "comodin"};
+    return nombres[ficha_color(ficha)];
+}
+
+// Mano en bits: dos capas de 52 bits indexadas por color * 13 + (numero - 1).
+// capas[0] marca las fichas presentes al menos una vez, capas[1] las que tienen ambas copias.
 typedef struct
 {
-    int numero;            // Valor numérico de la ficha (1-13 para valores normales)
-    char color[MAX_COLOR]; // Color de la ficha (ej: "rojo", "azul", "comodín")
-} ficha_t;
+    uint64_t capas[2]; // Presencia de primera y segunda copia
+    int comodines;     // Comodines en la mano
+    uint64_t zobrist;  // Hash de Zobrist de las capas y los comodines (ver bits_agregar)
+} mano_bits_t;
 
 typedef struct
 {
-    ficha_t *fichas; // Array dinámico de fichas
-    int cantidad;    // Fichas actuales en mano
-    int capacidad;   // Capacidad máxima actual del array
+    ficha_t *fichas;  // Array dinámico de fichas
+    int cantidad;     // Fichas actuales en mano
+    int capacidad;    // Capacidad máxima actual del array
+    mano_bits_t bits; // Conteo en bits, se mantiene al agregar/remover fichas
 } mano_t;
 
 typedef struct
 {
     ficha_t fichas[MAX_FICHAS_GRUPO]; // Array estático para grupo (ej: 4 fichas igual número)
-    int cantidad;                     // Fichas actuales en el grupo
+    uint8_t cantidad;                 // Fichas actuales en el grupo
 } grupo_t;
 
 typedef struct
 {
     ficha_t fichas[MAX_FICHAS_ESCALERA]; // Array estático para escalera (ej: 3+ fichas consecutivas mismo color)
-    int cantidad;                        // Fichas actuales en la escalera
+    uint8_t cantidad;                    // Fichas actuales en la escalera
 } escalera_t;
 
+// Índice de embones de la mesa: para cada ficha posible (52 normales y el comodín)
+// qué grupos y escaleras la aceptan. Solo se recalcula la combinación que cambia.
+#define INDICE_COMODIN FICHAS_POR_JUEGO // Clave del comodín en el índice
+
+_Static_assert(MAX_GRUPOS <= 64 && MAX_ESCALERAS <= 64, "el índice de embones usa máscaras de 64 bits");
+
 typedef struct
 {
-    grupo_t *grupos;       // Array dinámico de grupos en mesa
-    escalera_t *escaleras; // Array dinámico de escaleras en mesa
-    int total_grupos;      // Grupos actuales
-    int total_escaleras;   // Escaleras actuales
+    uint64_t grupos[FICHAS_POR_JUEGO + 1];    // Bit g: el grupo g acepta la ficha
+    uint64_t escaleras[FICHAS_POR_JUEGO + 1]; // Bit e: la escalera e acepta la ficha
+    uint64_t aceptadas;                       // Bit k: alguna combinación acepta la ficha k
+    uint64_t grupos_con_comodin;              // Combinaciones de donde se puede mover un comodín
+    uint64_t escaleras_con_comodin;
+    uint64_t grupos_con_espacio;              // Combinaciones que aún no están completas
+    uint64_t escaleras_con_espacio;
+} indice_embon_t;
+
+typedef struct
+{
+    grupo_t *grupos;         // Array dinámico de grupos en mesa (crece con banco_reservar)
+    escalera_t *escaleras;   // Array dinámico de escaleras en mesa
+    int total_grupos;        // Grupos actuales
+    int total_escaleras;     // Escaleras actuales
+    int capacidad_grupos;    // Lugares reservados en grupos
+    int capacidad_escaleras; // Lugares reservados en escaleras
+    indice_embon_t indice;   // Qué combinación acepta cada ficha (ver indice_actualizar_*)
+    uint64_t zobrist;            // Hash de Zobrist de la mesa (se rehace con el índice)
+    uint64_t *zobrist_grupos;    // Aporte de cada grupo a zobrist
+    uint64_t *zobrist_escaleras; // Aporte de cada escalera a zobrist
 } banco_de_apeadas_t;
 
+// Estado del generador pseudoaleatorio xoshiro256** (uno por partida)
+typedef struct
+{
+    uint64_t s[4];
+} generador_t;
+
+// Bitácora binaria de eventos: registros de 8 bytes que solo se agregan al final
+// del archivo. Con la semilla y los eventos se rearma la partida (--reproducir).
+typedef enum
+{
+    EVENTO_PARTIDA = 1, // Nueva partida; el registro siguiente guarda la semilla (uint64_t)
+    EVENTO_REPARTO,     // ficha repartida a jugador al iniciar
+    EVENTO_ROBO,        // ficha robada del mazo
+    EVENTO_APEADA,      // ficha: fichas colocadas (0 si no alcanzó); dato: grupos << 4 | escaleras (hasta 15)
+    EVENTO_EMBON,       // ficha embonada en la mesa
+    EVENTO_COMODIN,     // Se movió un comodín de la mesa para embonar ficha
+    EVENTO_ESTADO,      // dato: nuevo estado del PCB de jugador
+    EVENTO_FIN          // jugador: ganador (0 si no hay); dato: 1 si se decidió por puntos
+} tipo_evento_t;
+
+typedef struct
+{
+    uint32_t tiempo_us; // Desde que se abrió la bitácora (da la vuelta cada ~71 min)
+    uint8_t tipo;
+    uint8_t jugador;
+    uint8_t ficha;
+    uint8_t dato;
+} evento_t;
+
+_Static_assert(sizeof(evento_t) == sizeof(uint64_t), "la semilla ocupa exactamente un registro");
+
+typedef struct
+{
+    uint32_t magico;
+    uint16_t version;
+    uint16_t tamano_evento;
+    uint32_t num_jugadores;
+    uint8_t fichas_iniciales; // Resto de las reglas: sin ellas no se rearma el reparto
+    uint8_t barajas;
+    uint8_t comodines;
+    uint8_t relleno;
+} cabecera_bitacora_t;
+
 typedef struct
 {
+    FILE *archivo;          // Con búfer propio: registrar un evento no hace llamadas al sistema
+    struct timespec inicio; // Origen de tiempo_us
+} bitacora_t;
+
+typedef struct contexto_juego contexto_juego_t;
+
+typedef struct
+{
+    contexto_juego_t *contexto; // Partida a la que pertenece el jugador
     mano_t mano;             // Fichas en mano del jugador
     char nombre[MAX_NOMBRE]; // Nombre del jugador
     int id;                  // Identificador único
@@ -92,12 +259,14 @@ typedef struct
     int cantidad;               // Fichas actuales en el mazo
 } mazo_t;
 
+// Capacidad fija en línea: buscar y devolver una apeada no usa memoria dinámica.
+// MAX_GRUPOS y MAX_ESCALERAS alcanzan para cualquier mano.
 typedef struct
 {
-    grupo_t *grupos;       // Array dinámico de grupos en mesa
-    escalera_t *escaleras; // Array dinámico de escaleras en mesa
-    int total_grupos;      // Grupos actuales
-    int total_escaleras;   // Escaleras actuales
+    grupo_t grupos[MAX_GRUPOS];          // Grupos de la apeada
+    escalera_t escaleras[MAX_ESCALERAS]; // Escaleras de la apeada
+    int total_grupos;                    // Grupos actuales
+    int total_escaleras;                 // Escaleras actuales
 } apeada_t;
 
 // Estados posibles de un jugador
@@ -132,43 +301,533 @@ typedef struct
     
 } pcb_t;
 
+// Cola de listos sin cerrojos: varios productores (el hilo de esperas, quien
+// reencola jugadores) y un solo consumidor (siguiente_turno). Es un anillo acotado
+// con un número de secuencia por celda. Para quitar a un jugador no se toca el
+// anillo: su marca pasa a QUITADO y el consumidor descarta la celda al llegar a
+// ella. Si vuelve a encolarse antes, recupera esa misma celda (y su lugar), así
+// que cada jugador ocupa a lo sumo una celda y el anillo nunca se llena.
+#define CAPACIDAD_COLA_LISTOS MAX_JUGADORES // Una celda por asiento
+
+// Marca de cada jugador: generación (múltiplo de MARCA_GENERACION) y estado
+#define MARCA_FUERA 0u   // Sin celda en el anillo
+#define MARCA_EN_COLA 1u // Su celda de esta generación está en la cola
+#define MARCA_QUITADO 2u // Su celda sigue en el anillo, pero el consumidor la descarta
+#define MARCA_ESTADO 3u
+#define MARCA_GENERACION 4u
+
+typedef struct
+{
+    uint64_t secuencia; // pos + 1: lista para leer; pos + capacidad: libre para la siguiente vuelta
+    int id_jugador;
+    uint32_t marca;     // Generación del jugador al encolarlo, con MARCA_EN_COLA
+} celda_listos_t;
+
+typedef struct
+{
+    celda_listos_t celdas[CAPACIDAD_COLA_LISTOS];
+    _Alignas(64) uint64_t cola;   // Próxima posición a escribir (productores, con CAS)
+    _Alignas(64) uint64_t cabeza; // Próxima posición a leer (solo el consumidor)
+    uint32_t marcas[MAX_JUGADORES]; // Ver MARCA_*
+    int cantidad;                   // Jugadores en la cola (aproximado mientras cambia)
+} cola_listos_t;
+
+// Reglas de una partida. Las barajas son una o dos porque la mano en bits y el
+// solucionador de apeadas distinguen solo dos copias de cada ficha.
+typedef struct
+{
+    int num_jugadores;    // 2..MAX_JUGADORES
+    int fichas_iniciales; // Fichas que recibe cada jugador al repartir
+    int barajas;          // 1..MAX_BARAJAS juegos completos de 52 fichas
+    int comodines;        // 0..MAX_COMODINES
+} reglas_t;
+
+// Estado completo de una partida: cada partida tiene el suyo, así varias pueden
+// jugarse a la vez en el mismo proceso (una por hilo en los torneos). Los
+// arreglos por jugador tienen lugar para MAX_JUGADORES; se usan los primeros
+// reglas.num_jugadores.
+struct contexto_juego
+{
+    reglas_t reglas;                    // Jugadores, reparto y composición del mazo
+    jugador_t jugadores[MAX_JUGADORES]; // Jugadores de la partida
+    pcb_t pcbs[MAX_JUGADORES];          // PCBs (estadísticas)
+    banco_de_apeadas_t banco_apeadas;   // Banco de combinaciones (grupos/escaleras)
+    mazo_t mazo;                        // Mazo de fichas
+
+    // Scheduler (planificador)
+    char modo;                           // Modo de scheduling: 'F' (FCFS) o 'R' (Round Robin)
+    int quantum;                         // Tiempo por turno en segundos
+    cola_listos_t listos;                // Jugadores listos para jugar (sin cerrojos)
+    int cola_de_esperas[MAX_JUGADORES];  // Cola de jugadores de_esperas
+    int num_de_esperas;                  // Contador de jugadores en espera
+    int turno_actual;                    // Turno actual (índice del jugador)
+    int proceso_en_ejecucion;            // ID del proceso en ejecución
+    int turnos_terminados;               // Turnos completados (lo espera el planificador)
+    struct timespec fin_de_espera[MAX_JUGADORES]; // Plazo (monotónico) para volver a LISTO
+    uint64_t inicio_estado_ns[MAX_JUGADORES];     // Cuándo entró cada PCB a su estado (con --histogramas)
+
+    volatile bool terminado; // Flag para terminar el juego
+    bool silencioso;         // Suprime los mensajes de juego (simulación por lotes)
+    uint64_t semilla;        // Semilla con la que se sembró el generador (para repetir la partida)
+    generador_t generador;   // Generador propio: barajar y tiempos de espera
+    bitacora_t *bitacora;    // Bitácora de eventos (NULL: no se registra)
+    int bots_mcts;           // Los jugadores 1..bots_mcts los juega el bot MCTS (--mcts)
+};
+
 // Nuevo struct para pasar datos a los hilos
 typedef struct
 {
     volatile bool *terminar_flag;
     pthread_mutex_t *mutex;
     pthread_cond_t *cond;
+    contexto_juego_t *contexto;
 } hilo_control_t;
 
+// ----------------------------------------------------------------------
+// Perfil de contención de cerrojos
+// ----------------------------------------------------------------------
+
+// Con --perfil-cerrojos cada lock, trylock, unlock y cond_wait del programa
+// pasa por estas envolturas (cerrojo_tomar y las demás macros de abajo, que
+// agregan la función y la línea de la llamada). Cuentan por cerrojo y por sitio
+// de llamada: adquisiciones, cuántas lo encontraron tomado, trylocks fallidos,
+// tiempo esperando y tiempo retenido. Sin la opción solo cuesta leer una
+// bandera antes de la llamada real.
+//
+// Un cerrojo se identifica por su dirección (perfil_nombrar_cerrojo le da
+// nombre; los que no lo tienen se cuentan como "otro") y un sitio por función y
+// línea. Los contadores son atómicos; lo que cada hilo tiene tomado va en una
+// pila propia.
+
+#define PERFIL_MAX_CERROJOS 32 // Direcciones con nombre
+#define PERFIL_MAX_NOMBRES 16  // Nombres distintos (varias direcciones pueden compartirlo)
+#define PERFIL_MAX_SITIOS 512  // Tabla hash de sitios (función, línea, cerrojo)
+#define PERFIL_MAX_TOMADOS 32  // Cerrojos tomados a la vez por un hilo
+#define PERFIL_SITIOS_INFORME 10
+
+typedef struct
+{
+    uint32_t clave;      // línea * PERFIL_MAX_NOMBRES + nombre + 1; 0: libre
+    const char *funcion; // Se publica justo después de la clave (en los totales: el cerrojo)
+    uint64_t adquisiciones;
+    uint64_t contendidas;   // Estaba tomado: hubo que esperar
+    uint64_t fallos_trylock;
+    uint64_t espera_ns;
+    uint64_t espera_max_ns;
+    uint64_t retencion_ns;
+    uint64_t retencion_max_ns;
+} perfil_sitio_t;
+
+typedef struct
+{
+    const void *cerrojo;
+    perfil_sitio_t *sitio;
+    uint64_t desde_ns;
+} perfil_tomado_t;
+
+static bool perfil_cerrojos_activo; // Se fija antes de crear los hilos
+static const void *perfil_direcciones[PERFIL_MAX_CERROJOS];
+static int perfil_nombre_de[PERFIL_MAX_CERROJOS];
+static int perfil_num_direcciones;
+static const char *perfil_nombres[PERFIL_MAX_NOMBRES] = {"otro"};
+static int perfil_num_nombres = 1;
+static perfil_sitio_t perfil_sitios[PERFIL_MAX_SITIOS];
+static __thread perfil_tomado_t perfil_tomados[PERFIL_MAX_TOMADOS];
+static __thread int perfil_num_tomados;
+
+static inline uint64_t perfil_reloj_ns(void)
+{
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return (uint64_t)ahora.tv_sec * 1000000000ULL + (uint64_t)ahora.tv_nsec;
+}
+
+// Registra el nombre del cerrojo en la dirección dada, antes de que se use. Solo
+// el hilo principal registra; la entrada se publica antes que el contador, así
+// los demás hilos pueden buscar mientras tanto.
+void perfil_nombrar_cerrojo(const void *cerrojo, const char *nombre)
+{
+    int num_nombres = perfil_num_nombres;
+    int n = 0;
+    while (n < num_nombres && strcmp(perfil_nombres[n], nombre) != 0)
+        n++;
+    if (n == num_nombres)
+    {
+        if (num_nombres == PERFIL_MAX_NOMBRES)
+            return;
+        perfil_nombres[n] = nombre;
+        __atomic_store_n(&perfil_num_nombres, num_nombres + 1, __ATOMIC_RELEASE);
+    }
+    int num_direcciones = perfil_num_direcciones;
+    if (num_direcciones < PERFIL_MAX_CERROJOS)
+    {
+        perfil_direcciones[num_direcciones] = cerrojo;
+        perfil_nombre_de[num_direcciones] = n;
+        __atomic_store_n(&perfil_num_direcciones, num_direcciones + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static int perfil_nombre_cerrojo(const void *cerrojo)
+{
+    int num_direcciones = __atomic_load_n(&perfil_num_direcciones, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < num_direcciones; i++)
+        if (perfil_direcciones[i] == cerrojo)
+            return perfil_nombre_de[i];
+    return 0;
+}
+
+// Sitio de la tabla para este cerrojo en esta línea; lo crea con CAS si es nuevo
+static perfil_sitio_t *perfil_sitio(const void *cerrojo, const char *funcion, int linea)
+{
+    uint32_t clave = (uint32_t)linea * PERFIL_MAX_NOMBRES + (uint32_t)perfil_nombre_cerrojo(cerrojo) + 1;
+
+    for (uint32_t i = 0; i < PERFIL_MAX_SITIOS; i++)
+    {
+        perfil_sitio_t *sitio = &perfil_sitios[(clave * 2654435761u + i) % PERFIL_MAX_SITIOS];
+        uint32_t actual = __atomic_load_n(&sitio->clave, __ATOMIC_ACQUIRE);
+        if (actual == 0 &&
+            __atomic_compare_exchange_n(&sitio->clave, &actual, clave, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&sitio->funcion, funcion, __ATOMIC_RELEASE);
+            return sitio;
+        }
+        if (actual == clave)
+            return sitio;
+    }
+    return NULL; // Tabla llena: el sitio no se cuenta
+}
+
+static inline void perfil_maximo(uint64_t *maximo, uint64_t valor)
+{
+    uint64_t actual = __atomic_load_n(maximo, __ATOMIC_RELAXED);
+    while (valor > actual &&
+           !__atomic_compare_exchange_n(maximo, &actual, valor, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Anota una adquisición y deja el cerrojo en la pila del hilo para medir cuánto se retiene
+static void perfil_adquirido(const void *cerrojo, perfil_sitio_t *sitio, bool contendido, uint64_t espera_ns)
+{
+    if (sitio != NULL)
+    {
+        __atomic_fetch_add(&sitio->adquisiciones, 1, __ATOMIC_RELAXED);
+        if (contendido)
+        {
+            __atomic_fetch_add(&sitio->contendidas, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&sitio->espera_ns, espera_ns, __ATOMIC_RELAXED);
+            perfil_maximo(&sitio->espera_max_ns, espera_ns);
+        }
+    }
+    if (perfil_num_tomados < PERFIL_MAX_TOMADOS)
+        perfil_tomados[perfil_num_tomados++] = (perfil_tomado_t){cerrojo, sitio, perfil_reloj_ns()};
+}
+
+// Saca el cerrojo de la pila del hilo y anota cuánto lo retuvo. Devuelve el
+// sitio donde se tomó (NULL si no estaba en la pila).
+static perfil_sitio_t *perfil_liberado(const void *cerrojo)
+{
+    for (int i = perfil_num_tomados - 1; i >= 0; i--)
+    {
+        if (perfil_tomados[i].cerrojo != cerrojo)
+            continue;
+
+        perfil_sitio_t *sitio = perfil_tomados[i].sitio;
+        if (sitio != NULL)
+        {
+            uint64_t retencion = perfil_reloj_ns() - perfil_tomados[i].desde_ns;
+            __atomic_fetch_add(&sitio->retencion_ns, retencion, __ATOMIC_RELAXED);
+            perfil_maximo(&sitio->retencion_max_ns, retencion);
+        }
+        for (int j = i; j < perfil_num_tomados - 1; j++)
+            perfil_tomados[j] = perfil_tomados[j + 1];
+        perfil_num_tomados--;
+        return sitio;
+    }
+    return NULL;
+}
+
+// Primero intenta sin esperar: solo se mide la espera cuando el cerrojo estaba tomado
+static inline int perfil_mutex_lock(pthread_mutex_t *mutex, const char *funcion, int linea)
+{
+    if (!perfil_cerrojos_activo)
+        return pthread_mutex_lock(mutex);
+
+    perfil_sitio_t *sitio = perfil_sitio(mutex, funcion, linea);
+    if (pthread_mutex_trylock(mutex) == 0)
+    {
+        perfil_adquirido(mutex, sitio, false, 0);
+        return 0;
+    }
+
+    uint64_t desde = perfil_reloj_ns();
+    int resultado = pthread_mutex_lock(mutex);
+    if (resultado == 0)
+        perfil_adquirido(mutex, sitio, true, perfil_reloj_ns() - desde);
+    return resultado;
+}
+
+static inline int perfil_mutex_trylock(pthread_mutex_t *mutex, const char *funcion, int linea)
+{
+    int resultado = pthread_mutex_trylock(mutex);
+    if (!perfil_cerrojos_activo)
+        return resultado;
+
+    perfil_sitio_t *sitio = perfil_sitio(mutex, funcion, linea);
+    if (resultado == 0)
+        perfil_adquirido(mutex, sitio, false, 0);
+    else if (sitio != NULL)
+        __atomic_fetch_add(&sitio->fallos_trylock, 1, __ATOMIC_RELAXED);
+    return resultado;
+}
+
+static inline int perfil_mutex_unlock(pthread_mutex_t *mutex)
+{
+    if (perfil_cerrojos_activo)
+        perfil_liberado(mutex);
+    return pthread_mutex_unlock(mutex);
+}
+
+static inline int perfil_rwlock_lock(pthread_rwlock_t *cerrojo, bool escritura, const char *funcion, int linea)
+{
+    if (!perfil_cerrojos_activo)
+        return escritura ? pthread_rwlock_wrlock(cerrojo) : pthread_rwlock_rdlock(cerrojo);
+
+    perfil_sitio_t *sitio = perfil_sitio(cerrojo, funcion, linea);
+    if ((escritura ? pthread_rwlock_trywrlock(cerrojo) : pthread_rwlock_tryrdlock(cerrojo)) == 0)
+    {
+        perfil_adquirido(cerrojo, sitio, false, 0);
+        return 0;
+    }
+
+    uint64_t desde = perfil_reloj_ns();
+    int resultado = escritura ? pthread_rwlock_wrlock(cerrojo) : pthread_rwlock_rdlock(cerrojo);
+    if (resultado == 0)
+        perfil_adquirido(cerrojo, sitio, true, perfil_reloj_ns() - desde);
+    return resultado;
+}
+
+static inline int perfil_rwlock_unlock(pthread_rwlock_t *cerrojo)
+{
+    if (perfil_cerrojos_activo)
+        perfil_liberado(cerrojo);
+    return pthread_rwlock_unlock(cerrojo);
+}
+
+// La espera en la condición no cuenta como retención: el mutex se suelta al
+// dormir y la retención vuelve a contar, para el mismo sitio, al despertar
+static void perfil_retomado(pthread_mutex_t *mutex, perfil_sitio_t *sitio)
+{
+    if (perfil_num_tomados < PERFIL_MAX_TOMADOS)
+        perfil_tomados[perfil_num_tomados++] = (perfil_tomado_t){mutex, sitio, perfil_reloj_ns()};
+}
+
+static inline int perfil_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    if (!perfil_cerrojos_activo)
+        return pthread_cond_wait(cond, mutex);
+
+    perfil_sitio_t *sitio = perfil_liberado(mutex);
+    int resultado = pthread_cond_wait(cond, mutex);
+    perfil_retomado(mutex, sitio);
+    return resultado;
+}
+
+static inline int perfil_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *plazo)
+{
+    if (!perfil_cerrojos_activo)
+        return pthread_cond_timedwait(cond, mutex, plazo);
+
+    perfil_sitio_t *sitio = perfil_liberado(mutex);
+    int resultado = pthread_cond_timedwait(cond, mutex, plazo);
+    perfil_retomado(mutex, sitio);
+    return resultado;
+}
+
+static int comparar_sitios_por_espera(const void *a, const void *b)
+{
+    const perfil_sitio_t *x = *(const perfil_sitio_t *const *)a;
+    const perfil_sitio_t *y = *(const perfil_sitio_t *const *)b;
+    return (x->espera_ns < y->espera_ns) - (x->espera_ns > y->espera_ns);
+}
+
+// Totales por cerrojo, ordenados por tiempo de espera, y los sitios que más esperaron
+void perfil_cerrojos_informe(FILE *salida)
+{
+    if (!perfil_cerrojos_activo)
+        return;
+
+    perfil_sitio_t totales[PERFIL_MAX_NOMBRES];
+    perfil_sitio_t *orden[PERFIL_MAX_SITIOS];
+    int num_sitios = 0;
+
+    memset(totales, 0, sizeof(totales));
+    for (int n = 0; n < perfil_num_nombres; n++)
+        totales[n].funcion = perfil_nombres[n];
+
+    for (int i = 0; i < PERFIL_MAX_SITIOS; i++)
+    {
+        perfil_sitio_t *sitio = &perfil_sitios[i];
+        if (__atomic_load_n(&sitio->clave, __ATOMIC_ACQUIRE) == 0)
+            continue;
+
+        perfil_sitio_t *total = &totales[(sitio->clave - 1) % PERFIL_MAX_NOMBRES];
+        total->adquisiciones += __atomic_load_n(&sitio->adquisiciones, __ATOMIC_RELAXED);
+        total->contendidas += __atomic_load_n(&sitio->contendidas, __ATOMIC_RELAXED);
+        total->fallos_trylock += __atomic_load_n(&sitio->fallos_trylock, __ATOMIC_RELAXED);
+        total->espera_ns += __atomic_load_n(&sitio->espera_ns, __ATOMIC_RELAXED);
+        total->retencion_ns += __atomic_load_n(&sitio->retencion_ns, __ATOMIC_RELAXED);
+        uint64_t espera_max = __atomic_load_n(&sitio->espera_max_ns, __ATOMIC_RELAXED);
+        uint64_t retencion_max = __atomic_load_n(&sitio->retencion_max_ns, __ATOMIC_RELAXED);
+        if (espera_max > total->espera_max_ns)
+            total->espera_max_ns = espera_max;
+        if (retencion_max > total->retencion_max_ns)
+            total->retencion_max_ns = retencion_max;
+        orden[num_sitios++] = sitio;
+    }
+
+    perfil_sitio_t *orden_totales[PERFIL_MAX_NOMBRES];
+    for (int n = 0; n < perfil_num_nombres; n++)
+        orden_totales[n] = &totales[n];
+    qsort(orden_totales, (size_t)perfil_num_nombres, sizeof(perfil_sitio_t *), comparar_sitios_por_espera);
+    qsort(orden, (size_t)num_sitios, sizeof(perfil_sitio_t *), comparar_sitios_por_espera);
+
+    fprintf(salida, "\n=== Contención de cerrojos ===\n");
+    fprintf(salida, "%-24s %10s %10s %6s %10s %12s %12s %12s %12s\n", "cerrojo", "adquis.", "contend.", "%",
+            "fallos_try", "espera_ms", "esp_max_us", "reten_ms", "ret_max_us");
+    for (int n = 0; n < perfil_num_nombres; n++)
+    {
+        const perfil_sitio_t *t = orden_totales[n];
+        if (t->adquisiciones == 0 && t->fallos_trylock == 0)
+            continue;
+        fprintf(salida, "%-24s %10llu %10llu %5.1f%% %10llu %12.3f %12.1f %12.3f %12.1f\n", t->funcion,
+                (unsigned long long)t->adquisiciones, (unsigned long long)t->contendidas,
+                t->adquisiciones ? 100.0 * t->contendidas / t->adquisiciones : 0.0,
+                (unsigned long long)t->fallos_trylock, t->espera_ns / 1e6, t->espera_max_ns / 1e3,
+                t->retencion_ns / 1e6, t->retencion_max_ns / 1e3);
+    }
+
+    fprintf(salida, "\nSitios con más espera:\n");
+    int mostrados = 0;
+    for (int i = 0; i < num_sitios && mostrados < PERFIL_SITIOS_INFORME; i++)
+    {
+        const perfil_sitio_t *s = orden[i];
+        const char *funcion = __atomic_load_n(&s->funcion, __ATOMIC_ACQUIRE);
+        if (s->contendidas == 0 && s->fallos_trylock == 0)
+            continue;
+        mostrados++;
+        fprintf(salida, "  %-24s %s:%u  %llu de %llu contendidas, %llu trylocks fallidos, espera %.3f ms (máx %.1f us)\n",
+                perfil_nombres[(s->clave - 1) % PERFIL_MAX_NOMBRES], funcion ? funcion : "?", (s->clave - 1) / PERFIL_MAX_NOMBRES,
+                (unsigned long long)s->contendidas, (unsigned long long)s->adquisiciones,
+                (unsigned long long)s->fallos_trylock, s->espera_ns / 1e6, s->espera_max_ns / 1e3);
+    }
+    if (mostrados == 0)
+        fprintf(salida, "  (ningún cerrojo se encontró tomado)\n");
+}
+
+// Desde aquí, todo el programa toma y suelta cerrojos con estas envolturas
+#define cerrojo_tomar(mutex) perfil_mutex_lock((mutex), __func__, __LINE__)
+#define cerrojo_intentar(mutex) perfil_mutex_trylock((mutex), __func__, __LINE__)
+#define cerrojo_soltar(mutex) perfil_mutex_unlock(mutex)
+#define cerrojo_leer(cerrojo) perfil_rwlock_lock((cerrojo), false, __func__, __LINE__)
+#define cerrojo_escribir(cerrojo) perfil_rwlock_lock((cerrojo), true, __func__, __LINE__)
+#define cerrojo_rw_soltar(cerrojo) perfil_rwlock_unlock(cerrojo)
+#define condicion_esperar(cond, mutex) perfil_cond_wait((cond), (mutex))
+#define condicion_esperar_hasta(cond, mutex, plazo) perfil_cond_timedwait((cond), (mutex), (plazo))
+
 // ----------------------------------------------------------------------
 // Variables Globales
 // ----------------------------------------------------------------------
-jugador_t jugadores[NUM_JUGADORES];                            // Array de jugadores
-pcb_t pcbs[NUM_JUGADORES];                                     // Array de PCBs (estadísticas)
-banco_de_apeadas_t banco_apeadas;                              // Banco de combinaciones (grupos/escaleras)
-int turno_actual = 0;                                          // Turno actual (índice del jugador)
-volatile bool juego_terminado = false;                         // Flag para terminar el juego
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;             // Mutex general
-pthread_mutex_t mutex_terminacion = PTHREAD_MUTEX_INITIALIZER; // Mutex para la terminación del juego
-pthread_mutex_t mutex_mesa = PTHREAD_MUTEX_INITIALIZER;        // Mutex para el banco
-pthread_mutex_t mutex_juego = PTHREAD_MUTEX_INITIALIZER;       // Para estado general del juego
-pthread_mutex_t mutex_colas = PTHREAD_MUTEX_INITIALIZER;       // Para colas de procesos
-pthread_mutex_t mutex_pcbs = PTHREAD_MUTEX_INITIALIZER;        // Para estructuras PCB
-pthread_mutex_t mutex_cola_listos = PTHREAD_MUTEX_INITIALIZER; // Para colas de listos
+contexto_juego_t juego; // Partida interactiva
+
+// Cerrojos de la partida interactiva, uno por dominio. Quien necesite varios los
+// toma siempre en este orden y los suelta en el inverso:
+//   1. mutex_politica   modo, quantum y turnos_terminados (cond_turno)
+//   2. mutex_colas      cola de esperas y plazos (cond_esperas); los productores de la
+//                       cola de listos (que no usa cerrojo) la toman para avisar (cond_listos)
+//   3. cerrojo_mesa     banco_apeadas: lectores concurrentes, un solo escritor
+//   4. mutex_mazo       mazo
+//   5. mutex_manos[i]   mano y banderas del jugador i+1 (varios: por id creciente)
+//   6. mutex_pcbs       PCBs
+// Los mutex del escritor de PCBs, de la tabla compartida, de la bitácora y de
+// los trabajadores de jugadores son hojas: se toman con cualquiera de estos, nunca al revés. ctx->terminado se
+// escribe con mutex_politica y mutex_colas tomados; fuera de ellos se lee con
+// juego_terminado(). Las partidas simuladas son de un solo hilo y no usan cerrojos.
+pthread_mutex_t mutex_politica = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_colas = PTHREAD_MUTEX_INITIALIZER;
+pthread_rwlock_t cerrojo_mesa = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t mutex_mazo = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mutex_manos[MAX_JUGADORES];
+pthread_mutex_t mutex_pcbs = PTHREAD_MUTEX_INITIALIZER;
 
 // Variables para el scheduler (planificador)
-char modo = 'R';                                      // Modo de scheduling: 'F' (FCFS) o 'R' (Round Robin)
-int cola_listos[NUM_JUGADORES];                       // Cola de jugadores listos para jugar
-int frente = 0, final = 0;                            // Índices para la cola circular
-int cola_de_esperas[NUM_JUGADORES];                   // Cola de jugadores de_esperas
-int num_de_esperas = 0;                               // Contador de jugadores en espera
 pthread_t hilo_juego;                                 // Hilo del juego
-pthread_cond_t cond_turno = PTHREAD_COND_INITIALIZER; // Variable de condición para el juego
-int proceso_en_ejecucion = -1;                        // ID del proceso en ejecución
+pthread_cond_t cond_turno = PTHREAD_COND_INITIALIZER; // Terminó un turno (con mutex_politica)
+pthread_cond_t cond_listos;                           // Hay jugadores en la cola de listos (con mutex_colas)
+pthread_cond_t cond_esperas;                          // Cambió la cola de esperas (con mutex_colas, reloj monotónico)
 int tiempo_restante_quantum = 0;                      // Tiempo restante del proceso en ejecución
 
-mazo_t mazo;        // Mazo de fichas
-int num_listos = 0; // Número de jugadores en la cola de listos
+static inline bool juego_terminado(contexto_juego_t *ctx)
+{
+    return __atomic_load_n(&ctx->terminado, __ATOMIC_ACQUIRE);
+}
+
+static void bloquear_manos(void)
+{
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        cerrojo_tomar(&mutex_manos[i]);
+}
+
+static void desbloquear_manos(void)
+{
+    for (int i = MAX_JUGADORES - 1; i >= 0; i--)
+        cerrojo_soltar(&mutex_manos[i]);
+}
+
+// Toma todos los dominios (la mesa en lectura) para ver o copiar la partida completa
+static void bloquear_partida(void)
+{
+    cerrojo_tomar(&mutex_politica);
+    cerrojo_tomar(&mutex_colas);
+    cerrojo_leer(&cerrojo_mesa);
+    cerrojo_tomar(&mutex_mazo);
+    bloquear_manos();
+    cerrojo_tomar(&mutex_pcbs);
+}
+
+static void desbloquear_partida(void)
+{
+    cerrojo_soltar(&mutex_pcbs);
+    desbloquear_manos();
+    cerrojo_soltar(&mutex_mazo);
+    cerrojo_rw_soltar(&cerrojo_mesa);
+    cerrojo_soltar(&mutex_colas);
+    cerrojo_soltar(&mutex_politica);
+}
+
+// Cerrojos y condiciones que no tienen inicializador estático
+static void inicializar_cerrojos(void)
+{
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        pthread_mutex_init(&mutex_manos[i], NULL);
+    pthread_cond_init(&cond_turno, NULL);
+    pthread_cond_init(&cond_listos, NULL);
+
+    // Los plazos de espera son absolutos en el reloj monotónico
+    pthread_condattr_t atributos_cond;
+    pthread_condattr_init(&atributos_cond);
+    pthread_condattr_setclock(&atributos_cond, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_esperas, &atributos_cond);
+    pthread_condattr_destroy(&atributos_cond);
+}
+
+static void liberar_cerrojos(void)
+{
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        pthread_mutex_destroy(&mutex_manos[i]);
+    pthread_cond_destroy(&cond_turno);
+    pthread_cond_destroy(&cond_listos);
+    pthread_cond_destroy(&cond_esperas);
+}
 
 // ----------------------------------------------------------------------
 // Funciones de inicializacion y liberacion
@@ -176,17 +835,29 @@ int num_listos = 0; // Número de jugadores en la cola de listos
 
 // Prototipos de funciones
 void mano_inicializar(mano_t *mano, int capacidad);
+void agregar_ficha(mano_t *mano, ficha_t ficha);
 int kbhit();
-void agregar_a_cola_listos(int id_jugador);
-int siguiente_turno();
-void reiniciar_cola_listos();
+void cola_listos_inicializar(cola_listos_t *cola);
+bool cola_listos_encolar(cola_listos_t *cola, int id_jugador);
+int cola_listos_copiar(const cola_listos_t *cola, int ids[], int maximo);
+void agregar_a_cola_listos(contexto_juego_t *ctx, int id_jugador);
+void bloquear_jugador(contexto_juego_t *ctx, int id_jugador, int tiempo);
+int siguiente_turno(contexto_juego_t *ctx);
 void *jugador_thread(void *arg);
 bool puede_hacer_apeada(jugador_t *jugador);
 int calcular_puntos_apeada(const apeada_t *apeada);
-void verificar_cola_de_esperas();
 bool es_grupo_valido(const ficha_t fichas[], int cantidad);
 bool es_escalera_valida(const ficha_t fichas[], int cantidad);
+void indice_actualizar_grupo(banco_de_apeadas_t *banco, int g);
+void indice_actualizar_escalera(banco_de_apeadas_t *banco, int e);
+void banco_reservar(banco_de_apeadas_t *banco, int grupos, int escaleras);
 void mostrar_robo_ficha(const ficha_t *ficha, bool es_automatico); // Nueva función
+void escribir_pcb(pcb_t jugador);
+void bitacora_registrar(contexto_juego_t *ctx, tipo_evento_t tipo, int jugador, ficha_t ficha, int dato);
+void cambiar_estado(contexto_juego_t *ctx, int id_jugador, estado_jugador estado);
+void terminar_juego(contexto_juego_t *ctx);
+void actualizar_tabla_procesos(pcb_t jugadores[], int num_jugadores);
+bool turno_mcts(jugador_t *jugador);
 
 void mano_inicializar(mano_t *mano, int capacidad)
 {
@@ -196,7 +867,7 @@ void mano_inicializar(mano_t *mano, int capacidad)
         exit(EXIT_FAILURE);
     }
 
-    mano->fichas = (ficha_t *)malloc(sizeof(ficha_t) * capacidad);
+    mano->fichas = (ficha_t *)asignar(sizeof(ficha_t) * capacidad);
     if (mano->fichas == NULL)
     {
         fprintf(stderr, "Error al asignar memoria para la mano\n");
@@ -205,43 +876,85 @@ void mano_inicializar(mano_t *mano, int capacidad)
 
     mano->cantidad = 0;
     mano->capacidad = capacidad;
+    memset(&mano->bits, 0, sizeof(mano_bits_t));
+}
+
+// Fichas del mazo completo con estas reglas
+static inline int reglas_fichas_mazo(const reglas_t *reglas)
+{
+    return reglas->barajas * FICHAS_POR_JUEGO + reglas->comodines;
+}
+
+// Verifica que las reglas entren en las capacidades del programa y que el mazo
+// alcance para el reparto inicial
+bool reglas_validas(const reglas_t *reglas)
+{
+    return reglas->num_jugadores >= 2 && reglas->num_jugadores <= MAX_JUGADORES &&
+           reglas->barajas >= 1 && reglas->barajas <= MAX_BARAJAS &&
+           reglas->comodines >= 0 && reglas->comodines <= MAX_COMODINES &&
+           reglas->fichas_iniciales >= 1 &&
+           reglas->fichas_iniciales * reglas->num_jugadores <= reglas_fichas_mazo(reglas);
+}
+
+void mostrar_reglas(const reglas_t *reglas)
+{
+    printf("Reglas: %d jugadores, %d fichas iniciales, %d baraja(s), %d comodines (%d fichas)\n",
+           reglas->num_jugadores, reglas->fichas_iniciales, reglas->barajas, reglas->comodines,
+           reglas_fichas_mazo(reglas));
 }
 
-void inicializar_jugadores(mazo_t *mazo)
+// Deja el contexto listo para una partida nueva (sin fichas repartidas)
+void contexto_inicializar(contexto_juego_t *ctx, const reglas_t *reglas)
 {
-    if (mazo == NULL)
+    reglas_t copia = *reglas; // reglas puede apuntar dentro de ctx
+    memset(ctx, 0, sizeof(contexto_juego_t));
+    ctx->reglas = copia;
+    cola_listos_inicializar(&ctx->listos);
+    ctx->modo = 'R';
+    ctx->quantum = QUANTUM_INICIAL;
+    ctx->proceso_en_ejecucion = -1;
+}
+
+void inicializar_jugadores(contexto_juego_t *ctx)
+{
+    if (ctx == NULL)
     {
-        fprintf(stderr, "Error: Puntero a mazo inválido\n");
+        fprintf(stderr, "Error: Puntero a contexto inválido\n");
         exit(EXIT_FAILURE);
     }
 
+    jugador_t *jugadores = ctx->jugadores;
+    mazo_t *mazo = &ctx->mazo;
+    int fichas_iniciales = ctx->reglas.fichas_iniciales;
+
     // Verificar suficientes fichas para todos los jugadores
-    if (mazo->cantidad < FICHAS_INICIALES * NUM_JUGADORES)
+    if (mazo->cantidad < fichas_iniciales * ctx->reglas.num_jugadores)
     {
         fprintf(stderr, "Error: No hay suficientes fichas en el mazo (%d necesarias, %d disponibles)\n",
-                FICHAS_INICIALES * NUM_JUGADORES, mazo->cantidad);
+                fichas_iniciales * ctx->reglas.num_jugadores, mazo->cantidad);
         exit(EXIT_FAILURE);
     }
 
-    for (int i = 0; i < NUM_JUGADORES; i++)
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
     {
         // Inicializar datos básicos del jugador
+        jugadores[i].contexto = ctx;
         jugadores[i].id = i + 1; // IDs comienzan en 1
         snprintf(jugadores[i].nombre, MAX_NOMBRE, "Jugador %d", i + 1);
         jugadores[i].en_juego = true;
         jugadores[i].puntos_suficientes = false;
         jugadores[i].ficha_agregada = false;
-        jugadores[i].tiempo_restante = QUANTUM * 2; // Tiempo inicial por jugador
+        jugadores[i].tiempo_restante = ctx->quantum * 2; // Tiempo inicial por jugador
 
         // Inicializar mano
-        mano_inicializar(&jugadores[i].mano, FICHAS_INICIALES * 2); // Capacidad inicial doble
+        mano_inicializar(&jugadores[i].mano, fichas_iniciales * 2); // Capacidad inicial doble
 
         // Repartir fichas (tomando del final del mazo)
-        for (int j = 0; j < FICHAS_INICIALES; j++)
+        for (int j = 0; j < fichas_iniciales; j++)
         {
-            jugadores[i].mano.fichas[j] = mazo->fichas[mazo->cantidad - 1];
+            agregar_ficha(&jugadores[i].mano, mazo->fichas[mazo->cantidad - 1]);
+            bitacora_registrar(ctx, EVENTO_REPARTO, i + 1, mazo->fichas[mazo->cantidad - 1], 0);
             mazo->cantidad--;
-            jugadores[i].mano.cantidad++;
         }
     }
 }
@@ -254,38 +967,105 @@ void banco_inicializar(banco_de_apeadas_t *banco)
         exit(EXIT_FAILURE);
     }
 
-    banco->grupos = (grupo_t *)malloc(sizeof(grupo_t) * MAX_GRUPOS);
-    if (banco->grupos == NULL)
-    {
-        fprintf(stderr, "Error al asignar memoria para los grupos del banco\n");
-        exit(EXIT_FAILURE);
-    }
-
-    banco->escaleras = (escalera_t *)malloc(sizeof(escalera_t) * MAX_ESCALERAS);
-    if (banco->escaleras == NULL)
-    {
-        fprintf(stderr, "Error al asignar memoria para las escaleras del banco\n");
-        free(banco->grupos);
-        exit(EXIT_FAILURE);
-    }
-
+    banco->grupos = NULL;
+    banco->escaleras = NULL;
     banco->total_grupos = 0;
     banco->total_escaleras = 0;
+    banco->capacidad_grupos = 0;
+    banco->capacidad_escaleras = 0;
+    memset(&banco->indice, 0, sizeof(indice_embon_t));
+    banco->zobrist = 0;
+    banco->zobrist_grupos = NULL;
+    banco->zobrist_escaleras = NULL;
+    banco_reservar(banco, CAPACIDAD_INICIAL_BANCO, CAPACIDAD_INICIAL_BANCO);
+}
 
-    // Inicializar cada grupo y escalera en el banco
-    for (int i = 0; i < MAX_GRUPOS; i++)
+// Asegura lugar para al menos grupos y escaleras combinaciones, duplicando los
+// arreglos cuando no alcanzan. La mesa nunca descarta una combinación.
+void banco_reservar(banco_de_apeadas_t *banco, int grupos, int escaleras)
+{
+    if (grupos > banco->capacidad_grupos)
     {
-        banco->grupos[i].cantidad = 0;
-        memset(banco->grupos[i].fichas, 0, sizeof(ficha_t) * MAX_FICHAS_GRUPO);
+        int capacidad = banco->capacidad_grupos > 0 ? banco->capacidad_grupos : CAPACIDAD_INICIAL_BANCO;
+        while (capacidad < grupos)
+            capacidad *= 2;
+
+        grupo_t *nuevos = (grupo_t *)reasignar(banco->grupos, sizeof(grupo_t) * capacidad);
+        uint64_t *aportes = (uint64_t *)reasignar(banco->zobrist_grupos, sizeof(uint64_t) * capacidad);
+        if (nuevos == NULL || aportes == NULL)
+        {
+            fprintf(stderr, "Error al asignar memoria para los grupos del banco\n");
+            exit(EXIT_FAILURE);
+        }
+        // Un lugar nuevo todavía no aporta al hash de la mesa
+        memset(&aportes[banco->capacidad_grupos], 0, sizeof(uint64_t) * (capacidad - banco->capacidad_grupos));
+        banco->grupos = nuevos;
+        banco->zobrist_grupos = aportes;
+        banco->capacidad_grupos = capacidad;
     }
 
-    for (int i = 0; i < MAX_ESCALERAS; i++)
+    if (escaleras > banco->capacidad_escaleras)
     {
-        banco->escaleras[i].cantidad = 0;
-        memset(banco->escaleras[i].fichas, 0, sizeof(ficha_t) * MAX_FICHAS_ESCALERA);
+        int capacidad = banco->capacidad_escaleras > 0 ? banco->capacidad_escaleras : CAPACIDAD_INICIAL_BANCO;
+        while (capacidad < escaleras)
+            capacidad *= 2;
+
+        escalera_t *nuevas = (escalera_t *)reasignar(banco->escaleras, sizeof(escalera_t) * capacidad);
+        uint64_t *aportes = (uint64_t *)reasignar(banco->zobrist_escaleras, sizeof(uint64_t) * capacidad);
+        if (nuevas == NULL || aportes == NULL)
+        {
+            fprintf(stderr, "Error al asignar memoria para las escaleras del banco\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(&aportes[banco->capacidad_escaleras], 0,
+               sizeof(uint64_t) * (capacidad - banco->capacidad_escaleras));
+        banco->escaleras = nuevas;
+        banco->zobrist_escaleras = aportes;
+        banco->capacidad_escaleras = capacidad;
     }
 }
 
+// Agrega un grupo vacío al final del banco y lo devuelve
+grupo_t *banco_nuevo_grupo(banco_de_apeadas_t *banco)
+{
+    banco_reservar(banco, banco->total_grupos + 1, 0);
+    grupo_t *grupo = &banco->grupos[banco->total_grupos++];
+    grupo->cantidad = 0;
+    return grupo;
+}
+
+// Agrega una escalera vacía al final del banco y la devuelve
+escalera_t *banco_nueva_escalera(banco_de_apeadas_t *banco)
+{
+    banco_reservar(banco, 0, banco->total_escaleras + 1);
+    escalera_t *escalera = &banco->escaleras[banco->total_escaleras++];
+    escalera->cantidad = 0;
+    return escalera;
+}
+
+// Copia las combinaciones, el índice y el hash de origen sobre destino, reutilizando su memoria
+void banco_copiar(banco_de_apeadas_t *destino, const banco_de_apeadas_t *origen)
+{
+    banco_reservar(destino, origen->total_grupos, origen->total_escaleras);
+    memcpy(destino->grupos, origen->grupos, sizeof(grupo_t) * origen->total_grupos);
+    memcpy(destino->escaleras, origen->escaleras, sizeof(escalera_t) * origen->total_escaleras);
+    memcpy(destino->zobrist_grupos, origen->zobrist_grupos, sizeof(uint64_t) * origen->total_grupos);
+    memcpy(destino->zobrist_escaleras, origen->zobrist_escaleras, sizeof(uint64_t) * origen->total_escaleras);
+
+    // Los lugares que destino usaba de más vuelven a no aportar al hash
+    if (destino->total_grupos > origen->total_grupos)
+        memset(&destino->zobrist_grupos[origen->total_grupos], 0,
+               sizeof(uint64_t) * (destino->total_grupos - origen->total_grupos));
+    if (destino->total_escaleras > origen->total_escaleras)
+        memset(&destino->zobrist_escaleras[origen->total_escaleras], 0,
+               sizeof(uint64_t) * (destino->total_escaleras - origen->total_escaleras));
+
+    destino->total_grupos = origen->total_grupos;
+    destino->total_escaleras = origen->total_escaleras;
+    destino->indice = origen->indice;
+    destino->zobrist = origen->zobrist;
+}
+
 void apeada_inicializar(apeada_t *apeada)
 {
     if (apeada == NULL)
@@ -294,36 +1074,9 @@ void apeada_inicializar(apeada_t *apeada)
         exit(EXIT_FAILURE);
     }
 
-    apeada->grupos = (grupo_t *)malloc(sizeof(grupo_t) * MAX_GRUPOS);
-    if (apeada->grupos == NULL)
-    {
-        fprintf(stderr, "Error al asignar memoria para los grupos de apeada\n");
-        exit(EXIT_FAILURE);
-    }
-
-    apeada->escaleras = (escalera_t *)malloc(sizeof(escalera_t) * MAX_ESCALERAS);
-    if (apeada->escaleras == NULL)
-    {
-        fprintf(stderr, "Error al asignar memoria para las escaleras de apeada\n");
-        free(apeada->grupos);
-        exit(EXIT_FAILURE);
-    }
-
+    // Las fichas de cada combinación se escriben al agregarla; basta con vaciar
     apeada->total_grupos = 0;
     apeada->total_escaleras = 0;
-
-    // Inicializar cada grupo y escalera en la apeada
-    for (int i = 0; i < MAX_GRUPOS; i++)
-    {
-        apeada->grupos[i].cantidad = 0;
-        memset(apeada->grupos[i].fichas, 0, sizeof(ficha_t) * MAX_FICHAS_GRUPO);
-    }
-
-    for (int i = 0; i < MAX_ESCALERAS; i++)
-    {
-        apeada->escaleras[i].cantidad = 0;
-        memset(apeada->escaleras[i].fichas, 0, sizeof(ficha_t) * MAX_FICHAS_ESCALERA);
-    }
 }
 
 void mano_liberar(mano_t *mano)
@@ -334,17 +1087,20 @@ void mano_liberar(mano_t *mano)
         mano->fichas = NULL;
         mano->cantidad = 0;
         mano->capacidad = 0;
+        memset(&mano->bits, 0, sizeof(mano_bits_t));
     }
 }
 
-void liberar_jugadores()
+void liberar_jugadores(contexto_juego_t *ctx)
 {
-    for (int i = 0; i < NUM_JUGADORES; i++)
+    jugador_t *jugadores = ctx->jugadores;
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
     {
         free(jugadores[i].mano.fichas); // Liberar memoria dinámica de las fichas
         jugadores[i].mano.fichas = NULL;
         jugadores[i].mano.cantidad = 0;
         jugadores[i].mano.capacidad = 0;
+        memset(&jugadores[i].mano.bits, 0, sizeof(mano_bits_t));
     }
 }
 
@@ -365,44 +1121,272 @@ void banco_liberar(banco_de_apeadas_t *banco)
         banco->escaleras = NULL;
     }
 
+    free(banco->zobrist_grupos);
+    free(banco->zobrist_escaleras);
+    banco->zobrist_grupos = NULL;
+    banco->zobrist_escaleras = NULL;
+    banco->zobrist = 0;
+
     banco->total_grupos = 0;
     banco->total_escaleras = 0;
+    banco->capacidad_grupos = 0;
+    banco->capacidad_escaleras = 0;
 }
 
+// Los arreglos son parte de apeada_t: solo se vacía
 void apeada_liberar(apeada_t *apeada)
 {
     if (apeada == NULL)
         return;
 
-    if (apeada->grupos != NULL)
-    {
-        free(apeada->grupos);
-        apeada->grupos = NULL;
-    }
-
-    if (apeada->escaleras != NULL)
-    {
-        free(apeada->escaleras);
-        apeada->escaleras = NULL;
-    }
-
     apeada->total_grupos = 0;
     apeada->total_escaleras = 0;
 }
 
 // ----------------------------------------------------------------------
-// Funciones de puntuacion
+// Hashing de Zobrist y tabla de transposición
 // ----------------------------------------------------------------------
 
-// Calcula puntos de un grupo
-int calcular_puntos_grupo(const ficha_t grupo[], int cantidad)
+// Cada mano y cada mesa llevan un hash de Zobrist que se mantiene al mover
+// fichas: la mano lo cambia en bits_agregar/bits_quitar con la clave de (ficha,
+// copia), así que dos manos con las mismas fichas tienen el mismo hash aunque
+// hayan llegado a ellas en otro orden o con otras copias; la mesa lo rehace solo
+// para la combinación que cambia, junto con el índice de embones.
+//
+// Las claves salen de mezclar con splitmix64 un número que describe la pieza: no
+// hay tabla que sembrar antes de usarlas y todos los hilos ven las mismas.
+
+#define ZOBRIST_MANO 0x6D616E6F00000000ULL // Dominios de las claves (los cuatro bytes altos)
+#define ZOBRIST_GRUPO 0x6772757000000000ULL
+#define ZOBRIST_ESCALERA 0x6573636100000000ULL
+#define ZOBRIST_JUEGO 0x6A75656700000000ULL
+
+static inline uint64_t zobrist_clave(uint64_t pieza)
+{
+    uint64_t z = pieza + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Clave de la copia-ésima ficha de una clase en la mano (copia 0 = la primera)
+static inline uint64_t zobrist_mano(int clase, int copia)
+{
+    return zobrist_clave(ZOBRIST_MANO | (uint64_t)clase << 8 | (uint64_t)copia);
+}
+
+// Aporte del grupo g a la mesa: un grupo es un número, sus colores y sus comodines
+static uint64_t zobrist_grupo(int g, const grupo_t *grupo)
+{
+    unsigned colores = 0;
+    int numero = 0, comodines = 0;
+
+    for (int i = 0; i < grupo->cantidad; i++)
+    {
+        if (grupo->fichas[i] >= PRIMER_COMODIN)
+        {
+            comodines++;
+            continue;
+        }
+        colores |= 1u << ficha_color(grupo->fichas[i]);
+        numero = ficha_numero(grupo->fichas[i]);
+    }
+    return zobrist_clave(ZOBRIST_GRUPO | (uint64_t)g << 16 | (uint64_t)numero << 8 | colores << 4 | comodines);
+}
+
+// Aporte de la escalera e a la mesa: su color, sus números y sus comodines. Como
+// para puede_embonar_escalera, no importa el orden en que están las fichas.
+static uint64_t zobrist_escalera(int e, const escalera_t *escalera)
+{
+    unsigned numeros = 0;
+    int color = 0, comodines = 0;
+
+    for (int i = 0; i < escalera->cantidad; i++)
+    {
+        if (escalera->fichas[i] >= PRIMER_COMODIN)
+        {
+            comodines++;
+            continue;
+        }
+        numeros |= 1u << (ficha_numero(escalera->fichas[i]) - 1);
+        color = ficha_color(escalera->fichas[i]);
+    }
+    return zobrist_clave(ZOBRIST_ESCALERA | (uint64_t)e << 24 | (uint64_t)numeros << 8 | color << 4 | comodines);
+}
+
+// Reemplaza el aporte de una combinación al hash de la mesa
+static inline void zobrist_reemplazar(uint64_t *hash, uint64_t *aporte, uint64_t nuevo)
+{
+    *hash ^= *aporte ^ nuevo;
+    *aporte = nuevo;
+}
+
+// Tabla de transposición: tamaño fijo, compartida por todos los hilos y sin
+// cerrojos. Cada entrada guarda el dato y clave ^ dato; si dos hilos escriben la
+// misma entrada a la vez, lo que quede mezclado no coincide con ninguna clave y
+// se lee como un fallo. Una escritura nueva reemplaza a la anterior.
+#define TT_BITS 18
+#define TT_TAMANO (1 << TT_BITS)
+
+#define TT_APEADA 0xA9E3ADA5C0FFEE01ULL     // Dominios: la misma posición guarda datos distintos
+#define TT_EVALUACION 0xE7A1C0DEBADC0DE5ULL
+
+typedef struct
+{
+    uint64_t verificacion; // clave ^ dato
+    uint64_t dato;
+} entrada_tt_t;
+
+static entrada_tt_t tabla_transposicion[TT_TAMANO];
+static bool tt_apagada; // --benchmark mide los núcleos completos: sin atajos de la tabla
+
+bool tt_buscar(uint64_t clave, uint64_t *dato)
+{
+    if (tt_apagada)
+        return false;
+
+    entrada_tt_t *entrada = &tabla_transposicion[clave & (TT_TAMANO - 1)];
+    uint64_t verificacion = __atomic_load_n(&entrada->verificacion, __ATOMIC_RELAXED);
+    uint64_t valor = __atomic_load_n(&entrada->dato, __ATOMIC_RELAXED);
+
+    // Una entrada vacía (todo en cero) solo coincidiría con la clave 0
+    if (clave == 0 || (verificacion ^ valor) != clave)
+        return false;
+    *dato = valor;
+    return true;
+}
+
+void tt_guardar(uint64_t clave, uint64_t dato)
+{
+    if (tt_apagada)
+        return;
+
+    entrada_tt_t *entrada = &tabla_transposicion[clave & (TT_TAMANO - 1)];
+    __atomic_store_n(&entrada->verificacion, clave ^ dato, __ATOMIC_RELAXED);
+    __atomic_store_n(&entrada->dato, dato, __ATOMIC_RELAXED);
+}
+
+// ----------------------------------------------------------------------
+// Funciones de la mano en bits
+// ----------------------------------------------------------------------
+
+#define MASCARA_FILA ((1ULL << NUM_RANGOS) - 1) // Los 13 números de un color
+#define MASCARA_COLUMNA (1ULL | 1ULL << NUM_RANGOS | 1ULL << (2 * NUM_RANGOS) | 1ULL << (3 * NUM_RANGOS))
+
+// Posición de una ficha normal dentro de una capa (ignora la copia)
+static inline int ficha_bit(ficha_t ficha)
+{
+    return ficha % FICHAS_POR_JUEGO;
+}
+
+// Agregar y quitar mantienen el hash de Zobrist: la clave depende de cuántas
+// fichas de la clase había, no de cuál de las copias es
+void bits_agregar(mano_bits_t *bits, ficha_t ficha)
+{
+    if (ficha >= PRIMER_COMODIN)
+    {
+        bits->zobrist ^= zobrist_mano(INDICE_COMODIN, bits->comodines++);
+        return;
+    }
+
+    uint64_t bit = 1ULL << ficha_bit(ficha);
+    if (bits->capas[0] & bit)
+    {
+        bits->capas[1] |= bit;
+        bits->zobrist ^= zobrist_mano(ficha_bit(ficha), 1);
+    }
+    else
+    {
+        bits->capas[0] |= bit;
+        bits->zobrist ^= zobrist_mano(ficha_bit(ficha), 0);
+    }
+}
+
+void bits_quitar(mano_bits_t *bits, ficha_t ficha)
+{
+    if (ficha >= PRIMER_COMODIN)
+    {
+        bits->zobrist ^= zobrist_mano(INDICE_COMODIN, --bits->comodines);
+        return;
+    }
+
+    uint64_t bit = 1ULL << ficha_bit(ficha);
+    if (bits->capas[1] & bit)
+    {
+        bits->capas[1] &= ~bit;
+        bits->zobrist ^= zobrist_mano(ficha_bit(ficha), 1);
+    }
+    else
+    {
+        bits->capas[0] &= ~bit;
+        bits->zobrist ^= zobrist_mano(ficha_bit(ficha), 0);
+    }
+}
+
+// Números presentes de un color (13 bits, bit 0 = número 1)
+static inline unsigned bits_fila(const mano_bits_t *bits, int color)
+{
+    return (unsigned)((bits->capas[0] >> (color * NUM_RANGOS)) & MASCARA_FILA);
+}
+
+// Colores presentes de un número (4 bits, bit c = color c)
+static inline unsigned bits_colores_de_numero(const mano_bits_t *bits, int numero)
+{
+    uint64_t columna = (bits->capas[0] >> (numero - 1)) & MASCARA_COLUMNA;
+    return (unsigned)((columna & 1) | (columna >> (NUM_RANGOS - 1) & 2) |
+                      (columna >> (2 * NUM_RANGOS - 2) & 4) | (columna >> (3 * NUM_RANGOS - 3) & 8));
+}
+
+// Indica si hay un grupo de 3 (con comodines) sin recorrer tríos de fichas.
+// Se suman las cuatro filas de colores en paralelo: cada bit es un número.
+bool bits_hay_grupo(const mano_bits_t *bits)
+{
+    if (bits->capas[0] == 0)
+        return false; // Un grupo necesita al menos una ficha normal
+    if (bits->comodines >= 2)
+        return true;
+
+    unsigned a = bits_fila(bits, ROJO), b = bits_fila(bits, NEGRO);
+    unsigned c = bits_fila(bits, AZUL), d = bits_fila(bits, AMARILLO);
+
+    if (bits->comodines == 1)
+        return ((a & b) | (a & c) | (a & d) | (b & c) | (b & d) | (c & d)) != 0; // 2 colores + comodín
+
+    return ((a & b & c) | (a & b & d) | (a & c & d) | (b & c & d)) != 0; // 3 colores
+}
+
+// Indica si hay una escalera de 3 (con comodines) usando desplazamientos por color
+bool bits_hay_escalera(const mano_bits_t *bits)
+{
+    for (int color = 0; color < NUM_COLORES; color++)
+    {
+        unsigned m = bits_fila(bits, color);
+        if (m == 0)
+            continue;
+
+        if (bits->comodines >= 2)
+            return true; // Una ficha y dos comodines
+        if (bits->comodines == 1 && ((m & m >> 1) | (m & m >> 2)))
+            return true; // Dos fichas a distancia 1 o 2 y un comodín
+        if (m & m >> 1 & m >> 2)
+            return true; // Tres consecutivas
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------
+// Funciones de puntuacion
+// ----------------------------------------------------------------------
+
+// Calcula puntos de un grupo
+int calcular_puntos_grupo(const ficha_t grupo[], int cantidad)
 {
     int valor_base = -1;
     for (int i = 0; i < cantidad; i++)
     {
-        if (grupo[i].numero != 0)
+        if (ficha_numero(grupo[i]) != 0)
         {
-            valor_base = grupo[i].numero;
+            valor_base = ficha_numero(grupo[i]);
             break;
         }
     }
@@ -419,12 +1403,12 @@ int calcular_puntos_escalera(const ficha_t escalera[], int cantidad)
 
     for (int i = 0; i < cantidad; i++)
     {
-        if (escalera[i].numero != 0)
+        if (ficha_numero(escalera[i]) != 0)
         {
-            puntos += escalera[i].numero;
-            if (escalera[i].numero > max_val)
+            puntos += ficha_numero(escalera[i]);
+            if (ficha_numero(escalera[i]) > max_val)
             {
-                max_val = escalera[i].numero;
+                max_val = ficha_numero(escalera[i]);
             }
         }
     }
@@ -432,7 +1416,7 @@ int calcular_puntos_escalera(const ficha_t escalera[], int cantidad)
     // Asignar valor a comodines (valor máximo + 1 para cada uno)
     for (int i = 0; i < cantidad; i++)
     {
-        if (escalera[i].numero == 0)
+        if (ficha_numero(escalera[i]) == 0)
         {
             puntos += (max_val + 1);
             max_val++; // Incrementar para el próximo comodín
@@ -451,40 +1435,8 @@ bool puede_hacer_apeada(jugador_t *jugador)
         return false; // No puede hacer apeada
     }
 
-    // Intentar encontrar grupos válidos
-    for (int i = 0; i < jugador->mano.cantidad - 2; i++)
-    {
-        for (int j = i + 1; j < jugador->mano.cantidad - 1; j++)
-        {
-            for (int k = j + 1; k < jugador->mano.cantidad; k++)
-            {
-                ficha_t grupo[3] = {jugador->mano.fichas[i], jugador->mano.fichas[j], jugador->mano.fichas[k]};
-                if (es_grupo_valido(grupo, 3))
-                {
-                    return true; // Se encontró un grupo válido
-                }
-            }
-        }
-    }
-
-    // Intentar encontrar escaleras válidas
-    for (int i = 0; i < jugador->mano.cantidad - 2; i++)
-    {
-        for (int j = i + 1; j < jugador->mano.cantidad - 1; j++)
-        {
-            for (int k = j + 1; k < jugador->mano.cantidad; k++)
-            {
-                ficha_t escalera[3] = {jugador->mano.fichas[i], jugador->mano.fichas[j], jugador->mano.fichas[k]};
-                if (es_escalera_valida(escalera, 3))
-                {
-                    return true; // Se encontró una escalera válida
-                }
-            }
-        }
-    }
-
-    // Si no se encontraron grupos ni escaleras válidas
-    return false;
+    // Tiempo constante sobre la mano en bits, sin importar cuántas fichas tenga
+    return bits_hay_grupo(&jugador->mano.bits) || bits_hay_escalera(&jugador->mano.bits);
 }
 
 // Calcula puntos totales de una apeada
@@ -532,6 +1484,61 @@ int calcular_puntos_apeada(const apeada_t *apeada)
     return puntos_totales;
 }
 
+// ----------------------------------------------------------------------
+// Tablas de validez precalculadas
+// ----------------------------------------------------------------------
+
+// Puntos de cada grupo posible (número x colores x comodines) y de cada escalera
+// posible (números presentes de un color x comodines); -1 si no es válida.
+// Se llenan una vez antes de main y la búsqueda de combinaciones solo consulta.
+static int16_t tabla_grupos[NUM_RANGOS + 1][1 << NUM_COLORES][MAX_COMODINES + 1];
+static int16_t tabla_escaleras[MAX_COMODINES + 1][1 << NUM_RANGOS];
+static uint8_t huecos_escalera[1 << NUM_RANGOS]; // Comodines necesarios para cerrar los huecos
+
+__attribute__((constructor)) static void inicializar_tablas_combinaciones(void)
+{
+    for (int numero = 0; numero <= NUM_RANGOS; numero++)
+    {
+        for (unsigned colores = 0; colores < (1u << NUM_COLORES); colores++)
+        {
+            for (int comodines = 0; comodines <= MAX_COMODINES; comodines++)
+            {
+                int cantidad = __builtin_popcount(colores) + comodines;
+                bool valido = numero >= 1 && colores != 0 &&
+                              cantidad >= MIN_FICHAS_GRUPO && cantidad <= MAX_FICHAS_GRUPO;
+                tabla_grupos[numero][colores][comodines] = valido ? numero * cantidad : -1;
+            }
+        }
+    }
+
+    for (unsigned numeros = 0; numeros < (1u << NUM_RANGOS); numeros++)
+    {
+        int suma = 0, maximo = 0;
+        for (int n = 1; n <= NUM_RANGOS; n++)
+        {
+            if (numeros & (1u << (n - 1)))
+            {
+                suma += n;
+                maximo = n;
+            }
+        }
+
+        int reales = __builtin_popcount(numeros);
+        int huecos = (numeros == 0) ? 0 : maximo - __builtin_ctz(numeros) - reales;
+        huecos_escalera[numeros] = (uint8_t)huecos;
+
+        for (int comodines = 0; comodines <= MAX_COMODINES; comodines++)
+        {
+            int cantidad = reales + comodines;
+            bool valido = numeros != 0 && huecos <= comodines &&
+                          cantidad >= MIN_FICHAS_ESCALERA && cantidad <= MAX_FICHAS_ESCALERA;
+            // Igual que calcular_puntos_escalera: cada comodín vale el máximo + 1, + 2...
+            int puntos = suma + comodines * maximo + comodines * (comodines + 1) / 2;
+            tabla_escaleras[comodines][numeros] = valido ? puntos : -1;
+        }
+    }
+}
+
 // ----------------------------------------------------------------------
 // Funciones de logica de apeada
 // ----------------------------------------------------------------------
@@ -545,45 +1552,31 @@ bool es_grupo_valido(const ficha_t fichas[], int cantidad)
         return false;
     }
 
-    int numero_base = -1;
+    int numero_base = 0;
     int comodines = 0;
-    char colores_usados[MAX_FICHAS_GRUPO][MAX_COLOR] = {0};
-    int colores_count = 0;
+    unsigned colores_usados = 0; // Bit por color ya presente
 
     for (int i = 0; i < cantidad; i++)
     {
-        if (fichas[i].numero == VALOR_COMODIN)
-        { // Usando VALOR_COMODIN
+        int numero = ficha_numero(fichas[i]);
+        if (numero == VALOR_COMODIN)
+        {
             comodines++;
+            continue;
         }
-        else
-        {
-            // Verificar que no haya fichas duplicadas (mismo número y color)
-            for (int j = 0; j < colores_count; j++)
-            {
-                if (strcmp(fichas[i].color, colores_usados[j]) == 0)
-                {
-                    return false; // Color repetido en el grupo
-                }
-            }
 
-            // Guardar color usado
-            strncpy(colores_usados[colores_count++], fichas[i].color, MAX_COLOR - 1);
-
-            // Establecer o verificar número base
-            if (numero_base == -1)
-            {
-                numero_base = fichas[i].numero;
-            }
-            else if (fichas[i].numero != numero_base)
-            {
-                return false; // Números diferentes
-            }
+        // Números diferentes o color repetido (misma ficha dos veces)
+        unsigned bit_color = 1u << ficha_color(fichas[i]);
+        if ((numero_base != 0 && numero != numero_base) || (colores_usados & bit_color))
+        {
+            return false;
         }
+        numero_base = numero;
+        colores_usados |= bit_color;
     }
 
-    // Debe haber al menos una ficha no comodín
-    return (numero_base != -1);
+    // Al menos una ficha no comodín y tamaño permitido
+    return tabla_grupos[numero_base][colores_usados][comodines] >= 0;
 }
 
 // Verifica si un conjunto de fichas forma una escalera válida
@@ -595,105 +1588,43 @@ bool es_escalera_valida(const ficha_t fichas[], int cantidad)
         return false;
     }
 
-    int numeros[MAX_FICHAS_ESCALERA] = {0};
-    char color_base[MAX_COLOR] = "";
-    int idx = 0;
+    int color_base = -1;
     int comodines = 0;
+    unsigned numeros = 0; // Bit n-1 por número presente
 
-    // Procesar fichas y verificar color consistente
     for (int i = 0; i < cantidad; i++)
     {
-        if (fichas[i].numero == VALOR_COMODIN)
+        int numero = ficha_numero(fichas[i]);
+        if (numero == VALOR_COMODIN)
         {
             comodines++;
+            continue;
         }
-        else
-        {
-            // Verificar color consistente
-            if (strlen(color_base) == 0)
-            {
-                strncpy(color_base, fichas[i].color, MAX_COLOR - 1);
-            }
-            else if (strcmp(color_base, fichas[i].color) != 0)
-            {
-                return false; // Diferente color
-            }
-
-            // Verificar que no haya números duplicados
-            for (int j = 0; j < idx; j++)
-            {
-                if (numeros[j] == fichas[i].numero)
-                {
-                    return false; // Número duplicado
-                }
-            }
-
-            numeros[idx++] = fichas[i].numero;
-        }
-    }
-
-    // No puede ser solo comodines
-    if (idx == 0)
-        return false;
-
-    // Ordenar números (usando bubble sort por simplicidad)
-    for (int i = 0; i < idx - 1; i++)
-    {
-        for (int j = i + 1; j < idx; j++)
-        {
-            if (numeros[i] > numeros[j])
-            {
-                int temp = numeros[i];
-                numeros[i] = numeros[j];
-                numeros[j] = temp;
-            }
-        }
-    }
 
-    // Verificar secuencia con comodines
-    int comodines_necesarios = 0;
-    for (int i = 0; i < idx - 1; i++)
-    {
-        int diff = numeros[i + 1] - numeros[i];
-        if (diff <= 0)
+        // Color consistente y sin números duplicados
+        unsigned bit = 1u << (numero - 1);
+        if ((color_base != -1 && color_base != (int)ficha_color(fichas[i])) || (numeros & bit))
         {
-            return false; // Números iguales o decrecientes
+            return false;
         }
-        comodines_necesarios += (diff - 1);
+        color_base = ficha_color(fichas[i]);
+        numeros |= bit;
     }
 
-    // Comodines deben poder llenar todos los huecos
-    if (comodines_necesarios > comodines)
+    // Solo comodines, huecos sin cubrir o tamaño fuera de rango
+    if (comodines > MAX_COMODINES || tabla_escaleras[comodines][numeros] < 0)
     {
         return false;
     }
 
     // Comodines restantes solo pueden estar al inicio o final
-    int comodines_restantes = comodines - comodines_necesarios;
-    if (comodines_restantes > 0)
+    if (comodines > huecos_escalera[numeros])
     {
-        bool comodin_inicio = false;
-        bool comodin_final = false;
-
-        for (int i = 0; i < cantidad; i++)
+        for (int i = 1; i < cantidad - 1; i++)
         {
-            if (fichas[i].numero == VALOR_COMODIN)
+            if (ficha_numero(fichas[i]) == VALOR_COMODIN)
             {
-                if (i > 0 && i < cantidad - 1)
-                {
-                    // Comodín en medio debe estar rellenando un hueco
-                    if (comodines_restantes > 0)
-                    {
-                        return false;
-                    }
-                }
-                else
-                {
-                    if (i == 0)
-                        comodin_inicio = true;
-                    if (i == cantidad - 1)
-                        comodin_final = true;
-                }
+                return false; // Comodín en medio debe estar rellenando un hueco
             }
         }
     }
@@ -706,6 +1637,7 @@ void remover_ficha(mano_t *mano, int pos)
 {
     if (pos >= 0 && pos < mano->cantidad)
     { // Verifica que la posición sea válida
+        bits_quitar(&mano->bits, mano->fichas[pos]);
         for (int i = pos; i < mano->cantidad - 1; i++)
         {
             mano->fichas[i] = mano->fichas[i + 1]; // Desplaza las fichas hacia la izquierda
@@ -736,215 +1668,370 @@ void remover_fichas(mano_t *mano, int indices[], int cantidad)
     }
 }
 
-// Busca el mejor grupo disponible en la mano y lo añade al banco
-bool buscar_mejor_grupo(mano_t *mano, apeada_t *apeada, int *puntos)
+// ----------------------------------------------------------------------
+// Solucionador exacto de apeadas
+// ----------------------------------------------------------------------
+
+// La mano se resuelve sobre sus capas de bits, reordenadas por número y luego color.
+// Se toma siempre la ficha de menor bit: o se deja en la mano, o es la menor ficha
+// de un grupo (con colores mayores del mismo número) o de una escalera (que empieza
+// en ella, con comodines en huecos, en lugar de fichas o en los extremos). Cada estado
+// (capas + comodines) se memoiza, así que el resultado es el máximo de puntos.
+
+#define MEMO_APEADA_BITS 16
+#define MEMO_APEADA_TAMANO (1 << MEMO_APEADA_BITS)
+#define PRESUPUESTO_NODOS_APEADA 200000 // Tope de estados expandidos por mano
+
+// Posición de una ficha en el orden del solucionador (número mayor, color menor)
+#define BIT_SOLUCION(color, numero) (((numero) - 1) * NUM_COLORES + (color))
+
+typedef struct
 {
-    int mejor_puntos = 0;
-    int mejores_indices[MAX_FICHAS_GRUPO] = {-1};
-    int mejor_cantidad = 0;
+    uint64_t capa0;      // Capa de primeras copias del estado
+    uint64_t capa1;      // Capa de segundas copias | comodines << 60
+    uint32_t generacion; // Búsqueda que escribió la entrada
+    int32_t valor;       // Máximo de puntos alcanzable desde el estado
+} memo_apeada_t;
 
-    for (int i = 0; i < mano->cantidad - 2; i++)
-    {
-        for (int j = i + 1; j < mano->cantidad - 1; j++)
-        {
-            for (int k = j + 1; k < mano->cantidad; k++)
-            {
-                ficha_t grupo[3] = {mano->fichas[i], mano->fichas[j], mano->fichas[k]};
+typedef struct
+{
+    memo_apeada_t *memo; // Tabla de memoización del hilo
+    uint32_t generacion; // Invalida entradas de búsquedas anteriores sin limpiar la tabla
+    long nodos;          // Estados expandidos en esta búsqueda
+    bool agotado;        // Se alcanzó el presupuesto: el resultado es una cota inferior
+} solucionador_apeada_t;
 
-                if (es_grupo_valido(grupo, 3))
-                {
-                    int indices[4] = {i, j, k, -1};
-                    int cantidad = 3;
+// Jugada elegida para la menor ficha de un estado
+typedef struct
+{
+    bool es_grupo;    // Grupo o escalera (si puntos == 0, la ficha se deja en la mano)
+    int puntos;       // Puntos de la combinación
+    int color;        // Color de la escalera
+    int numero;       // Número del grupo / primera ficha real de la escalera
+    unsigned colores; // Colores del grupo (incluye la ficha base)
+    int largo;        // Posiciones de la escalera, comodines incluidos
+    int al_inicio;    // Comodines antes de la primera ficha real
+    unsigned numeros; // Números reales usados por la escalera (bit n-1)
+    int comodines;    // Comodines usados
+    uint64_t capa0;   // Estado resultante
+    uint64_t capa1;
+} jugada_apeada_t;
+
+// Fichas concretas de la mano agrupadas por bit, para convertir la solución en fichas
+typedef struct
+{
+    ficha_t fichas[FICHAS_POR_JUEGO][2];
+    int cantidad[FICHAS_POR_JUEGO];
+    ficha_t comodines[MAX_COMODINES];
+    int num_comodines;
+} reserva_fichas_t;
 
-                    // Verificar si podemos añadir una cuarta ficha
-                    for (int l = k + 1; l < mano->cantidad; l++)
-                    {
-                        ficha_t grupo4[4] = {mano->fichas[i], mano->fichas[j],
-                                             mano->fichas[k], mano->fichas[l]};
-                        if (es_grupo_valido(grupo4, 4))
-                        {
-                            indices[3] = l;
-                            cantidad = 4;
-                            break;
-                        }
-                    }
+static pthread_key_t clave_memo_apeada;
+static pthread_once_t memo_apeada_once = PTHREAD_ONCE_INIT;
+static _Thread_local uint32_t generacion_memo_apeada = 0;
 
-                    // Calcular puntos
-                    int pts = calcular_puntos_grupo(grupo, cantidad);
-                    if (pts > mejor_puntos)
-                    {
-                        mejor_puntos = pts;
-                        mejor_cantidad = cantidad;
-                        memcpy(mejores_indices, indices, mejor_cantidad * sizeof(int));
-                    }
-                }
-            }
-        }
-    }
+static void crear_clave_memo_apeada(void)
+{
+    pthread_key_create(&clave_memo_apeada, free);
+}
 
-    if (mejor_puntos > 0)
-    {
-        // Añadir el mejor grupo encontrado a la apeada
-        if (apeada->total_grupos >= MAX_GRUPOS)
-        {
-            fprintf(stderr, "Error: Capacidad máxima de grupos alcanzada en la apeada\n");
-            return false;
-        }
+// Tabla de memoización propia de cada hilo (se reserva una sola vez por hilo)
+static memo_apeada_t *obtener_memo_apeada(void)
+{
+    pthread_once(&memo_apeada_once, crear_clave_memo_apeada);
 
-        grupo_t *nuevo_grupo = &apeada->grupos[apeada->total_grupos++];
-        nuevo_grupo->cantidad = mejor_cantidad;
-        for (int i = 0; i < mejor_cantidad; i++)
+    memo_apeada_t *memo = pthread_getspecific(clave_memo_apeada);
+    if (memo == NULL)
+    {
+        memo = (memo_apeada_t *)asignar_ceros(MEMO_APEADA_TAMANO, sizeof(memo_apeada_t));
+        if (memo == NULL)
         {
-            nuevo_grupo->fichas[i] = mano->fichas[mejores_indices[i]];
+            fprintf(stderr, "Error al asignar memoria para la tabla de apeadas\n");
+            exit(EXIT_FAILURE);
         }
+        pthread_setspecific(clave_memo_apeada, memo);
+    }
+    return memo;
+}
 
-        *puntos += mejor_puntos;
-        remover_fichas(mano, mejores_indices, mejor_cantidad);
-        return true;
+// Reordena una capa de la mano (color * 13 + numero - 1) al orden del solucionador
+static uint64_t capa_a_solucion(uint64_t capa)
+{
+    uint64_t resultado = 0;
+    while (capa)
+    {
+        int bit = __builtin_ctzll(capa);
+        resultado |= 1ULL << BIT_SOLUCION(bit / NUM_RANGOS, bit % NUM_RANGOS + 1);
+        capa &= capa - 1;
     }
+    return resultado;
+}
 
-    return false;
+// Quita una copia de la ficha en la posición bit (primero la segunda copia)
+static inline void quitar_copia(uint64_t *capa0, uint64_t *capa1, int bit)
+{
+    uint64_t m = 1ULL << bit;
+    if (*capa1 & m)
+        *capa1 &= ~m;
+    else
+        *capa0 &= ~m;
 }
 
-// Busca la mejor escalera disponible en la mano y la añade al banco
-bool buscar_mejor_escalera(mano_t *mano, apeada_t *apeada, int *puntos)
+static int resolver_apeada(solucionador_apeada_t *s, uint64_t capa0, uint64_t capa1, int comodines);
+
+// Extiende una escalera parcial hacia números mayores (o con comodines al inicio al
+// llegar al 13) y evalúa cada largo válido. p lleva el estado después de la escalera.
+static void extender_escalera(solucionador_apeada_t *s, jugada_apeada_t p, int comodines_totales,
+                              int *mejor, jugada_apeada_t *elegida)
 {
-    int mejor_puntos = 0;
-    int mejores_indices[MAX_FICHAS_ESCALERA] = {-1};
-    int mejor_cantidad = 0;
+    int libres = comodines_totales - p.comodines;
 
-    for (int i = 0; i < mano->cantidad - 2; i++)
+    if (p.largo >= MIN_FICHAS_ESCALERA)
     {
-        for (int j = i + 1; j < mano->cantidad - 1; j++)
+        int pts = tabla_escaleras[p.comodines][p.numeros];
+        int valor = pts + resolver_apeada(s, p.capa0, p.capa1, libres);
+        if (valor > *mejor)
         {
-            for (int k = j + 1; k < mano->cantidad; k++)
+            *mejor = valor;
+            if (elegida != NULL)
             {
-                ficha_t escalera[3] = {mano->fichas[i], mano->fichas[j], mano->fichas[k]};
+                *elegida = p;
+                elegida->puntos = pts;
+            }
+        }
+    }
 
-                if (es_escalera_valida(escalera, 3))
-                {
-                    int indices[MAX_FICHAS_ESCALERA] = {i, j, k};
-                    int cantidad = 3;
+    if (p.largo >= MAX_FICHAS_ESCALERA)
+        return;
 
-                    // Intentar extender la escalera
-                    for (int l = 0; l < mano->cantidad; l++)
-                    {
-                        bool ya_en_escalera = false;
-                        for (int m = 0; m < cantidad; m++)
-                        {
-                            if (l == indices[m])
-                            {
-                                ya_en_escalera = true;
-                                break;
-                            }
-                        }
+    int n = p.numero + p.largo - p.al_inicio; // Siguiente número a la derecha
+    if (n <= NUM_RANGOS)
+    {
+        int bit = BIT_SOLUCION(p.color, n);
+        if (p.capa0 & (1ULL << bit))
+        {
+            jugada_apeada_t q = p;
+            quitar_copia(&q.capa0, &q.capa1, bit);
+            q.numeros |= 1u << (n - 1);
+            q.largo++;
+            extender_escalera(s, q, comodines_totales, mejor, elegida);
+        }
+        if (libres > 0)
+        {
+            // Comodín en un hueco, en lugar de la ficha (que queda para otra combinación) o al final
+            jugada_apeada_t q = p;
+            q.comodines++;
+            q.largo++;
+            extender_escalera(s, q, comodines_totales, mejor, elegida);
+        }
+    }
+    else if (libres > 0 && p.numero - p.al_inicio > 1)
+    {
+        // Se llegó al 13: los comodines restantes van al inicio
+        jugada_apeada_t q = p;
+        q.comodines++;
+        q.al_inicio++;
+        q.largo++;
+        extender_escalera(s, q, comodines_totales, mejor, elegida);
+    }
+}
 
-                        if (!ya_en_escalera)
-                        {
-                            ficha_t escalera_ext[MAX_FICHAS_ESCALERA];
-                            for (int m = 0; m < cantidad; m++)
-                            {
-                                escalera_ext[m] = mano->fichas[indices[m]];
-                            }
-                            escalera_ext[cantidad] = mano->fichas[l];
+// Evalúa cada jugada posible para la menor ficha del estado y devuelve el mejor valor.
+// Si elegida != NULL guarda la jugada ganadora (para reconstruir la solución).
+static int mejor_jugada_apeada(solucionador_apeada_t *s, uint64_t capa0, uint64_t capa1, int comodines,
+                               jugada_apeada_t *elegida)
+{
+    int bit = __builtin_ctzll(capa0);
+    int numero = bit / NUM_COLORES + 1;
+    int color = bit % NUM_COLORES;
 
-                            if (es_escalera_valida(escalera_ext, cantidad + 1))
-                            {
-                                indices[cantidad] = l;
-                                cantidad++;
-                            }
-                        }
-                    }
+    uint64_t base0 = capa0, base1 = capa1;
+    quitar_copia(&base0, &base1, bit);
 
-                    // Calcular puntos
-                    int pts = calcular_puntos_escalera(escalera, cantidad);
-                    if (pts > mejor_puntos)
-                    {
-                        mejor_puntos = pts;
-                        mejor_cantidad = cantidad;
-                        memcpy(mejores_indices, indices, mejor_cantidad * sizeof(int));
-                    }
-                }
-            }
-        }
+    // Opción 1: dejar la ficha en la mano
+    int mejor = resolver_apeada(s, base0, base1, comodines);
+    if (elegida != NULL)
+    {
+        *elegida = (jugada_apeada_t){.puntos = 0, .capa0 = base0, .capa1 = base1};
     }
 
-    if (mejor_puntos > 0)
+    // Opción 2: grupos con colores mayores del mismo número
+    int primero = BIT_SOLUCION(0, numero);
+    unsigned otros = (unsigned)(base0 >> primero) & 0xF & ~((2u << color) - 1);
+
+    for (unsigned sub = otros;; sub = (sub - 1) & otros)
     {
-        // Añadir la mejor escalera encontrada a la apeada
-        if (apeada->total_escaleras >= MAX_ESCALERAS)
+        int k = 1 + __builtin_popcount(sub);
+        uint64_t g0 = base0, g1 = base1;
+        for (unsigned resto = sub; resto; resto &= resto - 1)
         {
-            fprintf(stderr, "Error: Capacidad máxima de escaleras alcanzada en la apeada\n");
-            return false;
+            quitar_copia(&g0, &g1, primero + __builtin_ctz(resto));
         }
 
-        escalera_t *nueva_escalera = &apeada->escaleras[apeada->total_escaleras++];
-        nueva_escalera->cantidad = mejor_cantidad;
-        for (int i = 0; i < mejor_cantidad; i++)
+        for (int j = 0; j <= comodines && k + j <= MAX_FICHAS_GRUPO; j++)
         {
-            nueva_escalera->fichas[i] = mano->fichas[mejores_indices[i]];
+            if (tabla_grupos[numero][sub | (1u << color)][j] < 0)
+                continue;
+
+            int pts = tabla_grupos[numero][sub | (1u << color)][j];
+            int valor = pts + resolver_apeada(s, g0, g1, comodines - j);
+            if (valor > mejor)
+            {
+                mejor = valor;
+                if (elegida != NULL)
+                {
+                    *elegida = (jugada_apeada_t){.es_grupo = true, .puntos = pts, .numero = numero,
+                                                 .colores = sub | (1u << color), .comodines = j,
+                                                 .capa0 = g0, .capa1 = g1};
+                }
+            }
         }
 
-        *puntos += mejor_puntos;
-        remover_fichas(mano, mejores_indices, mejor_cantidad);
-        return true;
+        if (sub == 0)
+            break;
     }
 
-    return false;
+    // Opción 3: escaleras del mismo color que empiezan en la ficha
+    jugada_apeada_t escalera = {.es_grupo = false, .color = color, .numero = numero, .largo = 1,
+                                .numeros = 1u << (numero - 1), .capa0 = base0, .capa1 = base1};
+    extender_escalera(s, escalera, comodines, &mejor, elegida);
+
+    return mejor;
 }
 
-// Busca combinaciones según la prioridad especificada y las añade al banco
-void buscar_combinaciones(mano_t *mano, apeada_t *apeada, int *puntos, bool priorizar_grupos)
+// Máximo de puntos en combinaciones que se pueden formar con el estado dado
+static int resolver_apeada(solucionador_apeada_t *s, uint64_t capa0, uint64_t capa1, int comodines)
 {
-    bool seguir_buscando = true;
-    while (seguir_buscando)
+    if (capa0 == 0)
+        return 0; // Los comodines solos no forman combinaciones
+
+    uint64_t clave1 = capa1 | ((uint64_t)comodines << 60);
+    uint64_t h = (capa0 * 0x9E3779B97F4A7C15ULL) ^ (clave1 * 0xC2B2AE3D27D4EB4FULL);
+    memo_apeada_t *entrada = &s->memo[h >> (64 - MEMO_APEADA_BITS)];
+    if (entrada->generacion == s->generacion && entrada->capa0 == capa0 && entrada->capa1 == clave1)
     {
-        bool encontrado = priorizar_grupos
-                              ? buscar_mejor_grupo(mano, apeada, puntos) || buscar_mejor_escalera(mano, apeada, puntos)
-                              : buscar_mejor_escalera(mano, apeada, puntos) || buscar_mejor_grupo(mano, apeada, puntos);
+        return entrada->valor;
+    }
+
+    if (s->agotado || ++s->nodos > PRESUPUESTO_NODOS_APEADA)
+    {
+        s->agotado = true;
+        return 0; // Sin presupuesto: dejar el resto en la mano
+    }
 
-        seguir_buscando = encontrado;
+    int mejor = mejor_jugada_apeada(s, capa0, capa1, comodines, NULL);
+
+    if (!s->agotado)
+    {
+        *entrada = (memo_apeada_t){.capa0 = capa0, .capa1 = clave1, .generacion = s->generacion, .valor = mejor};
     }
+    return mejor;
 }
 
-// Busca combinación mixta óptima y la añade al banco
-void buscar_combinacion_mixta(mano_t *mano, apeada_t *apeada, int *puntos)
+static ficha_t tomar_ficha(reserva_fichas_t *reserva, int color, int numero)
 {
-    // Primero buscamos grupos que usen números con múltiples fichas
-    for (int i = 0; i < mano->cantidad - 2; i++)
-    {
-        if (mano->fichas[i].numero == 0)
-            continue;
+    int bit = BIT_SOLUCION(color, numero);
+    return reserva->fichas[bit][--reserva->cantidad[bit]];
+}
+
+static ficha_t tomar_comodin(reserva_fichas_t *reserva)
+{
+    return reserva->comodines[--reserva->num_comodines];
+}
 
-        int contador = 1;
-        for (int j = i + 1; j < mano->cantidad; j++)
+// Convierte la mejor partición de la mano en grupos y escaleras con fichas concretas
+static int reconstruir_apeada(solucionador_apeada_t *s, const mano_t *mano, uint64_t capa0, uint64_t capa1,
+                              apeada_t *apeada)
+{
+    reserva_fichas_t reserva = {0};
+    for (int i = 0; i < mano->cantidad; i++)
+    {
+        ficha_t ficha = mano->fichas[i];
+        if (ficha >= PRIMER_COMODIN)
         {
-            if (mano->fichas[j].numero == mano->fichas[i].numero)
-            {
-                contador++;
-            }
+            reserva.comodines[reserva.num_comodines++] = ficha;
         }
-
-        if (contador >= 2)
+        else
         {
-            buscar_mejor_grupo(mano, apeada, puntos);
+            int bit = BIT_SOLUCION(ficha_color(ficha), ficha_numero(ficha));
+            reserva.fichas[bit][reserva.cantidad[bit]++] = ficha;
         }
     }
 
-    // Luego buscamos escaleras con colores que tengan secuencias
-    for (int i = 0; i < mano->cantidad - 2; i++)
+    int comodines = mano->bits.comodines;
+    int puntos = 0;
+
+    while (capa0 != 0)
     {
-        if (mano->fichas[i].numero == 0)
-            continue;
+        jugada_apeada_t jugada;
+        mejor_jugada_apeada(s, capa0, capa1, comodines, &jugada);
 
-        for (int j = i + 1; j < mano->cantidad - 1; j++)
+        if (jugada.puntos > 0 && jugada.es_grupo)
+        {
+            grupo_t *grupo = &apeada->grupos[apeada->total_grupos++];
+            grupo->cantidad = 0;
+            for (int c = 0; c < NUM_COLORES; c++)
+            {
+                if (jugada.colores & (1u << c))
+                    grupo->fichas[grupo->cantidad++] = tomar_ficha(&reserva, c, jugada.numero);
+            }
+            for (int j = 0; j < jugada.comodines; j++)
+            {
+                grupo->fichas[grupo->cantidad++] = tomar_comodin(&reserva);
+            }
+            puntos += jugada.puntos;
+        }
+        else if (jugada.puntos > 0)
         {
-            if (strcmp(mano->fichas[i].color, mano->fichas[j].color) == 0)
+            escalera_t *escalera = &apeada->escaleras[apeada->total_escaleras++];
+            escalera->cantidad = 0;
+            for (int j = 0; j < jugada.al_inicio; j++)
+            {
+                escalera->fichas[escalera->cantidad++] = tomar_comodin(&reserva);
+            }
+            for (int n = jugada.numero; n < jugada.numero + jugada.largo - jugada.al_inicio; n++)
             {
-                buscar_mejor_escalera(mano, apeada, puntos);
+                escalera->fichas[escalera->cantidad++] = (jugada.numeros & (1u << (n - 1)))
+                                                             ? tomar_ficha(&reserva, jugada.color, n)
+                                                             : tomar_comodin(&reserva);
             }
+            puntos += jugada.puntos;
         }
+
+        comodines -= jugada.comodines;
+        capa0 = jugada.capa0;
+        capa1 = jugada.capa1;
+    }
+
+    return puntos;
+}
+
+// Calcula la partición de la mano en combinaciones con el máximo de puntos.
+// Devuelve los puntos; *exacta indica si se terminó dentro del presupuesto.
+int resolver_mejor_apeada(const mano_t *mano, apeada_t *apeada, bool *exacta)
+{
+    solucionador_apeada_t s = {
+        .memo = obtener_memo_apeada(),
+        .generacion = ++generacion_memo_apeada,
+        .nodos = 0,
+        .agotado = false};
+
+    if (s.generacion == 0)
+    {
+        // Desborde del contador: limpiar la tabla una vez
+        memset(s.memo, 0, sizeof(memo_apeada_t) * MEMO_APEADA_TAMANO);
+        s.generacion = ++generacion_memo_apeada;
     }
+
+    uint64_t capa0 = capa_a_solucion(mano->bits.capas[0]);
+    uint64_t capa1 = capa_a_solucion(mano->bits.capas[1]);
+
+    resolver_apeada(&s, capa0, capa1, mano->bits.comodines);
+    int puntos = reconstruir_apeada(&s, mano, capa0, capa1, apeada);
+
+    if (exacta != NULL)
+        *exacta = !s.agotado;
+    return puntos;
 }
 
 // ----------------------------------------------------------------------
@@ -980,14 +2067,14 @@ void mostrar_apeada(const apeada_t *apeada)
             printf("Grupo %d: ", i + 1);
             for (int j = 0; j < apeada->grupos[i].cantidad; j++)
             {
-                if (apeada->grupos[i].fichas[j].numero == 0)
+                if (ficha_numero(apeada->grupos[i].fichas[j]) == 0)
                 {
                     printf("[Comodín] ");
                 }
                 else
                 {
-                    printf("[%d %s] ", apeada->grupos[i].fichas[j].numero,
-                           apeada->grupos[i].fichas[j].color);
+                    printf("[%d %s] ", ficha_numero(apeada->grupos[i].fichas[j]),
+                           ficha_nombre_color(apeada->grupos[i].fichas[j]));
                 }
             }
             printf("\n");
@@ -1003,14 +2090,14 @@ void mostrar_apeada(const apeada_t *apeada)
             printf("Escalera %d: ", i + 1);
             for (int j = 0; j < apeada->escaleras[i].cantidad; j++)
             {
-                if (apeada->escaleras[i].fichas[j].numero == 0)
+                if (ficha_numero(apeada->escaleras[i].fichas[j]) == 0)
                 {
                     printf("[Comodín] ");
                 }
                 else
                 {
-                    printf("[%d %s] ", apeada->escaleras[i].fichas[j].numero,
-                           apeada->escaleras[i].fichas[j].color);
+                    printf("[%d %s] ", ficha_numero(apeada->escaleras[i].fichas[j]),
+                           ficha_nombre_color(apeada->escaleras[i].fichas[j]));
                 }
             }
             printf("\n");
@@ -1045,51 +2132,26 @@ apeada_t calcular_mejor_apeada_aux(const jugador_t *jugador)
 {
     apeada_t mejor_apeada;
     apeada_inicializar(&mejor_apeada);
-    int max_puntos = 0;
 
-    // Probar diferentes estrategias sin modificar la mano original
-    for (int estrategia = 0; estrategia < 3; estrategia++)
+    // Una mano ya vista cuya mejor partición no alcanza no se vuelve a resolver:
+    // la tabla guarda los puntos de la partición por el hash de la mano
+    uint64_t clave = jugador->mano.bits.zobrist ^ TT_APEADA;
+    uint64_t puntos_vistos;
+    if (tt_buscar(clave, &puntos_vistos) &&
+        (puntos_vistos == 0 || (!jugador->puntos_suficientes && puntos_vistos < PUNTOS_MINIMOS_APEADA)))
     {
-        // Crear copia temporal de la mano para pruebas
-        mano_t mano_temp;
-        mano_inicializar(&mano_temp, jugador->mano.capacidad);
-        memcpy(mano_temp.fichas, jugador->mano.fichas, jugador->mano.cantidad * sizeof(ficha_t));
-        mano_temp.cantidad = jugador->mano.cantidad;
-
-        apeada_t apeada_temp;
-        apeada_inicializar(&apeada_temp);
-        int puntos_temp = 0;
-
-        // Aplicar estrategia
-        switch (estrategia)
-        {
-        case 0:
-            buscar_combinaciones(&mano_temp, &apeada_temp, &puntos_temp, true);
-            break;
-        case 1:
-            buscar_combinaciones(&mano_temp, &apeada_temp, &puntos_temp, false);
-            break;
-        case 2:
-            buscar_combinacion_mixta(&mano_temp, &apeada_temp, &puntos_temp);
-            break;
-        }
-
-        // Validar si cumple mínimo para primera apeada
-        bool cumple_minimo = jugador->puntos_suficientes || puntos_temp >= PUNTOS_MINIMOS_APEADA;
+        return mejor_apeada;
+    }
 
-        // Actualizar mejor apeada si corresponde
-        if (puntos_temp > max_puntos && cumple_minimo)
-        {
-            apeada_liberar(&mejor_apeada);
-            mejor_apeada = apeada_temp;
-            max_puntos = puntos_temp;
-        }
-        else
-        {
-            apeada_liberar(&apeada_temp);
-        }
+    // Partición exacta de máximo puntaje, sin modificar la mano original
+    int puntos = resolver_mejor_apeada(&jugador->mano, &mejor_apeada, NULL);
+    tt_guardar(clave, (uint64_t)puntos);
 
-        mano_liberar(&mano_temp);
+    // Validar si cumple mínimo para primera apeada
+    bool cumple_minimo = jugador->puntos_suficientes || puntos >= PUNTOS_MINIMOS_APEADA;
+    if (!cumple_minimo)
+    {
+        apeada_liberar(&mejor_apeada);
     }
 
     return mejor_apeada;
@@ -1110,39 +2172,32 @@ apeada_t crear_mejor_apeada(jugador_t *jugador)
 
     if (apeada_valida)
     {
-        // Crear copia de la mano para modificar
-        mano_t mano_temp;
-        mano_inicializar(&mano_temp, jugador->mano.capacidad);
-        memcpy(mano_temp.fichas, jugador->mano.fichas, jugador->mano.cantidad * sizeof(ficha_t));
-        mano_temp.cantidad = jugador->mano.cantidad;
-
-        // Eliminar fichas usadas en la apeada
+        // Eliminar de la mano las fichas usadas en la apeada (grupos y escaleras, por
+        // ID de ficha). La apeada ya está calculada, así que no hace falta una copia.
         for (int g = 0; g < apeada_calculada.total_grupos; g++)
         {
             for (int c = 0; c < apeada_calculada.grupos[g].cantidad; c++)
             {
-                int idx = -1;
-                // Buscar la ficha en la mano (comparando todos los campos)
-                for (int i = 0; i < mano_temp.cantidad; i++)
+                int idx = encontrar_indice_ficha(&jugador->mano, &apeada_calculada.grupos[g].fichas[c]);
+                if (idx >= 0)
                 {
-                    if (memcmp(&mano_temp.fichas[i], &apeada_calculada.grupos[g].fichas[c], sizeof(ficha_t)) == 0)
-                    {
-                        idx = i;
-                        break;
-                    }
+                    remover_ficha(&jugador->mano, idx);
                 }
+            }
+        }
+
+        for (int e = 0; e < apeada_calculada.total_escaleras; e++)
+        {
+            for (int c = 0; c < apeada_calculada.escaleras[e].cantidad; c++)
+            {
+                int idx = encontrar_indice_ficha(&jugador->mano, &apeada_calculada.escaleras[e].fichas[c]);
                 if (idx >= 0)
                 {
-                    remover_ficha(&mano_temp, idx);
+                    remover_ficha(&jugador->mano, idx);
                 }
             }
         }
 
-        // Actualizar mano real del jugador
-        memcpy(jugador->mano.fichas, mano_temp.fichas, mano_temp.cantidad * sizeof(ficha_t));
-        jugador->mano.cantidad = mano_temp.cantidad;
-        mano_liberar(&mano_temp);
-
         // Transferir la apeada calculada a la de retorno
         mejor_apeada = apeada_calculada;
     }
@@ -1158,7 +2213,7 @@ apeada_t crear_mejor_apeada(jugador_t *jugador)
 bool son_fichas_iguales(const ficha_t ficha1, const ficha_t ficha2)
 {
     // Comparar número y color
-    return (ficha1.numero == ficha2.numero && strcmp(ficha1.color, ficha2.color) == 0);
+    return (ficha_numero(ficha1) == ficha_numero(ficha2) && ficha_color(ficha1) == ficha_color(ficha2));
 }
 
 void eliminar_ficha_de_mano(mano_t *mano, ficha_t ficha)
@@ -1168,11 +2223,7 @@ void eliminar_ficha_de_mano(mano_t *mano, ficha_t ficha)
         if (son_fichas_iguales(mano->fichas[i], ficha))
         {
             // Mover las fichas restantes una posición hacia atrás
-            for (int j = i; j < mano->cantidad - 1; j++)
-            {
-                mano->fichas[j] = mano->fichas[j + 1];
-            }
-            mano->cantidad--;
+            remover_ficha(mano, i);
             break;
         }
     }
@@ -1180,15 +2231,23 @@ void eliminar_ficha_de_mano(mano_t *mano, ficha_t ficha)
 
 bool realizar_apeada_optima(jugador_t *jugador, banco_de_apeadas_t *banco_mesa)
 {
+    contexto_juego_t *ctx = jugador->contexto;
+
     if (!jugador->en_juego || jugador->mano.cantidad < 3)
     {
-        printf("%s no puede realizar apeada (no está en juego o tiene muy pocas fichas).\n",
-               jugador->nombre);
+        if (!ctx->silencioso)
+            printf("%s no puede realizar apeada (no está en juego o tiene muy pocas fichas).\n",
+                   jugador->nombre);
         return false;
     }
 
+    int fichas_antes = jugador->mano.cantidad;
     apeada_t apeada_jugador = crear_mejor_apeada(jugador);
     int puntos_apeada = calcular_puntos_apeada(&apeada_jugador);
+    int grupos_evento = apeada_jugador.total_grupos < 15 ? apeada_jugador.total_grupos : 15;
+    int escaleras_evento = apeada_jugador.total_escaleras < 15 ? apeada_jugador.total_escaleras : 15;
+    bitacora_registrar(ctx, EVENTO_APEADA, jugador->id, fichas_antes - jugador->mano.cantidad,
+                       grupos_evento << 4 | escaleras_evento);
 
     // Validación estricta para primera apeada
     if (!jugador->puntos_suficientes)
@@ -1196,74 +2255,61 @@ bool realizar_apeada_optima(jugador_t *jugador, banco_de_apeadas_t *banco_mesa)
         if (puntos_apeada >= PUNTOS_MINIMOS_APEADA)
         {
             jugador->puntos_suficientes = true;
-            printf("\n%s ha realizado su primera apeada con %d puntos (mínimo requerido: %d)!\n",
-                   jugador->nombre, puntos_apeada, PUNTOS_MINIMOS_APEADA);
+            if (!ctx->silencioso)
+                printf("\n%s ha realizado su primera apeada con %d puntos (mínimo requerido: %d)!\n",
+                       jugador->nombre, puntos_apeada, PUNTOS_MINIMOS_APEADA);
         }
         else
         {
-            printf("\n%s no alcanzó el mínimo de %d puntos para la primera apeada.\n",
-                   jugador->nombre, PUNTOS_MINIMOS_APEADA);
+            if (!ctx->silencioso)
+                printf("\n%s no alcanzó el mínimo de %d puntos para la primera apeada.\n",
+                       jugador->nombre, PUNTOS_MINIMOS_APEADA);
             apeada_liberar(&apeada_jugador);
             return false;
         }
     }
     else if (puntos_apeada == 0)
     {
-        printf("\n%s no tiene combinaciones válidas para apear en este turno.\n", jugador->nombre);
+        if (!ctx->silencioso)
+            printf("\n%s no tiene combinaciones válidas para apear en este turno.\n", jugador->nombre);
         apeada_liberar(&apeada_jugador);
         return false;
     }
 
-    // Eliminar fichas usadas en la apeada de la mano del jugador ---
-    for (int i = 0; i < apeada_jugador.total_grupos; i++)
-    {
-        grupo_t *grupo = &apeada_jugador.grupos[i];
-        for (int j = 0; j < grupo->cantidad; j++)
-        {
-            eliminar_ficha_de_mano(&jugador->mano, grupo->fichas[j]);
-        }
-    }
-
-    for (int i = 0; i < apeada_jugador.total_escaleras; i++)
-    {
-        escalera_t *escalera = &apeada_jugador.escaleras[i];
-        for (int j = 0; j < escalera->cantidad; j++)
-        {
-            eliminar_ficha_de_mano(&jugador->mano, escalera->fichas[j]);
-        }
-    }
+    // crear_mejor_apeada ya quitó de la mano las fichas usadas en la apeada
 
     // Mostrar detalles de la apeada
-    mostrar_apeada(&apeada_jugador);
+    if (!ctx->silencioso)
+        mostrar_apeada(&apeada_jugador);
 
-    // Transferir grupos al banco
-    for (int i = 0; i < apeada_jugador.total_grupos && banco_mesa->total_grupos < MAX_GRUPOS; i++)
+    // Transferir grupos y escaleras al banco (crece si hace falta)
+    banco_reservar(banco_mesa, banco_mesa->total_grupos + apeada_jugador.total_grupos,
+                   banco_mesa->total_escaleras + apeada_jugador.total_escaleras);
+    for (int i = 0; i < apeada_jugador.total_grupos; i++)
     {
         banco_mesa->grupos[banco_mesa->total_grupos++] = apeada_jugador.grupos[i];
+        indice_actualizar_grupo(banco_mesa, banco_mesa->total_grupos - 1);
     }
 
-    // Transferir escaleras al banco
-    for (int i = 0; i < apeada_jugador.total_escaleras && banco_mesa->total_escaleras < MAX_ESCALERAS; i++)
+    for (int i = 0; i < apeada_jugador.total_escaleras; i++)
     {
         banco_mesa->escaleras[banco_mesa->total_escaleras++] = apeada_jugador.escaleras[i];
+        indice_actualizar_escalera(banco_mesa, banco_mesa->total_escaleras - 1);
     }
 
     // Actualizar estadísticas
-    pcbs[jugador->id - 1].grupos_formados += apeada_jugador.total_grupos;
-    pcbs[jugador->id - 1].escaleras_formadas += apeada_jugador.total_escaleras;
-    pcbs[jugador->id - 1].puntos += puntos_apeada;
+    ctx->pcbs[jugador->id - 1].grupos_formados += apeada_jugador.total_grupos;
+    ctx->pcbs[jugador->id - 1].escaleras_formadas += apeada_jugador.total_escaleras;
+    ctx->pcbs[jugador->id - 1].puntos += puntos_apeada;
 
     // Registrar victoria con escalera si aplica
     if (apeada_jugador.total_escaleras > 0 && jugador->mano.cantidad == 0)
     {
-        pcbs[jugador->id - 1].victorias_con_escalera++;
-        printf("\n%s ha ganado usando al menos una escalera. ¡Se registra victoria con escalera!\n", jugador->nombre);
+        ctx->pcbs[jugador->id - 1].victorias_con_escalera++;
+        if (!ctx->silencioso)
+            printf("\n%s ha ganado usando al menos una escalera. ¡Se registra victoria con escalera!\n", jugador->nombre);
     }
 
-    // Liberar recursos (solo estructuras, no las fichas transferidas)
-    free(apeada_jugador.grupos);
-    free(apeada_jugador.escaleras);
-
     return true;
 }
 
@@ -1282,9 +2328,9 @@ bool puede_embonar_grupo(const ficha_t *ficha, const grupo_t *grupo)
     int numero_base = -1;
     for (int i = 0; i < grupo->cantidad; i++)
     {
-        if (grupo->fichas[i].numero != 0)
+        if (ficha_numero(grupo->fichas[i]) != 0)
         {
-            numero_base = grupo->fichas[i].numero;
+            numero_base = ficha_numero(grupo->fichas[i]);
             break;
         }
     }
@@ -1294,7 +2340,7 @@ bool puede_embonar_grupo(const ficha_t *ficha, const grupo_t *grupo)
         return true;
 
     // La ficha debe coincidir con el número base o ser comodín
-    return (ficha->numero == numero_base || ficha->numero == 0);
+    return (ficha_numero(*ficha) == numero_base || ficha_numero(*ficha) == 0);
 }
 
 // Verifica si una ficha puede ser agregada a una escalera existente
@@ -1304,186 +2350,211 @@ bool puede_embonar_escalera(const ficha_t *ficha, const escalera_t *escalera)
     if (escalera->cantidad >= MAX_FICHAS_ESCALERA)
         return false;
 
-    // Buscar color base y valores existentes
-    char color_base[MAX_COLOR] = "";
-    int valores[MAX_FICHAS_ESCALERA];
-    int num_valores = 0;
-    int comodines = 0;
+    // Buscar color base y números existentes (bit n-1 por número)
+    int color_base = -1;
+    unsigned numeros = 0;
 
     for (int i = 0; i < escalera->cantidad; i++)
     {
-        if (escalera->fichas[i].numero == 0)
-        {
-            comodines++;
-        }
-        else
+        if (ficha_numero(escalera->fichas[i]) != 0)
         {
-            if (strlen(color_base) == 0)
-            {
-                strcpy(color_base, escalera->fichas[i].color);
-            }
-            valores[num_valores++] = escalera->fichas[i].numero;
+            numeros |= 1u << (ficha_numero(escalera->fichas[i]) - 1);
+            if (color_base == -1)
+                color_base = ficha_color(escalera->fichas[i]);
         }
     }
 
-    // Si no hay fichas no-comodín, cualquier ficha del mismo color puede unirse
-    if (num_valores == 0)
+    // Si no hay fichas no-comodín, cualquier ficha puede unirse
+    if (numeros == 0)
     {
-        return (strcmp(ficha->color, color_base) == 0 || strlen(color_base) == 0);
+        return true;
     }
 
     // Verificar color
-    if (strcmp(ficha->color, color_base) != 0 && ficha->numero != 0)
+    if ((int)ficha_color(*ficha) != color_base && ficha_numero(*ficha) != 0)
     {
         return false;
     }
 
-    // Ordenar valores
-    for (int i = 0; i < num_valores - 1; i++)
+    // Comodín siempre puede agregarse
+    if (ficha_numero(*ficha) == 0)
     {
-        for (int j = i + 1; j < num_valores; j++)
-        {
-            if (valores[i] > valores[j])
-            {
-                int temp = valores[i];
-                valores[i] = valores[j];
-                valores[j] = temp;
-            }
-        }
+        return true;
     }
 
-    // Verificar si la ficha puede encajar en la secuencia
-    if (ficha->numero != 0)
-    { // No es comodín
-        // Verificar si el número ya existe
-        for (int i = 0; i < num_valores; i++)
-        {
-            if (valores[i] == ficha->numero)
-            {
-                return false;
-            }
-        }
+    // El número no debe existir y debe caer en un hueco interno o junto a un extremo
+    int numero = ficha_numero(*ficha);
+    int menor = __builtin_ctz(numeros) + 1;
+    int mayor = 32 - __builtin_clz(numeros);
+    return !(numeros & (1u << (numero - 1))) && numero >= menor - 1 && numero <= mayor + 1;
+}
 
-        // Verificar extremos
-        if (ficha->numero == valores[0] - 1 || ficha->numero == valores[num_valores - 1] + 1)
-        {
-            return true;
-        }
+// Clave de una ficha en el índice de embones (la copia no importa)
+static inline int indice_clave(ficha_t ficha)
+{
+    return ficha >= PRIMER_COMODIN ? INDICE_COMODIN : ficha_bit(ficha);
+}
 
-        // Verificar huecos internos
-        for (int i = 0; i < num_valores - 1; i++)
-        {
-            if (ficha->numero > valores[i] && ficha->numero < valores[i + 1])
-            {
-                return true;
-            }
-        }
-    }
-    else
-    {                // Es comodín
-        return true; // Comodín siempre puede agregarse
+// Ficha representante de una clave del índice
+static inline ficha_t indice_ficha(int clave)
+{
+    return clave == INDICE_COMODIN ? (ficha_t)PRIMER_COMODIN : (ficha_t)clave;
+}
+
+static void indice_recalcular_aceptadas(indice_embon_t *indice)
+{
+    indice->aceptadas = 0;
+    for (int k = 0; k <= INDICE_COMODIN; k++)
+    {
+        if (indice->grupos[k] | indice->escaleras[k])
+            indice->aceptadas |= 1ULL << k;
     }
+}
+
+static inline void indice_marcar(uint64_t *mascara, uint64_t bit, bool activo)
+{
+    *mascara = activo ? (*mascara | bit) : (*mascara & ~bit);
+}
 
+static bool tiene_comodin(const ficha_t fichas[], int cantidad)
+{
+    for (int i = 0; i < cantidad; i++)
+    {
+        if (ficha_numero(fichas[i]) == 0)
+            return true;
+    }
     return false;
 }
 
+// Recalcula las entradas del índice del grupo g tras crearlo o modificarlo
+void indice_actualizar_grupo(banco_de_apeadas_t *banco, int g)
+{
+    indice_embon_t *indice = &banco->indice;
+    const grupo_t *grupo = &banco->grupos[g];
+    uint64_t bit = 1ULL << g;
+
+    for (int k = 0; k <= INDICE_COMODIN; k++)
+    {
+        ficha_t ficha = indice_ficha(k);
+        indice_marcar(&indice->grupos[k], bit, puede_embonar_grupo(&ficha, grupo));
+    }
+    indice_marcar(&indice->grupos_con_comodin, bit, tiene_comodin(grupo->fichas, grupo->cantidad));
+    indice_marcar(&indice->grupos_con_espacio, bit, grupo->cantidad < MAX_FICHAS_GRUPO);
+    indice_recalcular_aceptadas(indice);
+    zobrist_reemplazar(&banco->zobrist, &banco->zobrist_grupos[g], zobrist_grupo(g, grupo));
+}
+
+// Recalcula las entradas del índice de la escalera e tras crearla o modificarla
+void indice_actualizar_escalera(banco_de_apeadas_t *banco, int e)
+{
+    indice_embon_t *indice = &banco->indice;
+    const escalera_t *escalera = &banco->escaleras[e];
+    uint64_t bit = 1ULL << e;
+
+    for (int k = 0; k <= INDICE_COMODIN; k++)
+    {
+        ficha_t ficha = indice_ficha(k);
+        indice_marcar(&indice->escaleras[k], bit, puede_embonar_escalera(&ficha, escalera));
+    }
+    indice_marcar(&indice->escaleras_con_comodin, bit, tiene_comodin(escalera->fichas, escalera->cantidad));
+    indice_marcar(&indice->escaleras_con_espacio, bit, escalera->cantidad < MAX_FICHAS_ESCALERA);
+    indice_recalcular_aceptadas(indice);
+    zobrist_reemplazar(&banco->zobrist, &banco->zobrist_escaleras[e], zobrist_escalera(e, escalera));
+}
+
 // Intenta mover un comodín de un grupo a otro lugar para liberar espacio
 bool mover_comodin_para_embonar(banco_de_apeadas_t *banco, const ficha_t *ficha)
 {
-    // Buscar comodines en grupos
-    for (int g = 0; g < banco->total_grupos; g++)
+    // Solo se prueban las combinaciones con comodín, y como destino la primera
+    // con espacio (la misma que encontraba el recorrido completo)
+    const indice_embon_t *indice = &banco->indice;
+
+    // Comodines en grupos
+    if (indice->escaleras_con_espacio != 0)
     {
-        grupo_t *grupo = &banco->grupos[g];
+        int e = __builtin_ctzll(indice->escaleras_con_espacio);
+        escalera_t *escalera = &banco->escaleras[e];
 
-        // Buscar comodines en este grupo
-        for (int i = 0; i < grupo->cantidad; i++)
+        for (uint64_t candidatos = indice->grupos_con_comodin; candidatos != 0; candidatos &= candidatos - 1)
         {
-            if (grupo->fichas[i].numero == 0)
-            { // Es comodín
-                // Intentar mover este comodín a una escalera
-                for (int e = 0; e < banco->total_escaleras; e++)
-                {
-                    escalera_t *escalera = &banco->escaleras[e];
-
-                    if (escalera->cantidad < MAX_FICHAS_ESCALERA)
-                    {
-                        // Mover comodín del grupo a la escalera
-                        ficha_t comodin = grupo->fichas[i];
+            int g = __builtin_ctzll(candidatos);
+            grupo_t *grupo = &banco->grupos[g];
 
-                        // Eliminar comodín del grupo
-                        for (int j = i; j < grupo->cantidad - 1; j++)
-                        {
-                            grupo->fichas[j] = grupo->fichas[j + 1];
-                        }
-                        grupo->cantidad--;
+            // Buscar comodines en este grupo
+            for (int i = 0; i < grupo->cantidad; i++)
+            {
+                if (ficha_numero(grupo->fichas[i]) != 0)
+                    continue;
 
-                        // Agregar comodín a la escalera
-                        escalera->fichas[escalera->cantidad++] = comodin;
+                // Mover comodín del grupo a la escalera
+                ficha_t comodin = grupo->fichas[i];
 
-                        // Ahora intentar embonar la ficha original en el grupo
-                        if (puede_embonar_grupo(ficha, grupo))
-                        {
-                            return true;
-                        }
+                // Eliminar comodín del grupo
+                for (int j = i; j < grupo->cantidad - 1; j++)
+                {
+                    grupo->fichas[j] = grupo->fichas[j + 1];
+                }
+                grupo->cantidad--;
 
-                        // Si no funciona, revertir el movimiento
-                        // Devolver comodín al grupo
-                        grupo->fichas[grupo->cantidad++] = comodin;
-                        // Quitar de la escalera
-                        escalera->cantidad--;
+                // Agregar comodín a la escalera
+                escalera->fichas[escalera->cantidad++] = comodin;
 
-                        break;
-                    }
+                // Ahora intentar embonar la ficha original en el grupo
+                if (puede_embonar_grupo(ficha, grupo))
+                {
+                    indice_actualizar_grupo(banco, g);
+                    indice_actualizar_escalera(banco, e);
+                    return true;
                 }
+
+                // Si no funciona, revertir el movimiento (el comodín vuelve al final)
+                grupo->fichas[grupo->cantidad++] = comodin;
+                escalera->cantidad--;
             }
         }
     }
 
-    // Buscar comodines en escaleras
-    for (int e = 0; e < banco->total_escaleras; e++)
+    // Comodines en escaleras
+    if (indice->grupos_con_espacio != 0)
     {
-        escalera_t *escalera = &banco->escaleras[e];
+        int g = __builtin_ctzll(indice->grupos_con_espacio);
+        grupo_t *grupo = &banco->grupos[g];
 
-        // Buscar comodines en esta escalera
-        for (int i = 0; i < escalera->cantidad; i++)
+        for (uint64_t candidatos = indice->escaleras_con_comodin; candidatos != 0; candidatos &= candidatos - 1)
         {
-            if (escalera->fichas[i].numero == 0)
-            { // Es comodín
-                // Intentar mover este comodín a un grupo
-                for (int g = 0; g < banco->total_grupos; g++)
-                {
-                    grupo_t *grupo = &banco->grupos[g];
-
-                    if (grupo->cantidad < MAX_FICHAS_GRUPO)
-                    {
-                        // Mover comodín de la escalera al grupo
-                        ficha_t comodin = escalera->fichas[i];
+            int e = __builtin_ctzll(candidatos);
+            escalera_t *escalera = &banco->escaleras[e];
 
-                        // Eliminar comodín de la escalera
-                        for (int j = i; j < escalera->cantidad - 1; j++)
-                        {
-                            escalera->fichas[j] = escalera->fichas[j + 1];
-                        }
-                        escalera->cantidad--;
+            // Buscar comodines en esta escalera
+            for (int i = 0; i < escalera->cantidad; i++)
+            {
+                if (ficha_numero(escalera->fichas[i]) != 0)
+                    continue;
 
-                        // Agregar comodín al grupo
-                        grupo->fichas[grupo->cantidad++] = comodin;
+                // Mover comodín de la escalera al grupo
+                ficha_t comodin = escalera->fichas[i];
 
-                        // Ahora intentar embonar la ficha original en la escalera
-                        if (puede_embonar_escalera(ficha, escalera))
-                        {
-                            return true;
-                        }
+                // Eliminar comodín de la escalera
+                for (int j = i; j < escalera->cantidad - 1; j++)
+                {
+                    escalera->fichas[j] = escalera->fichas[j + 1];
+                }
+                escalera->cantidad--;
 
-                        // Si no funciona, revertir el movimiento
-                        // Devolver comodín a la escalera
-                        escalera->fichas[escalera->cantidad++] = comodin;
-                        // Quitar del grupo
-                        grupo->cantidad--;
+                // Agregar comodín al grupo
+                grupo->fichas[grupo->cantidad++] = comodin;
 
-                        break;
-                    }
+                // Ahora intentar embonar la ficha original en la escalera
+                if (puede_embonar_escalera(ficha, escalera))
+                {
+                    indice_actualizar_grupo(banco, g);
+                    indice_actualizar_escalera(banco, e);
+                    return true;
                 }
+
+                // Si no funciona, revertir el movimiento (el comodín vuelve al final)
+                escalera->fichas[escalera->cantidad++] = comodin;
+                grupo->cantidad--;
             }
         }
     }
@@ -1494,40 +2565,42 @@ bool mover_comodin_para_embonar(banco_de_apeadas_t *banco, const ficha_t *ficha)
 // Función para intentar embonar una ficha en un grupo o escalera
 bool intentar_embonar_ficha(ficha_t *ficha, banco_de_apeadas_t *banco)
 {
-    // Intentar embonar en grupos
-    for (int i = 0; i < banco->total_grupos; i++)
+    int clave = indice_clave(*ficha);
+
+    // Intentar embonar en grupos (el primero que la acepte, según el índice)
+    if (banco->indice.grupos[clave] != 0)
     {
-        if (puede_embonar_grupo(ficha, &banco->grupos[i]))
-        {
-            banco->grupos[i].fichas[banco->grupos[i].cantidad++] = *ficha;
-            return true;
-        }
+        int g = __builtin_ctzll(banco->indice.grupos[clave]);
+        banco->grupos[g].fichas[banco->grupos[g].cantidad++] = *ficha;
+        indice_actualizar_grupo(banco, g);
+        return true;
     }
 
     // Intentar embonar en escaleras
-    for (int i = 0; i < banco->total_escaleras; i++)
+    if (banco->indice.escaleras[clave] != 0)
     {
-        if (puede_embonar_escalera(ficha, &banco->escaleras[i]))
-        {
-            banco->escaleras[i].fichas[banco->escaleras[i].cantidad++] = *ficha;
-            return true;
-        }
+        int e = __builtin_ctzll(banco->indice.escaleras[clave]);
+        banco->escaleras[e].fichas[banco->escaleras[e].cantidad++] = *ficha;
+        indice_actualizar_escalera(banco, e);
+        return true;
     }
 
     // Si no se pudo embonar, intentar crear un nuevo grupo o escalera
-    if (banco->total_grupos < MAX_GRUPOS && es_grupo_valido(ficha, 1))
+    if (es_grupo_valido(ficha, 1))
     {
-        grupo_t *nuevo_grupo = &banco->grupos[banco->total_grupos++];
+        grupo_t *nuevo_grupo = banco_nuevo_grupo(banco);
         nuevo_grupo->fichas[0] = *ficha;
         nuevo_grupo->cantidad = 1;
+        indice_actualizar_grupo(banco, banco->total_grupos - 1);
         return true;
     }
 
-    if (banco->total_escaleras < MAX_ESCALERAS && es_escalera_valida(ficha, 1))
+    if (es_escalera_valida(ficha, 1))
     {
-        escalera_t *nueva_escalera = &banco->escaleras[banco->total_escaleras++];
+        escalera_t *nueva_escalera = banco_nueva_escalera(banco);
         nueva_escalera->fichas[0] = *ficha;
         nueva_escalera->cantidad = 1;
+        indice_actualizar_escalera(banco, banco->total_escaleras - 1);
         return true;
     }
 
@@ -1544,115 +2617,108 @@ bool intentar_mover_comodin_y_embonar(ficha_t *ficha, banco_de_apeadas_t *banco)
     return false;
 }
 
-// Función principal para embonar una ficha del jugador al banco
-bool embonar_ficha(jugador_t *jugador, banco_de_apeadas_t *banco, int indice_ficha)
+// Coloca una ficha en la mesa: directamente, moviendo antes un comodín o como
+// combinación nueva
+static bool colocar_ficha_en_mesa(jugador_t *jugador, banco_de_apeadas_t *banco, ficha_t ficha)
 {
-    if (indice_ficha < 0 || indice_ficha >= jugador->mano.cantidad)
-    {
-        return false; // Índice inválido
-    }
-
-    ficha_t ficha = jugador->mano.fichas[indice_ficha];
-
     // Intentar embonar directamente
     if (intentar_embonar_ficha(&ficha, banco))
     {
-        remover_ficha(&jugador->mano, indice_ficha);
         return true;
     }
 
-    // Intentar mover comodines y luego embonar
-    if (intentar_mover_comodin_y_embonar(&ficha, banco))
+    // Intentar mover comodines y luego embonar. El movimiento queda hecho aunque
+    // el embón falle, por eso se registra aparte.
+    if (mover_comodin_para_embonar(banco, &ficha))
     {
-        remover_ficha(&jugador->mano, indice_ficha);
-        return true;
+        bitacora_registrar(jugador->contexto, EVENTO_COMODIN, jugador->id, ficha, 0);
+        if (intentar_embonar_ficha(&ficha, banco))
+        {
+            return true;
+        }
     }
 
     // Intentar crear un nuevo grupo o escalera
-    if (banco->total_grupos < MAX_GRUPOS && es_grupo_valido(&ficha, 1))
+    if (es_grupo_valido(&ficha, 1))
     {
-        grupo_t *nuevo_grupo = &banco->grupos[banco->total_grupos++];
+        grupo_t *nuevo_grupo = banco_nuevo_grupo(banco);
         nuevo_grupo->fichas[0] = ficha;
         nuevo_grupo->cantidad = 1;
-        remover_ficha(&jugador->mano, indice_ficha);
+        indice_actualizar_grupo(banco, banco->total_grupos - 1);
         return true;
     }
 
-    if (banco->total_escaleras < MAX_ESCALERAS && es_escalera_valida(&ficha, 1))
+    if (es_escalera_valida(&ficha, 1))
     {
-        escalera_t *nueva_escalera = &banco->escaleras[banco->total_escaleras++];
+        escalera_t *nueva_escalera = banco_nueva_escalera(banco);
         nueva_escalera->fichas[0] = ficha;
         nueva_escalera->cantidad = 1;
-        remover_ficha(&jugador->mano, indice_ficha);
+        indice_actualizar_escalera(banco, banco->total_escaleras - 1);
         return true;
     }
 
     return false; // No se pudo embonar ni crear un nuevo grupo/escalera
 }
 
+// Función principal para embonar una ficha del jugador al banco
+bool embonar_ficha(jugador_t *jugador, banco_de_apeadas_t *banco, int indice_ficha)
+{
+    if (indice_ficha < 0 || indice_ficha >= jugador->mano.cantidad)
+    {
+        return false; // Índice inválido
+    }
+
+    ficha_t ficha = jugador->mano.fichas[indice_ficha];
+    if (!colocar_ficha_en_mesa(jugador, banco, ficha))
+    {
+        return false;
+    }
+
+    remover_ficha(&jugador->mano, indice_ficha);
+    bitacora_registrar(jugador->contexto, EVENTO_EMBON, jugador->id, ficha, 0);
+    return true;
+}
+
 // Verifica si una ficha puede embonar en algún grupo o escalera del banco
 bool existe_embon_posible_aux(const jugador_t *jugador, const banco_de_apeadas_t *banco)
 {
-    // 1. Verificar embón en grupos/escaleras existentes
+    // 1. Verificar embón en grupos/escaleras existentes: intersección de la mano
+    //    en bits con las fichas que acepta el índice de la mesa
+    const mano_bits_t *bits = &jugador->mano.bits;
+    uint64_t aceptadas = banco->indice.aceptadas;
+    if (((bits->capas[0] | bits->capas[1]) & aceptadas) != 0 ||
+        (bits->comodines > 0 && ((aceptadas >> INDICE_COMODIN) & 1)))
+    {
+        return true;
+    }
+
+    // 2. Verificar si puede crear nuevos grupos/escaleras (el banco crece, siempre hay lugar)
     for (int i = 0; i < jugador->mano.cantidad; i++)
     {
         const ficha_t *ficha = &jugador->mano.fichas[i];
 
-        // Verificar grupos
-        for (int g = 0; g < banco->total_grupos; g++)
+        // Crear nuevo grupo (necesita al menos 2 fichas iguales + comodines)
+        int contador = 0;
+        for (int j = 0; j < jugador->mano.cantidad; j++)
         {
-            if (puede_embonar_grupo(ficha, &banco->grupos[g]))
+            if (i != j && (ficha_numero(jugador->mano.fichas[j]) == ficha_numero(*ficha) ||
+                           ficha_numero(jugador->mano.fichas[j]) == 0))
             {
-                return true;
-            }
-        }
-
-        // Verificar escaleras
-        for (int e = 0; e < banco->total_escaleras; e++)
-        {
-            if (puede_embonar_escalera(ficha, &banco->escaleras[e]))
-            {
-                return true;
+                contador++;
+                if (contador >= 2)
+                    return true; // 2 fichas iguales o 1 + comodín
             }
         }
-    }
 
-    // 2. Verificar si puede crear nuevos grupos/escaleras (solo si hay espacio)
-    if (banco->total_grupos < MAX_GRUPOS || banco->total_escaleras < MAX_ESCALERAS)
-    {
-        for (int i = 0; i < jugador->mano.cantidad; i++)
+        // Crear nueva escalera (necesita fichas consecutivas del mismo color)
+        for (int j = 0; j < jugador->mano.cantidad; j++)
         {
-            const ficha_t *ficha = &jugador->mano.fichas[i];
-
-            // Crear nuevo grupo (necesita al menos 2 fichas iguales + comodines)
-            if (banco->total_grupos < MAX_GRUPOS)
-            {
-                int contador = 0;
-                for (int j = 0; j < jugador->mano.cantidad; j++)
-                {
-                    if (i != j && (jugador->mano.fichas[j].numero == ficha->numero ||
-                                   jugador->mano.fichas[j].numero == 0))
-                    {
-                        contador++;
-                        if (contador >= 2)
-                            return true; // 2 fichas iguales o 1 + comodín
-                    }
-                }
-            }
-
-            // Crear nueva escalera (necesita fichas consecutivas del mismo color)
-            if (banco->total_escaleras < MAX_ESCALERAS)
+            if (i != j && ficha_color(jugador->mano.fichas[j]) == ficha_color(*ficha))
             {
-                for (int j = 0; j < jugador->mano.cantidad; j++)
-                {
-                    if (i != j && strcmp(jugador->mano.fichas[j].color, ficha->color) == 0)
-                    {
-                        int diff = abs(jugador->mano.fichas[j].numero - ficha->numero);
-                        if (diff <= 2 || diff == 12)
-                        { // Ej: Q-K-A o 2-3-4
-                            return true;
-                        }
-                    }
+                int diff = abs(ficha_numero(jugador->mano.fichas[j]) - ficha_numero(*ficha));
+                if (diff <= 2 || diff == 12)
+                { // Ej: Q-K-A o 2-3-4
+                    return true;
                 }
             }
         }
@@ -1672,14 +2738,14 @@ int calcular_puntos_mano(const mano_t *mano)
     for (int i = 0; i < mano->cantidad; i++)
     {
         // Comodines valen 20 puntos
-        if (mano->fichas[i].numero == 0)
+        if (ficha_numero(mano->fichas[i]) == 0)
         {
             puntos += 20;
         }
         // Fichas normales valen su valor numérico
         else
         {
-            puntos += mano->fichas[i].numero;
+            puntos += ficha_numero(mano->fichas[i]);
         }
     }
     return puntos;
@@ -1725,52 +2791,105 @@ int determinar_ganador(jugador_t *jugadores, int num_jugadores, bool mazo_vacio)
     return -1;
 }
 
+// ----------------------------------------------------------------------
+// Generador de números aleatorios (xoshiro256**)
+// ----------------------------------------------------------------------
+
+// Cada partida tiene su generador: misma semilla, misma partida, sin estado global
+// compartido entre hilos (a diferencia de rand()).
+
+static inline uint64_t rotar_izquierda(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// Expande una semilla de 64 bits al estado completo con splitmix64, de modo que
+// semillas consecutivas den secuencias sin correlación
+void generador_sembrar(generador_t *gen, uint64_t semilla)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t z = (semilla += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gen->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t generador_siguiente(generador_t *gen)
+{
+    uint64_t *s = gen->s;
+    uint64_t resultado = rotar_izquierda(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotar_izquierda(s[3], 45);
+
+    return resultado;
+}
+
+// Entero uniforme en [0, limite) sin el sesgo de "% limite" (método de Lemire:
+// se rechazan los valores de la franja que no se reparte por igual)
+uint32_t generador_rango(generador_t *gen, uint32_t limite)
+{
+    uint64_t m = (generador_siguiente(gen) >> 32) * limite;
+    if ((uint32_t)m < limite)
+    {
+        uint32_t umbral = -limite % limite;
+        while ((uint32_t)m < umbral)
+            m = (generador_siguiente(gen) >> 32) * limite;
+    }
+    return (uint32_t)(m >> 32);
+}
+
 // ----------------------------------------------------------------------
 // Funciones para el Mazo
 // ----------------------------------------------------------------------
-void inicializar_mazo(mazo_t *mazo)
+void inicializar_mazo(mazo_t *mazo, const reglas_t *reglas)
 {
-    const char *colores[] = {"rojo", "negro", "azul", "amarillo"};
     int index = 0;
 
-    // Generar las 104 fichas normales (2 juegos de 1-13 en 4 colores)
-    for (int k = 0; k < 2; k++)
+    // Generar las fichas normales (con dos barajas, 104: 2 juegos de 1-13 en 4 colores)
+    for (int k = 0; k < reglas->barajas; k++)
     {
-        for (int c = 0; c < 4; c++)
+        for (int c = 0; c < NUM_COLORES; c++)
         {
-            for (int n = 1; n <= 13; n++)
+            for (int n = 1; n <= NUM_RANGOS; n++)
             {
-                mazo->fichas[index].numero = n;
-                strcpy(mazo->fichas[index].color, colores[c]);
+                mazo->fichas[index] = ficha_crear(k, (color_t)c, n);
                 index++;
             }
         }
     }
 
-    // Agregar los 4 comodines
-    for (int j = 0; j < 4; j++)
+    // Agregar los comodines (IDs desde PRIMER_COMODIN aunque haya una sola baraja)
+    for (int j = 0; j < reglas->comodines; j++)
     {
-        mazo->fichas[index].numero = 0;
-        strcpy(mazo->fichas[index].color, "comodin");
+        mazo->fichas[index] = (ficha_t)(PRIMER_COMODIN + j);
         index++;
     }
 
     mazo->cantidad = index;
 
-    // Validar que el mazo tenga exactamente 108 fichas
-    if (mazo->cantidad != MAX_FICHAS)
+    // Validar que el mazo tenga las fichas que piden las reglas
+    if (mazo->cantidad != reglas_fichas_mazo(reglas))
     {
-        fprintf(stderr, "Error: El mazo no tiene 108 fichas. Tiene %d fichas.\n", mazo->cantidad);
+        fprintf(stderr, "Error: El mazo no tiene %d fichas. Tiene %d fichas.\n", reglas_fichas_mazo(reglas),
+                mazo->cantidad);
         exit(EXIT_FAILURE);
     }
 }
 
-void barajar_mazo(mazo_t *mazo)
+// Fisher-Yates: cada permutación del mazo es igual de probable
+void barajar_mazo(mazo_t *mazo, generador_t *gen)
 {
-    srand(time(NULL));
-    for (int i = 0; i < mazo->cantidad; i++)
+    for (int i = mazo->cantidad - 1; i > 0; i--)
     {
-        int j = rand() % mazo->cantidad;
+        int j = (int)generador_rango(gen, (uint32_t)i + 1);
         ficha_t temp = mazo->fichas[i];
         mazo->fichas[i] = mazo->fichas[j];
         mazo->fichas[j] = temp;
@@ -1782,6 +2901,8 @@ void barajar_mazo(mazo_t *mazo)
 // ----------------------------------------------------------------------
 void agregar_ficha(mano_t *mano, ficha_t ficha)
 {
+    bits_agregar(&mano->bits, ficha);
+
     if (mano->cantidad < mano->capacidad)
     {
         mano->fichas[mano->cantidad] = ficha;
@@ -1791,7 +2912,7 @@ void agregar_ficha(mano_t *mano, ficha_t ficha)
     {
         // Si la mano está llena, aumentar la capacidad y reasignar memoria
         mano->capacidad *= 2;
-        mano->fichas = realloc(mano->fichas, sizeof(ficha_t) * mano->capacidad);
+        mano->fichas = reasignar(mano->fichas, sizeof(ficha_t) * mano->capacidad);
         if (mano->fichas == NULL)
         {
             fprintf(stderr, "Error al reasignar memoria para la mano\n");
@@ -1802,13 +2923,32 @@ void agregar_ficha(mano_t *mano, ficha_t ficha)
     }
 }
 
+// Copia las fichas de origen sobre destino (ya inicializada), creciendo si no caben
+void mano_copiar(mano_t *destino, const mano_t *origen)
+{
+    if (destino->capacidad < origen->cantidad)
+    {
+        ficha_t *fichas = (ficha_t *)reasignar(destino->fichas, sizeof(ficha_t) * origen->capacidad);
+        if (fichas == NULL)
+        {
+            fprintf(stderr, "Error al reasignar memoria para la mano\n");
+            exit(EXIT_FAILURE);
+        }
+        destino->fichas = fichas;
+        destino->capacidad = origen->capacidad;
+    }
+    memcpy(destino->fichas, origen->fichas, sizeof(ficha_t) * origen->cantidad);
+    destino->cantidad = origen->cantidad;
+    destino->bits = origen->bits;
+}
+
 void mostrar_mano(mano_t *mano)
 {
     printf("\nFichas en mano (%d):\n", mano->cantidad);
     printf("────────────────────────\n");
     for (int i = 0; i < mano->cantidad; i++)
     {
-        if (mano->fichas[i].numero == 0)
+        if (ficha_numero(mano->fichas[i]) == 0)
         {
             printf("[%2d] Comodín\n", i + 1);
         }
@@ -1816,8 +2956,8 @@ void mostrar_mano(mano_t *mano)
         {
             printf("[%2d] %2d de %s\n", 
                    i + 1, 
-                   mano->fichas[i].numero, 
-                   mano->fichas[i].color);
+                   ficha_numero(mano->fichas[i]), 
+                   ficha_nombre_color(mano->fichas[i]));
         }
     }
     printf("────────────────────────\n");
@@ -1836,6 +2976,7 @@ void inicializar_jugador(jugador_t *jugador, int id, char nombre[], ficha_t fich
     jugador->id = id;
     strcpy(jugador->nombre, nombre);
     jugador->mano.cantidad = 0;
+    memset(&jugador->mano.bits, 0, sizeof(mano_bits_t));
     // Suponemos que "cantidad" es el número de fichas iniciales
     for (int i = 0; i < cantidad; i++)
     {
@@ -1843,13 +2984,19 @@ void inicializar_jugador(jugador_t *jugador, int id, char nombre[], ficha_t fich
     }
 }
 
-void escribir_pcb(pcb_t jugador) {
+// Escribe el PCB en un temporal y lo renombra: quien lea el archivo ve la
+// versión anterior completa o la nueva completa, nunca una a medias.
+static void guardar_pcb_en_archivo(const pcb_t *pcb)
+{
+    pcb_t jugador = *pcb;
     char filename[30];
+    char temporal[34];
     sprintf(filename, "PCB_Jugador%d.txt", jugador.id_jugador);
+    sprintf(temporal, "%s.tmp", filename);
 
-    FILE *file = fopen(filename, "w");
+    FILE *file = fopen(temporal, "w");
     if (file == NULL) {
-        printf("Error al abrir %s\n", filename);
+        printf("Error al abrir %s\n", temporal);
         return;
     }
 
@@ -1880,6 +3027,8 @@ void escribir_pcb(pcb_t jugador) {
     fprintf(file, "Tiempo Bloqueado Acumulado: %d\n", jugador.tiempo_de_espera);
 
     fclose(file);
+    if (rename(temporal, filename) != 0)
+        perror("Error renombrando PCB");
 }
 
 
@@ -1906,15 +3055,15 @@ void actualizar_y_escribir_pcb(pcb_t *pcb, jugador_t *jugador)
     // Determinar el estado del jugador
     if (!jugador->en_juego)
     {
-        pcb->estado = DE_ESPERA;
+        cambiar_estado(jugador->contexto, jugador->id, DE_ESPERA);
     }
     else if (jugador->tiempo_restante > 0)
     {
-        pcb->estado = EJECUTANDO;
+        cambiar_estado(jugador->contexto, jugador->id, EJECUTANDO);
     }
     else
     {
-        pcb->estado = LISTO;
+        cambiar_estado(jugador->contexto, jugador->id, LISTO);
     }
 
     // Actualizar estadísticas
@@ -1937,12 +3086,12 @@ void actualizar_y_escribir_pcb(pcb_t *pcb, jugador_t *jugador)
     escribir_pcb(*pcb);
 }
 
-void actualizar_tabla_procesos(pcb_t jugadores[], int num_jugadores)
+static void guardar_tabla_en_archivo(const pcb_t jugadores[], int num_jugadores)
 {
-    FILE *file = fopen("tabla_procesos.txt", "w");
+    FILE *file = fopen("tabla_procesos.txt.tmp", "w");
     if (file == NULL)
     {
-        printf("Error al abrir tabla_procesos.txt\n");
+        printf("Error al abrir tabla_procesos.txt.tmp\n");
         return;
     }
 
@@ -1963,982 +3112,5309 @@ void actualizar_tabla_procesos(pcb_t jugadores[], int num_jugadores)
     }
 
     fclose(file);
+    if (rename("tabla_procesos.txt.tmp", "tabla_procesos.txt") != 0)
+        perror("Error renombrando tabla_procesos.txt");
 }
 
 // ----------------------------------------------------------------------
-// Función para repartir fichas entre jugadores y mostrar banco de apeadas
+// Bitácora binaria de eventos
 // ----------------------------------------------------------------------
-void repartir_fichas(jugador_t jugadores[], int num_jugadores, mazo_t *mazo)
-{
-    int fichas_por_jugador = (mazo->cantidad * 2) / (3 * num_jugadores);
-    int index = 0;
+#define BITACORA_MAGICO 0x54494252u // "RBIT"
+#define BITACORA_VERSION 2
 
-    for (int i = 0; i < num_jugadores; i++)
+// Todas las partidas de una bitácora se juegan con las mismas reglas
+void bitacora_abrir(bitacora_t *bitacora, const char *ruta, const reglas_t *reglas)
+{
+    bitacora->archivo = fopen(ruta, "wb");
+    if (bitacora->archivo == NULL)
     {
-        for (int j = 0; j < fichas_por_jugador; j++)
+        fprintf(stderr, "Error: No se pudo crear la bitácora %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(bitacora->archivo, NULL, _IOFBF, 1 << 16);
+
+    cabecera_bitacora_t cabecera = {BITACORA_MAGICO, BITACORA_VERSION, sizeof(evento_t),
+                                    (uint32_t)reglas->num_jugadores, (uint8_t)reglas->fichas_iniciales,
+                                    (uint8_t)reglas->barajas, (uint8_t)reglas->comodines, 0};
+    fwrite(&cabecera, sizeof(cabecera), 1, bitacora->archivo);
+    clock_gettime(CLOCK_MONOTONIC, &bitacora->inicio);
+}
+
+void bitacora_cerrar(bitacora_t *bitacora)
+{
+    if (bitacora == NULL || bitacora->archivo == NULL)
+        return;
+
+    fclose(bitacora->archivo);
+    bitacora->archivo = NULL;
+}
+
+// Agrega un evento. fwrite toma el candado del FILE, así que pueden registrar
+// varios hilos de la misma partida.
+void bitacora_registrar(contexto_juego_t *ctx, tipo_evento_t tipo, int jugador, ficha_t ficha, int dato)
+{
+    if (ctx == NULL || ctx->bitacora == NULL)
+        return;
+
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    const struct timespec *inicio = &ctx->bitacora->inicio;
+    int64_t us = (int64_t)(ahora.tv_sec - inicio->tv_sec) * 1000000 + (ahora.tv_nsec - inicio->tv_nsec) / 1000;
+
+    evento_t evento = {(uint32_t)us, (uint8_t)tipo, (uint8_t)jugador, ficha, (uint8_t)dato};
+    fwrite(&evento, sizeof(evento), 1, ctx->bitacora->archivo);
+}
+
+// Pasa al archivo lo acumulado en el búfer (la partida interactiva lo hace en cada
+// turno, para no perder la bitácora si el proceso muere)
+void bitacora_vaciar(contexto_juego_t *ctx)
+{
+    if (ctx->bitacora != NULL)
+        fflush(ctx->bitacora->archivo);
+}
+
+// Marca el comienzo de una partida: el evento va seguido de la semilla
+void bitacora_iniciar_partida(contexto_juego_t *ctx)
+{
+    if (ctx->bitacora == NULL)
+        return;
+
+    bitacora_registrar(ctx, EVENTO_PARTIDA, 0, 0, 0);
+    fwrite(&ctx->semilla, sizeof(ctx->semilla), 1, ctx->bitacora->archivo);
+}
+
+// ----------------------------------------------------------------------
+// Instantáneas del estado de la partida
+// ----------------------------------------------------------------------
+// Todo el estado de una partida en un solo struct sin punteros (las manos y el
+// banco van en línea): guardar y cargar es un fwrite/fread, y copiar una posición
+// (para bots o búsquedas) es un memcpy.
+#define INSTANTANEA_MAGICO 0x4E534952u // "RISN"
+#define INSTANTANEA_VERSION 4
+
+typedef struct
+{
+    char nombre[MAX_NOMBRE];
+    int tiempo_restante;
+    int puntos_suficientes;
+    bool en_juego;
+    bool ficha_agregada;
+    int cantidad;
+    ficha_t fichas[MAX_FICHAS];
+} jugador_instantanea_t;
+
+typedef struct
+{
+    uint32_t magico;
+    uint16_t version;
+    uint16_t relleno;
+    uint32_t tamano; // sizeof(instantanea_t): descarta las de otro binario
+    reglas_t reglas; // Se restauran con la partida: mandan sobre las de la línea de comandos
+    uint64_t semilla;
+    generador_t generador;
+    mazo_t mazo;
+    grupo_t grupos[MAX_GRUPOS];
+    escalera_t escaleras[MAX_ESCALERAS];
+    int total_grupos;
+    int total_escaleras;
+    jugador_instantanea_t jugadores[MAX_JUGADORES];
+    pcb_t pcbs[MAX_JUGADORES];
+
+    // Scheduler
+    char modo;
+    int quantum;
+    int cola_listos[MAX_JUGADORES]; // En orden, el primero al frente
+    int num_listos;
+    int cola_de_esperas[MAX_JUGADORES];
+    int num_de_esperas;
+    int turno_actual;
+    int turnos_terminados;
+    int64_t espera_restante_ms[MAX_JUGADORES]; // Los plazos absolutos no sirven en otro proceso
+} instantanea_t;
+
+// Copia el estado de la partida. Quien llama debe impedir que cambie mientras
+// tanto (en la partida interactiva, con bloquear_partida()).
+void instantanea_capturar(const contexto_juego_t *ctx, instantanea_t *inst)
+{
+    memset(inst, 0, sizeof(instantanea_t));
+    inst->magico = INSTANTANEA_MAGICO;
+    inst->version = INSTANTANEA_VERSION;
+    inst->tamano = sizeof(instantanea_t);
+    inst->reglas = ctx->reglas;
+
+    inst->semilla = ctx->semilla;
+    inst->generador = ctx->generador;
+    inst->mazo = ctx->mazo;
+    memcpy(inst->grupos, ctx->banco_apeadas.grupos, sizeof(grupo_t) * ctx->banco_apeadas.total_grupos);
+    memcpy(inst->escaleras, ctx->banco_apeadas.escaleras, sizeof(escalera_t) * ctx->banco_apeadas.total_escaleras);
+    inst->total_grupos = ctx->banco_apeadas.total_grupos;
+    inst->total_escaleras = ctx->banco_apeadas.total_escaleras;
+    memcpy(inst->pcbs, ctx->pcbs, sizeof(inst->pcbs));
+
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        const jugador_t *jugador = &ctx->jugadores[i];
+        jugador_instantanea_t *destino = &inst->jugadores[i];
+
+        memcpy(destino->nombre, jugador->nombre, MAX_NOMBRE);
+        destino->tiempo_restante = jugador->tiempo_restante;
+        destino->puntos_suficientes = jugador->puntos_suficientes;
+        destino->en_juego = jugador->en_juego;
+        destino->ficha_agregada = jugador->ficha_agregada;
+        destino->cantidad = jugador->mano.cantidad;
+        memcpy(destino->fichas, jugador->mano.fichas, sizeof(ficha_t) * jugador->mano.cantidad);
+    }
+
+    inst->modo = ctx->modo;
+    inst->quantum = ctx->quantum;
+    inst->num_listos = cola_listos_copiar(&ctx->listos, inst->cola_listos, MAX_JUGADORES);
+    memcpy(inst->cola_de_esperas, ctx->cola_de_esperas, sizeof(inst->cola_de_esperas));
+    inst->num_de_esperas = ctx->num_de_esperas;
+    inst->turno_actual = ctx->turno_actual;
+    inst->turnos_terminados = ctx->turnos_terminados;
+
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    for (int i = 0; i < inst->num_de_esperas; i++)
+    {
+        int j = ctx->cola_de_esperas[i] - 1;
+        const struct timespec *plazo = &ctx->fin_de_espera[j];
+        int64_t ms = (int64_t)(plazo->tv_sec - ahora.tv_sec) * 1000 + (plazo->tv_nsec - ahora.tv_nsec) / 1000000;
+        inst->espera_restante_ms[j] = ms > 0 ? ms : 0;
+    }
+}
+
+// Rearma un contexto ya inicializado (contexto_inicializar) a partir de una
+// instantánea. Conserva silencioso y bitacora, que son del proceso y no de la partida.
+void instantanea_restaurar(contexto_juego_t *ctx, const instantanea_t *inst)
+{
+    ctx->reglas = inst->reglas;
+    ctx->semilla = inst->semilla;
+    ctx->generador = inst->generador;
+    ctx->mazo = inst->mazo;
+
+    banco_de_apeadas_t *banco = &ctx->banco_apeadas;
+    banco_inicializar(banco);
+    banco_reservar(banco, inst->total_grupos, inst->total_escaleras);
+    memcpy(banco->grupos, inst->grupos, sizeof(grupo_t) * inst->total_grupos);
+    memcpy(banco->escaleras, inst->escaleras, sizeof(escalera_t) * inst->total_escaleras);
+    banco->total_grupos = inst->total_grupos;
+    banco->total_escaleras = inst->total_escaleras;
+
+    // El índice de embones y el hash de la mesa se recalculan: no se guardan
+    for (int g = 0; g < banco->total_grupos; g++)
+        indice_actualizar_grupo(banco, g);
+    for (int e = 0; e < banco->total_escaleras; e++)
+        indice_actualizar_escalera(banco, e);
+    memcpy(ctx->pcbs, inst->pcbs, sizeof(ctx->pcbs));
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        ctx->pcbs[i].nombre[MAX_NOMBRE - 1] = '\0'; // Se imprimen con %s
+
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        const jugador_instantanea_t *origen = &inst->jugadores[i];
+        jugador_t *jugador = &ctx->jugadores[i];
+
+        jugador->contexto = ctx;
+        jugador->id = i + 1;
+        memcpy(jugador->nombre, origen->nombre, MAX_NOMBRE);
+        jugador->nombre[MAX_NOMBRE - 1] = '\0';
+        jugador->tiempo_restante = origen->tiempo_restante;
+        jugador->puntos_suficientes = origen->puntos_suficientes;
+        jugador->en_juego = origen->en_juego;
+        jugador->ficha_agregada = origen->ficha_agregada;
+
+        mano_inicializar(&jugador->mano, ctx->reglas.fichas_iniciales * 2);
+        memset(&jugador->mano.bits, 0, sizeof(mano_bits_t));
+        for (int k = 0; k < origen->cantidad; k++)
+            agregar_ficha(&jugador->mano, origen->fichas[k]);
+    }
+
+    ctx->modo = inst->modo;
+    ctx->quantum = inst->quantum;
+    cola_listos_inicializar(&ctx->listos);
+    for (int i = 0; i < inst->num_listos; i++)
+        cola_listos_encolar(&ctx->listos, inst->cola_listos[i]);
+    memcpy(ctx->cola_de_esperas, inst->cola_de_esperas, sizeof(ctx->cola_de_esperas));
+    ctx->num_de_esperas = inst->num_de_esperas;
+    ctx->turno_actual = inst->turno_actual;
+    ctx->turnos_terminados = inst->turnos_terminados;
+    ctx->proceso_en_ejecucion = -1;
+    ctx->terminado = false;
+
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        ctx->fin_de_espera[i] = ahora;
+        ctx->fin_de_espera[i].tv_sec += inst->espera_restante_ms[i] / 1000;
+        ctx->fin_de_espera[i].tv_nsec += (inst->espera_restante_ms[i] % 1000) * 1000000L;
+        if (ctx->fin_de_espera[i].tv_nsec >= 1000000000L)
         {
-            agregar_ficha(&(jugadores[i].mano), mazo->fichas[index]);
-            index++;
+            ctx->fin_de_espera[i].tv_sec++;
+            ctx->fin_de_espera[i].tv_nsec -= 1000000000L;
         }
     }
-    mazo->cantidad -= index; // El resto queda en la banca
 }
 
-// Muestra los grupos y escaleras del banco de apeadas
-void mostrar_banco(const banco_de_apeadas_t *banco)
+// Escribe en un temporal y renombra, como los PCBs: un corte a medias deja la
+// instantánea anterior intacta
+void instantanea_guardar(const instantanea_t *inst, const char *ruta)
 {
-    if (banco == NULL)
+    char temporal[PATH_MAX];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", ruta);
+
+    FILE *file = fopen(temporal, "wb");
+    if (file == NULL)
     {
-        printf("\nEl banco de apeadas está vacío.\n");
+        printf("Error al abrir %s\n", temporal);
         return;
     }
 
-    printf("\n=== Banco de Apeadas ===\n");
+    size_t escritos = fwrite(inst, sizeof(instantanea_t), 1, file);
+    if (fclose(file) != 0 || escritos != 1)
+    {
+        printf("Error escribiendo %s\n", temporal);
+        return;
+    }
+    if (rename(temporal, ruta) != 0)
+        perror("Error renombrando la instantánea");
+}
 
-    // Mostrar grupos
-    if (banco->total_grupos > 0)
+// Anota las fichas en vistas. Falla si la cantidad no entra, si una ficha no es
+// del mazo de estas reglas o si ya apareció en otro lado (una tercera copia
+// rompería la mano en bits y su hash).
+static bool fichas_validas(const ficha_t fichas[], int cantidad, int maximo, const reglas_t *reglas,
+                           bool vistas[MAX_FICHAS])
+{
+    if (cantidad < 0 || cantidad > maximo)
+        return false;
+    for (int i = 0; i < cantidad; i++)
     {
-        printf("\n── Grupos ──\n");
-        for (int i = 0; i < banco->total_grupos; i++)
-        {
-            printf("Grupo %d: ", i + 1);
-            for (int j = 0; j < banco->grupos[i].cantidad; j++)
-            {
-                if (banco->grupos[i].fichas[j].numero == 0)
-                {
-                    printf("[Comodín] ");
-                }
-                else
-                {
-                    printf("[%d %s] ", banco->grupos[i].fichas[j].numero, banco->grupos[i].fichas[j].color);
-                }
-            }
-            printf("\n");
-        }
+        ficha_t ficha = fichas[i];
+        bool del_mazo = ficha < reglas->barajas * FICHAS_POR_JUEGO ||
+                        (ficha >= PRIMER_COMODIN && ficha < PRIMER_COMODIN + reglas->comodines);
+        if (!del_mazo || vistas[ficha])
+            return false;
+        vistas[ficha] = true;
     }
-    else
+    return true;
+}
+
+static bool ids_validos(const int ids[], int cantidad, int num_jugadores)
+{
+    if (cantidad < 0 || cantidad > num_jugadores)
+        return false;
+    for (int i = 0; i < cantidad; i++)
     {
-        printf("\nNo hay grupos en el banco.\n");
+        if (ids[i] < 1 || ids[i] > num_jugadores)
+            return false;
     }
+    return true;
+}
 
-    // Mostrar escaleras
-    if (banco->total_escaleras > 0)
+// Todo lo que la restauración usa como índice o tamaño tiene que estar en rango:
+// el archivo puede venir de otro lado
+static bool instantanea_valida(const instantanea_t *inst)
+{
+    if (inst->magico != INSTANTANEA_MAGICO || inst->version != INSTANTANEA_VERSION ||
+        inst->tamano != sizeof(instantanea_t) || !reglas_validas(&inst->reglas) ||
+        inst->total_grupos < 0 || inst->total_grupos > MAX_GRUPOS ||
+        inst->total_escaleras < 0 || inst->total_escaleras > MAX_ESCALERAS)
+        return false;
+
+    const reglas_t *reglas = &inst->reglas;
+    int num_jugadores = reglas->num_jugadores;
+    if ((inst->modo != 'F' && inst->modo != 'R') || inst->quantum <= 0 ||
+        !ids_validos(inst->cola_listos, inst->num_listos, num_jugadores) ||
+        !ids_validos(inst->cola_de_esperas, inst->num_de_esperas, num_jugadores))
+        return false;
+
+    for (int i = 0; i < num_jugadores; i++)
     {
-        printf("\n── Escaleras ──\n");
-        for (int i = 0; i < banco->total_escaleras; i++)
-        {
-            printf("Escalera %d: ", i + 1);
-            for (int j = 0; j < banco->escaleras[i].cantidad; j++)
-            {
-                if (banco->escaleras[i].fichas[j].numero == 0)
-                {
-                    printf("[Comodín] ");
-                }
-                else
-                {
-                    printf("[%d %s] ", banco->escaleras[i].fichas[j].numero, banco->escaleras[i].fichas[j].color);
-                }
-            }
-            printf("\n");
-        }
+        const pcb_t *pcb = &inst->pcbs[i];
+        if (pcb->id_jugador != i + 1 || pcb->estado < DE_ESPERA || pcb->estado > EJECUTANDO)
+            return false;
     }
-    else
+
+    // Cada ficha del mazo de las reglas, exactamente una vez entre mazo, manos y mesa
+    bool vistas[MAX_FICHAS] = {false};
+    if (!fichas_validas(inst->mazo.fichas, inst->mazo.cantidad, MAX_FICHAS, reglas, vistas))
+        return false;
+    for (int g = 0; g < inst->total_grupos; g++)
     {
-        printf("\nNo hay escaleras en el banco.\n");
+        if (!fichas_validas(inst->grupos[g].fichas, inst->grupos[g].cantidad, MAX_FICHAS_GRUPO, reglas, vistas))
+            return false;
+    }
+    for (int e = 0; e < inst->total_escaleras; e++)
+    {
+        if (!fichas_validas(inst->escaleras[e].fichas, inst->escaleras[e].cantidad, MAX_FICHAS_ESCALERA, reglas,
+                            vistas))
+            return false;
+    }
+    for (int i = 0; i < num_jugadores; i++)
+    {
+        if (!fichas_validas(inst->jugadores[i].fichas, inst->jugadores[i].cantidad, MAX_FICHAS, reglas, vistas))
+            return false;
     }
 
-    printf("────────────────────────────\n");
+    int total = 0;
+    for (int k = 0; k < MAX_FICHAS; k++)
+        total += vistas[k];
+    return total == reglas_fichas_mazo(reglas);
 }
 
-// ----------------------------------------------------------------------
-// Funciones de Concurrencia y Manejo de Turnos
-// ----------------------------------------------------------------------
-
-// Hilo principal que controla el estado global del juego
-void *hilo_juego_func(void *arg)
+void instantanea_cargar(instantanea_t *inst, const char *ruta)
 {
-    while (1)
+    FILE *file = fopen(ruta, "rb");
+    if (file == NULL)
     {
-        pthread_mutex_lock(&mutex);
-
-        // Detectar ganador continuamente
-        int ganador = determinar_ganador(jugadores, NUM_JUGADORES, mazo.cantidad == 0);
-        if (ganador != -1)
-        {
-            printf("\n¡Jugador %d (%s) ha ganado!\n", jugadores[ganador].id, jugadores[ganador].nombre);
+        fprintf(stderr, "Error: No se pudo abrir la instantánea %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
 
-            // Actualizar estadísticas de todos los jugadores
-            for (int i = 0; i < NUM_JUGADORES; i++)
-            {
-                pcbs[i].partidas_jugadas++;
-                if (i == ganador)
-                    pcbs[i].partidas_ganadas++;
-                else
-                    pcbs[i].partidas_perdidas++;
-                escribir_pcb(pcbs[i]);
-            }
+    size_t leidos = fread(inst, sizeof(instantanea_t), 1, file);
+    fclose(file);
+    if (leidos != 1 || !instantanea_valida(inst))
+    {
+        fprintf(stderr, "Error: %s no es una instantánea compatible\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+}
 
-            exit(0);
+// ----------------------------------------------------------------------
+// Escritor asíncrono de PCBs
+// ----------------------------------------------------------------------
+// Los turnos solo copian el PCB a su ranura y marcan la ranura sucia; el hilo
+// escritor junta los cambios durante intervalo_ms y vuelca cada archivo una
+// sola vez, fuera de los mutex del juego. Varias actualizaciones del mismo
+// jugador dentro de un intervalo se fusionan en la última.
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;          // Hay datos sucios o se pidió detener (reloj monotónico)
+    pcb_t pendientes[MAX_JUGADORES];
+    bool sucio[MAX_JUGADORES];
+    pcb_t tabla[MAX_JUGADORES];
+    int num_tabla;
+    bool tabla_sucia;
+    instantanea_t instantanea;    // Último punto de control pendiente de guardar
+    const char *ruta_instantanea;
+    bool instantanea_sucia;
+    int intervalo_ms;
+    bool activo;                  // Hay un hilo escritor aceptando instantáneas
+    bool detener;
+    pthread_t hilo;
+} escritor_pcb_t;
+
+escritor_pcb_t escritor_pcb = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .intervalo_ms = INTERVALO_PCB_MS};
+
+static void *escritor_pcb_thread(void *arg)
+{
+    escritor_pcb_t *escritor = (escritor_pcb_t *)arg;
+    pcb_t pcbs[MAX_JUGADORES];
+    bool sucio[MAX_JUGADORES];
+    pcb_t tabla[MAX_JUGADORES];
+    int num_tabla = 0;
+    bool tabla_sucia;
+    static instantanea_t instantanea; // Solo la usa este hilo
+    bool instantanea_sucia;
+
+    cerrojo_tomar(&escritor->mutex);
+    for (;;)
+    {
+        bool hay_cambios = escritor->tabla_sucia || escritor->instantanea_sucia;
+        for (int i = 0; i < MAX_JUGADORES; i++)
+            hay_cambios |= escritor->sucio[i];
+
+        if (!hay_cambios)
+        {
+            if (escritor->detener)
+                break;
+            condicion_esperar(&escritor->cond, &escritor->mutex);
+            continue;
         }
 
-        // Cambiar política de planificación con teclas F/R
-        if (kbhit())
+        // Dejar que se acumulen cambios durante el intervalo (salvo al detener)
+        struct timespec plazo;
+        clock_gettime(CLOCK_MONOTONIC, &plazo);
+        plazo.tv_sec += escritor->intervalo_ms / 1000;
+        plazo.tv_nsec += (long)(escritor->intervalo_ms % 1000) * 1000000L;
+        if (plazo.tv_nsec >= 1000000000L)
         {
-            char c = getchar();
-            if (c == 'F' || c == 'f')
-                modo = 'F';
-            else if (c == 'R' || c == 'r')
-                modo = 'R';
-            printf("\nPolítica cambiada a %c\n", modo);
+            plazo.tv_sec++;
+            plazo.tv_nsec -= 1000000000L;
+        }
+        while (!escritor->detener &&
+               condicion_esperar_hasta(&escritor->cond, &escritor->mutex, &plazo) != ETIMEDOUT)
+            ;
+
+        // Tomar las instantáneas y escribir sin el mutex
+        memcpy(pcbs, escritor->pendientes, sizeof(pcbs));
+        memcpy(sucio, escritor->sucio, sizeof(sucio));
+        memset(escritor->sucio, 0, sizeof(escritor->sucio));
+        tabla_sucia = escritor->tabla_sucia;
+        if (tabla_sucia)
+        {
+            num_tabla = escritor->num_tabla;
+            memcpy(tabla, escritor->tabla, sizeof(pcb_t) * num_tabla);
+            escritor->tabla_sucia = false;
         }
+        instantanea_sucia = escritor->instantanea_sucia;
+        if (instantanea_sucia)
+        {
+            instantanea = escritor->instantanea;
+            escritor->instantanea_sucia = false;
+        }
+        const char *ruta_instantanea = escritor->ruta_instantanea;
+        cerrojo_soltar(&escritor->mutex);
 
-        pthread_mutex_unlock(&mutex);
-        sleep(1); // Revisar estado cada segundo
+        for (int i = 0; i < MAX_JUGADORES; i++)
+            if (sucio[i])
+                guardar_pcb_en_archivo(&pcbs[i]);
+        if (tabla_sucia)
+            guardar_tabla_en_archivo(tabla, num_tabla);
+        if (instantanea_sucia)
+            instantanea_guardar(&instantanea, ruta_instantanea);
+
+        cerrojo_tomar(&escritor->mutex);
     }
+    cerrojo_soltar(&escritor->mutex);
     return NULL;
 }
 
-int calcular_quantum_dinamico(int jugadores_listos) {
-    int q = 20 / (jugadores_listos + 1);
-    return (q < 5) ? 5 : q;
+void iniciar_escritor_pcb(int intervalo_ms)
+{
+    pthread_condattr_t atributos_cond;
+    pthread_condattr_init(&atributos_cond);
+    pthread_condattr_setclock(&atributos_cond, CLOCK_MONOTONIC);
+    pthread_cond_init(&escritor_pcb.cond, &atributos_cond);
+    pthread_condattr_destroy(&atributos_cond);
+
+    escritor_pcb.intervalo_ms = intervalo_ms;
+    escritor_pcb.detener = false;
+    if (pthread_create(&escritor_pcb.hilo, NULL, escritor_pcb_thread, &escritor_pcb) != 0)
+    {
+        perror("Error creando hilo escritor de PCBs");
+        exit(EXIT_FAILURE);
+    }
+    escritor_pcb.activo = true;
 }
 
-void decidir_politica() {
-    int total_espera = 0, jugadores_bloqueados = 0;
-    int jugadores_listos = num_listos;
+// Vuelca todo lo pendiente y termina el hilo escritor
+void detener_escritor_pcb(void)
+{
+    if (!escritor_pcb.activo)
+        return;
 
-    pthread_mutex_lock(&mutex_pcbs);
-    for (int i = 0; i < NUM_JUGADORES; i++) {
-        if (pcbs[i].estado == DE_ESPERA) {
-            total_espera += pcbs[i].tiempo_de_espera;
-            jugadores_bloqueados++;
-        }
-    }
-    pthread_mutex_unlock(&mutex_pcbs);
+    cerrojo_tomar(&escritor_pcb.mutex);
+    escritor_pcb.detener = true;
+    pthread_cond_signal(&escritor_pcb.cond);
+    cerrojo_soltar(&escritor_pcb.mutex);
 
-    if (jugadores_bloqueados > 1 || jugadores_listos >= NUM_JUGADORES / 2) {
-        // Modo Round Robin
-        modo = 'R';
-        QUANTUM = 20 / (jugadores_listos + 1);
-        if (QUANTUM < 5) QUANTUM = 5;
-        printf("\n[Cambio] Modo RR - Quantum: %d segundos\n", QUANTUM);
-    } else {
-        // Modo FCFS con quantum dinámico
-        modo = 'F';
-        
-        // Calcular quantum basado en tiempo de espera promedio y jugadores activos
-        int promedio_espera = (jugadores_bloqueados > 0) ? 
-                             (total_espera / jugadores_bloqueados) : 0;
-                             
-        QUANTUM = 15 + (promedio_espera * 2) - (jugadores_listos * 1);
-        
-        // Aplicar límites
-        if (QUANTUM < 10) QUANTUM = 10;       // Mínimo 10s
-        else if (QUANTUM > 30) QUANTUM = 30;  // Máximo 30s
-        
-        printf("\n[Cambio] Modo FCFS - Quantum ajustado: %d segundos\n", QUANTUM);
-    }
+    pthread_join(escritor_pcb.hilo, NULL);
+    escritor_pcb.activo = false;
+    pthread_cond_destroy(&escritor_pcb.cond);
 }
 
+// ----------------------------------------------------------------------
+// Tabla de PCBs compartida (mmap) para monitoreo en vivo
+// ----------------------------------------------------------------------
+// Archivo de tamaño fijo: una cabecera y un registro por jugador. Cada registro
+// lleva un seqlock: el juego pone la secuencia impar, copia el PCB y la vuelve
+// par; un lector copia el registro y lo acepta solo si la secuencia era par y
+// no cambió mientras copiaba. Leer no requiere ninguna llamada al sistema.
+#define TABLA_MAGICO 0x524D4350u // "PCMR"
+#define TABLA_VERSION 1
+#define PALABRAS_PCB (sizeof(pcb_t) / sizeof(uint32_t))
 
+_Static_assert(sizeof(pcb_t) % sizeof(uint32_t) == 0, "pcb_t debe copiarse por palabras");
 
-// Hilo planificador gestiona turnos de los jugadores
+typedef struct
+{
+    uint32_t secuencia; // Impar mientras el juego escribe el registro
+    uint32_t relleno;
+    union
+    {
+        pcb_t pcb;
+        uint32_t palabras[PALABRAS_PCB];
+    } datos;
+} registro_pcb_t;
+
+typedef struct
+{
+    uint32_t magico;
+    uint32_t version;
+    uint32_t num_registros;
+    uint32_t tamano_registro;
+    uint32_t activo; // 1 mientras la partida sigue en curso
+    uint32_t relleno;
+    registro_pcb_t registros[MAX_JUGADORES];
+} tabla_compartida_t;
+
+tabla_compartida_t *tabla_compartida = NULL;                         // NULL: sin tabla compartida
+pthread_mutex_t mutex_tabla_compartida = PTHREAD_MUTEX_INITIALIZER; // Serializa a los escritores
+
+void abrir_tabla_compartida(const char *ruta)
+{
+    int fd = open(ruta, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, sizeof(tabla_compartida_t)) == -1)
+    {
+        fprintf(stderr, "Error: No se pudo crear la tabla compartida %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    void *mapa = mmap(NULL, sizeof(tabla_compartida_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED)
+    {
+        fprintf(stderr, "Error: No se pudo mapear la tabla compartida %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    tabla_compartida = (tabla_compartida_t *)mapa;
+    tabla_compartida->version = TABLA_VERSION;
+    tabla_compartida->num_registros = MAX_JUGADORES;
+    tabla_compartida->tamano_registro = sizeof(registro_pcb_t);
+    __atomic_store_n(&tabla_compartida->activo, 1, __ATOMIC_RELAXED);
+    // El mágico va al final: un lector que lo ve tiene la cabecera completa
+    __atomic_store_n(&tabla_compartida->magico, TABLA_MAGICO, __ATOMIC_RELEASE);
+}
+
+void cerrar_tabla_compartida(void)
+{
+    if (tabla_compartida == NULL)
+        return;
+
+    __atomic_store_n(&tabla_compartida->activo, 0, __ATOMIC_RELEASE);
+    munmap(tabla_compartida, sizeof(tabla_compartida_t));
+    tabla_compartida = NULL;
+}
+
+static void tabla_compartida_publicar(const pcb_t *pcb)
+{
+    int i = pcb->id_jugador - 1;
+    if (tabla_compartida == NULL || i < 0 || i >= MAX_JUGADORES)
+        return;
+
+    registro_pcb_t *registro = &tabla_compartida->registros[i];
+    const uint32_t *origen = (const uint32_t *)pcb;
+
+    cerrojo_tomar(&mutex_tabla_compartida);
+    uint32_t secuencia = registro->secuencia;
+    __atomic_store_n(&registro->secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t k = 0; k < PALABRAS_PCB; k++)
+        __atomic_store_n(&registro->datos.palabras[k], origen[k], __ATOMIC_RELAXED);
+    __atomic_store_n(&registro->secuencia, secuencia + 2, __ATOMIC_RELEASE);
+    cerrojo_soltar(&mutex_tabla_compartida);
+}
+
+// Copia consistente de un registro; false si el juego lo está reescribiendo
+static bool tabla_compartida_leer(const registro_pcb_t *registro, pcb_t *destino)
+{
+    uint32_t *palabras = (uint32_t *)destino;
+
+    uint32_t antes = __atomic_load_n(&registro->secuencia, __ATOMIC_ACQUIRE);
+    if (antes & 1)
+        return false;
+    for (size_t k = 0; k < PALABRAS_PCB; k++)
+        palabras[k] = __atomic_load_n(&registro->datos.palabras[k], __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&registro->secuencia, __ATOMIC_RELAXED) == antes;
+}
+
+// Si el juego murió a mitad de una publicación, la secuencia queda impar para
+// siempre: el monitor reintenta un rato y muestra el registro como ilegible
+#define REINTENTOS_LECTURA_TABLA 20
+#define ESPERA_REINTENTO_TABLA_US 100
+
+// Lector en vivo: imprime la tabla cada intervalo_ms hasta que la partida termina
+int monitorear_tabla(const char *ruta, int intervalo_ms)
+{
+    int fd = open(ruta, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(tabla_compartida_t))
+    {
+        fprintf(stderr, "Error: %s no es una tabla compartida\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    const tabla_compartida_t *tabla = mmap(NULL, sizeof(tabla_compartida_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (tabla == MAP_FAILED ||
+        __atomic_load_n(&tabla->magico, __ATOMIC_ACQUIRE) != TABLA_MAGICO ||
+        tabla->version != TABLA_VERSION ||
+        tabla->num_registros != MAX_JUGADORES ||
+        tabla->tamano_registro != sizeof(registro_pcb_t))
+    {
+        fprintf(stderr, "Error: %s no es una tabla compartida compatible\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;)
+    {
+        bool activo = __atomic_load_n(&tabla->activo, __ATOMIC_ACQUIRE);
+
+        printf("\033[H\033[2J");
+        printf("ID\tNombre\tFichas\tPuntos\tEstado\t\tTurnos\tRobadas\tApeadas\tEmbones\tTiempoJ\tTiempoBloq\n");
+        for (int i = 0; i < MAX_JUGADORES; i++)
+        {
+            pcb_t pcb;
+            int intentos = 0;
+            bool leido;
+            while (!(leido = tabla_compartida_leer(&tabla->registros[i], &pcb)) &&
+                   ++intentos < REINTENTOS_LECTURA_TABLA)
+                usleep(ESPERA_REINTENTO_TABLA_US);
+            if (!leido)
+            {
+                printf("%d\t(registro a medio escribir)\n", i + 1);
+                continue;
+            }
+            if (pcb.id_jugador == 0)
+                continue; // Aún sin publicar
+
+            pcb.nombre[MAX_NOMBRE - 1] = '\0';
+            const char *estado_str = (pcb.estado == LISTO) ? "LISTO\t" : (pcb.estado == EJECUTANDO) ? "EJECUTANDO"
+                                                                                                    : "DE_ESPERA";
+            printf("%d\t%s\t%d\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\n",
+                   pcb.id_jugador, pcb.nombre, pcb.fichas_en_mano, pcb.puntos, estado_str,
+                   pcb.turnos_jugados, pcb.fichas_robadas, pcb.apeadas_realizadas,
+                   pcb.embones_realizados, pcb.tiempo_total_juego, pcb.tiempo_de_espera);
+        }
+        fflush(stdout);
+
+        if (!activo)
+        {
+            printf("\nPartida terminada.\n");
+            break;
+        }
+        usleep((useconds_t)intervalo_ms * 1000);
+    }
+
+    munmap((void *)tabla, sizeof(tabla_compartida_t));
+    return 0;
+}
+
+void escribir_pcb(pcb_t jugador)
+{
+    int i = jugador.id_jugador - 1;
+    tabla_compartida_publicar(&jugador);
+    if (!escritor_pcb.activo || i < 0 || i >= MAX_JUGADORES)
+    {
+        guardar_pcb_en_archivo(&jugador);
+        return;
+    }
+
+    cerrojo_tomar(&escritor_pcb.mutex);
+    escritor_pcb.pendientes[i] = jugador;
+    escritor_pcb.sucio[i] = true;
+    pthread_cond_signal(&escritor_pcb.cond);
+    cerrojo_soltar(&escritor_pcb.mutex);
+}
+
+// Punto de control sin detener el juego: se copia el estado a la ranura del
+// escritor y este lo guarda en disco a su ritmo. Requiere bloquear_partida().
+void programar_instantanea(const contexto_juego_t *ctx, const char *ruta)
+{
+    if (!escritor_pcb.activo)
+    {
+        static instantanea_t instantanea;
+        instantanea_capturar(ctx, &instantanea);
+        instantanea_guardar(&instantanea, ruta);
+        return;
+    }
+
+    cerrojo_tomar(&escritor_pcb.mutex);
+    instantanea_capturar(ctx, &escritor_pcb.instantanea);
+    escritor_pcb.ruta_instantanea = ruta;
+    escritor_pcb.instantanea_sucia = true;
+    pthread_cond_signal(&escritor_pcb.cond);
+    cerrojo_soltar(&escritor_pcb.mutex);
+}
+
+void actualizar_tabla_procesos(pcb_t jugadores[], int num_jugadores)
+{
+    for (int i = 0; i < num_jugadores; i++)
+        tabla_compartida_publicar(&jugadores[i]);
+
+    if (!escritor_pcb.activo || num_jugadores > MAX_JUGADORES)
+    {
+        guardar_tabla_en_archivo(jugadores, num_jugadores);
+        return;
+    }
+
+    cerrojo_tomar(&escritor_pcb.mutex);
+    memcpy(escritor_pcb.tabla, jugadores, sizeof(pcb_t) * num_jugadores);
+    escritor_pcb.num_tabla = num_jugadores;
+    escritor_pcb.tabla_sucia = true;
+    pthread_cond_signal(&escritor_pcb.cond);
+    cerrojo_soltar(&escritor_pcb.mutex);
+}
+
+// ----------------------------------------------------------------------
+// Función para repartir fichas entre jugadores y mostrar banco de apeadas
+// ----------------------------------------------------------------------
+void repartir_fichas(jugador_t jugadores[], int num_jugadores, mazo_t *mazo)
+{
+    int fichas_por_jugador = (mazo->cantidad * 2) / (3 * num_jugadores);
+    int index = 0;
+
+    for (int i = 0; i < num_jugadores; i++)
+    {
+        for (int j = 0; j < fichas_por_jugador; j++)
+        {
+            agregar_ficha(&(jugadores[i].mano), mazo->fichas[index]);
+            index++;
+        }
+    }
+    mazo->cantidad -= index; // El resto queda en la banca
+}
+
+// Muestra los grupos y escaleras del banco de apeadas
+void mostrar_banco(const banco_de_apeadas_t *banco)
+{
+    if (banco == NULL)
+    {
+        printf("\nEl banco de apeadas está vacío.\n");
+        return;
+    }
+
+    printf("\n=== Banco de Apeadas ===\n");
+
+    // Mostrar grupos
+    if (banco->total_grupos > 0)
+    {
+        printf("\n── Grupos ──\n");
+        for (int i = 0; i < banco->total_grupos; i++)
+        {
+            printf("Grupo %d: ", i + 1);
+            for (int j = 0; j < banco->grupos[i].cantidad; j++)
+            {
+                if (ficha_numero(banco->grupos[i].fichas[j]) == 0)
+                {
+                    printf("[Comodín] ");
+                }
+                else
+                {
+                    printf("[%d %s] ", ficha_numero(banco->grupos[i].fichas[j]), ficha_nombre_color(banco->grupos[i].fichas[j]));
+                }
+            }
+            printf("\n");
+        }
+    }
+    else
+    {
+        printf("\nNo hay grupos en el banco.\n");
+    }
+
+    // Mostrar escaleras
+    if (banco->total_escaleras > 0)
+    {
+        printf("\n── Escaleras ──\n");
+        for (int i = 0; i < banco->total_escaleras; i++)
+        {
+            printf("Escalera %d: ", i + 1);
+            for (int j = 0; j < banco->escaleras[i].cantidad; j++)
+            {
+                if (ficha_numero(banco->escaleras[i].fichas[j]) == 0)
+                {
+                    printf("[Comodín] ");
+                }
+                else
+                {
+                    printf("[%d %s] ", ficha_numero(banco->escaleras[i].fichas[j]), ficha_nombre_color(banco->escaleras[i].fichas[j]));
+                }
+            }
+            printf("\n");
+        }
+    }
+    else
+    {
+        printf("\nNo hay escaleras en el banco.\n");
+    }
+
+    printf("────────────────────────────\n");
+}
+
+// ----------------------------------------------------------------------
+// Cola de listos (varios productores, un consumidor, sin cerrojos)
+// ----------------------------------------------------------------------
+
+void cola_listos_inicializar(cola_listos_t *cola)
+{
+    memset(cola, 0, sizeof(cola_listos_t));
+    for (uint64_t i = 0; i < CAPACIDAD_COLA_LISTOS; i++)
+        cola->celdas[i].secuencia = i;
+}
+
+bool cola_listos_contiene(cola_listos_t *cola, int id_jugador)
+{
+    return (__atomic_load_n(&cola->marcas[id_jugador - 1], __ATOMIC_ACQUIRE) & MARCA_ESTADO) == MARCA_EN_COLA;
+}
+
+// Agrega al final, o en el lugar que tenía si lo quitaron y el consumidor aún no
+// pasó por su celda. Devuelve false solo si el jugador ya estaba en la cola.
+bool cola_listos_encolar(cola_listos_t *cola, int id_jugador)
+{
+    // Cambiar la marca reserva al jugador: otro productor ya no puede encolarlo
+    uint32_t *marca = &cola->marcas[id_jugador - 1];
+    uint32_t actual = __atomic_load_n(marca, __ATOMIC_RELAXED);
+    uint32_t nueva;
+    for (;;)
+    {
+        uint32_t estado = actual & MARCA_ESTADO;
+        if (estado == MARCA_EN_COLA)
+            return false;
+
+        uint32_t generacion = actual & ~MARCA_ESTADO;
+        nueva = (estado == MARCA_QUITADO ? generacion : generacion + MARCA_GENERACION) | MARCA_EN_COLA;
+        if (__atomic_compare_exchange_n(marca, &actual, nueva, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+    __atomic_fetch_add(&cola->cantidad, 1, __ATOMIC_RELAXED);
+    if ((actual & MARCA_ESTADO) == MARCA_QUITADO)
+        return true; // Su celda sigue en el anillo y vuelve a valer
+
+    uint64_t pos = __atomic_load_n(&cola->cola, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        celda_listos_t *celda = &cola->celdas[pos % CAPACIDAD_COLA_LISTOS];
+        uint64_t secuencia = __atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE);
+        int64_t diferencia = (int64_t)(secuencia - pos);
+
+        if (diferencia == 0)
+        {
+            if (__atomic_compare_exchange_n(&cola->cola, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                celda->id_jugador = id_jugador;
+                celda->marca = nueva;
+                __atomic_store_n(&celda->secuencia, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        }
+        else if (diferencia < 0)
+        {
+            // Con una celda por jugador no puede pasar: perderlo sería peor que parar
+            fprintf(stderr, "Error: cola de listos llena (Jugador %d)\n", id_jugador);
+            exit(EXIT_FAILURE);
+        }
+        else
+        {
+            pos = __atomic_load_n(&cola->cola, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Saca al primero (solo el consumidor). Descarta las celdas de jugadores quitados.
+// Devuelve -1 si la cola está vacía.
+int cola_listos_sacar(cola_listos_t *cola)
+{
+    for (;;)
+    {
+        uint64_t pos = cola->cabeza;
+        celda_listos_t *celda = &cola->celdas[pos % CAPACIDAD_COLA_LISTOS];
+        if (__atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE) != pos + 1)
+            return -1;
+
+        int id = celda->id_jugador;
+        uint32_t generacion = celda->marca & ~MARCA_ESTADO;
+        __atomic_store_n(&celda->secuencia, pos + CAPACIDAD_COLA_LISTOS, __ATOMIC_RELEASE);
+        cola->cabeza = pos + 1;
+
+        // La celda era la única del jugador: sale de la cola, o se descarta si lo
+        // habían quitado (y un productor ya no puede recuperarla)
+        uint32_t *marca = &cola->marcas[id - 1];
+        uint32_t actual = __atomic_load_n(marca, __ATOMIC_ACQUIRE);
+        while ((actual & ~MARCA_ESTADO) == generacion && (actual & MARCA_ESTADO) != MARCA_FUERA)
+        {
+            if (__atomic_compare_exchange_n(marca, &actual, generacion | MARCA_FUERA, true,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                if ((actual & MARCA_ESTADO) == MARCA_EN_COLA)
+                {
+                    __atomic_fetch_sub(&cola->cantidad, 1, __ATOMIC_RELAXED);
+                    return id;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Quita a un jugador sin mover a los demás. Devuelve false si no estaba.
+bool cola_listos_quitar(cola_listos_t *cola, int id_jugador)
+{
+    uint32_t *marca = &cola->marcas[id_jugador - 1];
+    uint32_t actual = __atomic_load_n(marca, __ATOMIC_RELAXED);
+    while ((actual & MARCA_ESTADO) == MARCA_EN_COLA)
+    {
+        uint32_t quitado = (actual & ~MARCA_ESTADO) | MARCA_QUITADO;
+        if (__atomic_compare_exchange_n(marca, &actual, quitado, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            __atomic_fetch_sub(&cola->cantidad, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+int cola_listos_cantidad(cola_listos_t *cola)
+{
+    int cantidad = __atomic_load_n(&cola->cantidad, __ATOMIC_RELAXED);
+    return cantidad > 0 ? cantidad : 0;
+}
+
+// Copia en orden los jugadores en cola; la cola no debe estar cambiando
+int cola_listos_copiar(const cola_listos_t *cola, int ids[], int maximo)
+{
+    int n = 0;
+    for (uint64_t pos = cola->cabeza; pos != cola->cola && n < maximo; pos++)
+    {
+        const celda_listos_t *celda = &cola->celdas[pos % CAPACIDAD_COLA_LISTOS];
+        if (celda->secuencia == pos + 1 && cola->marcas[celda->id_jugador - 1] == celda->marca)
+            ids[n++] = celda->id_jugador;
+    }
+    return n;
+}
+
+// ----------------------------------------------------------------------
+// Histogramas de latencia del planificador
+// ----------------------------------------------------------------------
+
+// Con --histogramas cada hilo de la partida interactiva anota cuánto duran las
+// transiciones del planificador en histogramas propios, sin cerrojos: cubetas
+// log-lineales (16 por potencia de dos, error relativo menor al 7%) sobre
+// nanosegundos. El dueño es el único que escribe sus contadores; el volcado los
+// lee con cargas atómicas y suma los de todos los hilos. Sirve para ajustar
+// calcular_quantum_dinamico y decidir_politica con números y no a ojo.
+
+#define HISTOGRAMA_BITS_SUB 4                     // log2 de las cubetas por potencia de dos
+#define HISTOGRAMA_SUB (1 << HISTOGRAMA_BITS_SUB)
+#define HISTOGRAMA_EXPONENTE_MAX 44               // Valores hasta 2^44 ns (~4,9 horas); los mayores se recortan
+#define HISTOGRAMA_CUBETAS ((HISTOGRAMA_EXPONENTE_MAX - HISTOGRAMA_BITS_SUB + 1) * HISTOGRAMA_SUB)
+
+typedef enum
+{
+    METRICA_EN_LISTO,             // Tiempo de un PCB en LISTO hasta que lo despachan o bloquean
+    METRICA_EN_ESPERA,            // Tiempo de un PCB en DE_ESPERA (el bloqueo tras cada turno)
+    METRICA_EN_EJECUCION,         // Tiempo de un PCB en EJECUTANDO
+    METRICA_DESPACHO,             // De EJECUTANDO a que jugador_thread empieza el turno
+    METRICA_TURNO,                // Duración de jugador_thread
+    METRICA_PLANIFICADOR_DORMIDO, // El planificador esperando el fin de un turno
+    METRICA_DECIDIR_POLITICA,     // Una llamada a decidir_politica
+    METRICA_BLOQUEAR_JUGADOR,     // Una llamada a bloquear_jugador (mover_a_cola_de_esperas), con la espera de cerrojos
+    METRICA_RETRASO_DESBLOQUEO,   // Cuánto después del plazo vuelve a LISTO un jugador en espera
+    METRICA_REVISAR_ESPERAS,      // Una pasada sobre la cola de esperas
+    NUM_METRICAS
+} metrica_t;
+
+static const char *nombres_metricas[NUM_METRICAS] = {
+    "en_listo", "en_espera", "en_ejecucion", "despacho", "turno", "planificador_dormido",
+    "decidir_politica", "bloquear_jugador", "retraso_desbloqueo", "revisar_esperas"};
+
+typedef struct histogramas_hilo
+{
+    uint64_t cubetas[NUM_METRICAS][HISTOGRAMA_CUBETAS];
+    uint64_t suma_ns[NUM_METRICAS];
+    uint64_t maximo_ns[NUM_METRICAS];
+    struct histogramas_hilo *siguiente; // Lista de todos los hilos que anotaron algo
+} histogramas_hilo_t;
+
+static bool histogramas_activos;                   // Se fija antes de crear los hilos
+static const char *ruta_histogramas;
+static histogramas_hilo_t *histogramas_registrados; // Se agrega con CAS; nunca se quita
+static __thread histogramas_hilo_t *histogramas_propios;
+static pthread_mutex_t mutex_histogramas = PTHREAD_MUTEX_INITIALIZER; // Hoja: un volcado a la vez
+static pthread_t hilo_senal_histogramas;
+
+// Nanosegundos del reloj monotónico, o 0 si no se está midiendo
+static inline uint64_t reloj_ns(void)
+{
+    if (!histogramas_activos)
+        return 0;
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return (uint64_t)ahora.tv_sec * 1000000000ULL + (uint64_t)ahora.tv_nsec;
+}
+
+static int histograma_cubeta(uint64_t ns)
+{
+    if (ns < HISTOGRAMA_SUB)
+        return (int)ns;
+    if (ns >= 1ULL << HISTOGRAMA_EXPONENTE_MAX)
+        ns = (1ULL << HISTOGRAMA_EXPONENTE_MAX) - 1;
+
+    int exponente = 63 - __builtin_clzll(ns);
+    return (exponente - HISTOGRAMA_BITS_SUB + 1) * HISTOGRAMA_SUB +
+           (int)((ns >> (exponente - HISTOGRAMA_BITS_SUB)) - HISTOGRAMA_SUB);
+}
+
+// Menor y mayor valor que caen en la cubeta
+static void histograma_limites(int cubeta, uint64_t *desde, uint64_t *hasta)
+{
+    int grupo = cubeta / HISTOGRAMA_SUB;
+    if (grupo == 0)
+    {
+        *desde = *hasta = (uint64_t)cubeta;
+        return;
+    }
+    *desde = (uint64_t)(HISTOGRAMA_SUB + cubeta % HISTOGRAMA_SUB) << (grupo - 1);
+    *hasta = *desde + (1ULL << (grupo - 1)) - 1;
+}
+
+static histogramas_hilo_t *histogramas_registrar_hilo(void)
+{
+    histogramas_hilo_t *propios = (histogramas_hilo_t *)calloc(1, sizeof(histogramas_hilo_t));
+    if (propios == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para los histogramas\n");
+        exit(EXIT_FAILURE);
+    }
+
+    propios->siguiente = __atomic_load_n(&histogramas_registrados, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&histogramas_registrados, &propios->siguiente, propios, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    histogramas_propios = propios;
+    return propios;
+}
+
+// Un solo escritor por contador: basta leer y escribir atómico, sin instrucciones
+// con prefijo lock
+static inline void contador_sumar(uint64_t *contador, uint64_t valor)
+{
+    __atomic_store_n(contador, __atomic_load_n(contador, __ATOMIC_RELAXED) + valor, __ATOMIC_RELAXED);
+}
+
+static void histograma_registrar(metrica_t metrica, uint64_t ns)
+{
+    if (!histogramas_activos)
+        return;
+    histogramas_hilo_t *propios = histogramas_propios;
+    if (propios == NULL)
+        propios = histogramas_registrar_hilo();
+
+    contador_sumar(&propios->cubetas[metrica][histograma_cubeta(ns)], 1);
+    contador_sumar(&propios->suma_ns[metrica], ns);
+    if (ns > __atomic_load_n(&propios->maximo_ns[metrica], __ATOMIC_RELAXED))
+        __atomic_store_n(&propios->maximo_ns[metrica], ns, __ATOMIC_RELAXED);
+}
+
+// Anota lo transcurrido desde inicio (un valor de reloj_ns)
+static inline void histograma_desde(metrica_t metrica, uint64_t inicio)
+{
+    if (histogramas_activos && inicio != 0)
+        histograma_registrar(metrica, reloj_ns() - inicio);
+}
+
+// Menor valor por debajo del cual cae la fracción pedida de las muestras (el
+// límite superior de su cubeta, sin pasar del máximo visto)
+static uint64_t histograma_percentil(const uint64_t cubetas[], uint64_t total, uint64_t maximo, double fraccion)
+{
+    uint64_t objetivo = (uint64_t)(fraccion * (double)total);
+    uint64_t acumulado = 0;
+    if (objetivo == 0)
+        objetivo = 1;
+
+    for (int c = 0; c < HISTOGRAMA_CUBETAS; c++)
+    {
+        acumulado += cubetas[c];
+        if (acumulado >= objetivo)
+        {
+            uint64_t desde, hasta;
+            histograma_limites(c, &desde, &hasta);
+            return hasta < maximo ? hasta : maximo;
+        }
+    }
+    return maximo;
+}
+
+// Suma los histogramas de todos los hilos y los escribe en ruta (temporal y
+// rename): un resumen por métrica y después las cubetas con muestras
+void histogramas_volcar(const char *ruta)
+{
+    static uint64_t cubetas[NUM_METRICAS][HISTOGRAMA_CUBETAS];
+    uint64_t suma_ns[NUM_METRICAS] = {0}, maximo_ns[NUM_METRICAS] = {0}, total[NUM_METRICAS] = {0};
+    char temporal[PATH_MAX];
+
+    cerrojo_tomar(&mutex_histogramas);
+    memset(cubetas, 0, sizeof(cubetas));
+    for (histogramas_hilo_t *h = __atomic_load_n(&histogramas_registrados, __ATOMIC_ACQUIRE); h != NULL; h = h->siguiente)
+    {
+        for (int m = 0; m < NUM_METRICAS; m++)
+        {
+            for (int c = 0; c < HISTOGRAMA_CUBETAS; c++)
+            {
+                uint64_t cantidad = __atomic_load_n(&h->cubetas[m][c], __ATOMIC_RELAXED);
+                cubetas[m][c] += cantidad;
+                total[m] += cantidad;
+            }
+            suma_ns[m] += __atomic_load_n(&h->suma_ns[m], __ATOMIC_RELAXED);
+            uint64_t maximo = __atomic_load_n(&h->maximo_ns[m], __ATOMIC_RELAXED);
+            if (maximo > maximo_ns[m])
+                maximo_ns[m] = maximo;
+        }
+    }
+
+    snprintf(temporal, sizeof(temporal), "%s.tmp", ruta);
+    FILE *file = fopen(temporal, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error al abrir %s\n", temporal);
+        cerrojo_soltar(&mutex_histogramas);
+        return;
+    }
+
+    fprintf(file, "metrica,muestras,media_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    for (int m = 0; m < NUM_METRICAS; m++)
+    {
+        fprintf(file, "%s,%llu,%.0f,%llu,%llu,%llu,%llu,%llu\n", nombres_metricas[m],
+                (unsigned long long)total[m], total[m] ? (double)suma_ns[m] / total[m] : 0.0,
+                (unsigned long long)histograma_percentil(cubetas[m], total[m], maximo_ns[m], 0.50),
+                (unsigned long long)histograma_percentil(cubetas[m], total[m], maximo_ns[m], 0.90),
+                (unsigned long long)histograma_percentil(cubetas[m], total[m], maximo_ns[m], 0.99),
+                (unsigned long long)histograma_percentil(cubetas[m], total[m], maximo_ns[m], 0.999),
+                (unsigned long long)maximo_ns[m]);
+    }
+
+    fprintf(file, "\nmetrica,desde_ns,hasta_ns,muestras\n");
+    for (int m = 0; m < NUM_METRICAS; m++)
+    {
+        for (int c = 0; c < HISTOGRAMA_CUBETAS; c++)
+        {
+            if (cubetas[m][c] == 0)
+                continue;
+            uint64_t desde, hasta;
+            histograma_limites(c, &desde, &hasta);
+            fprintf(file, "%s,%llu,%llu,%llu\n", nombres_metricas[m], (unsigned long long)desde,
+                    (unsigned long long)hasta, (unsigned long long)cubetas[m][c]);
+        }
+    }
+
+    if (fclose(file) != 0)
+        fprintf(stderr, "Error escribiendo %s\n", temporal);
+    else if (rename(temporal, ruta) != 0)
+        perror("Error renombrando los histogramas");
+    cerrojo_soltar(&mutex_histogramas);
+}
+
+// Vuelca los histogramas cada vez que llega SIGUSR1
+static void *senal_histogramas_thread(void *arg)
+{
+    sigset_t *senales = (sigset_t *)arg;
+
+    for (;;)
+    {
+        int senal;
+        if (sigwait(senales, &senal) == 0 && senal == SIGUSR1)
+        {
+            histogramas_volcar(ruta_histogramas);
+            fprintf(stderr, "[INFO] Histogramas volcados en %s\n", ruta_histogramas);
+        }
+    }
+    return NULL;
+}
+
+// Activa la medición. Debe llamarse antes de crear cualquier otro hilo: todos
+// heredan SIGUSR1 bloqueada y solo el hilo de la señal la atiende.
+void histogramas_iniciar(const char *ruta)
+{
+    static sigset_t senales;
+
+    ruta_histogramas = ruta;
+    histogramas_activos = true;
+
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &senales, NULL);
+    if (pthread_create(&hilo_senal_histogramas, NULL, senal_histogramas_thread, &senales) != 0)
+    {
+        perror("Error creando el hilo de histogramas");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Detiene el hilo de la señal y deja el volcado final
+void histogramas_terminar(void)
+{
+    if (!histogramas_activos)
+        return;
+
+    pthread_cancel(hilo_senal_histogramas); // sigwait es punto de cancelación
+    pthread_join(hilo_senal_histogramas, NULL);
+    histogramas_volcar(ruta_histogramas);
+}
+
+// ----------------------------------------------------------------------
+// Funciones de Concurrencia y Manejo de Turnos
+// ----------------------------------------------------------------------
+
+// Plazo absoluto en el reloj monotónico, ms milisegundos a partir de ahora
+static struct timespec plazo_en_ms(long ms)
+{
+    struct timespec plazo;
+    clock_gettime(CLOCK_MONOTONIC, &plazo);
+    plazo.tv_sec += ms / 1000;
+    plazo.tv_nsec += (ms % 1000) * 1000000L;
+    if (plazo.tv_nsec >= 1000000000L)
+    {
+        plazo.tv_sec++;
+        plazo.tv_nsec -= 1000000000L;
+    }
+    return plazo;
+}
+
+// Milisegundos desde a hasta b (negativo si b es anterior)
+static long diferencia_ms(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000L + (b->tv_nsec - a->tv_nsec) / 1000000L;
+}
+
+// Cambia el estado del PCB y registra la transición en la bitácora (con mutex_pcbs).
+// Con --histogramas anota además cuánto estuvo en el estado que deja.
+void cambiar_estado(contexto_juego_t *ctx, int id_jugador, estado_jugador estado)
+{
+    static const metrica_t metrica_de_estado[] = {
+        [LISTO] = METRICA_EN_LISTO, [EJECUTANDO] = METRICA_EN_EJECUCION, [DE_ESPERA] = METRICA_EN_ESPERA};
+    pcb_t *pcb = &ctx->pcbs[id_jugador - 1];
+    uint64_t *inicio = &ctx->inicio_estado_ns[id_jugador - 1];
+
+    if (pcb->estado != estado)
+    {
+        bitacora_registrar(ctx, EVENTO_ESTADO, id_jugador, 0, estado);
+        histograma_desde(metrica_de_estado[pcb->estado], *inicio);
+        *inicio = reloj_ns();
+    }
+    else if (*inicio == 0)
+    {
+        *inicio = reloj_ns(); // Estado inicial, puesto sin pasar por aquí
+    }
+    pcb->estado = estado;
+}
+
+// Las funciones que siguen suponen mutex_colas tomado (los productores avisan a
+// siguiente_turno con él); toman mutex_pcbs solo mientras tocan los PCBs
+
+// Agrega al final de la cola de listos y despierta a quien espera un turno
+static void encolar_listo(contexto_juego_t *ctx, int id_jugador)
+{
+    if (cola_listos_contiene(&ctx->listos, id_jugador)) {
+        printf("[WARN] Jugador %d ya en LISTOS\n", id_jugador);
+        return;
+    }
+
+    // El PCB pasa a LISTO antes de publicarlo: el consumidor lo saca sin cerrojo
+    // y lo marca EJECUTANDO
+    cerrojo_tomar(&mutex_pcbs);
+    cambiar_estado(ctx, id_jugador, LISTO);
+    escribir_pcb(ctx->pcbs[id_jugador-1]);
+    cerrojo_soltar(&mutex_pcbs);
+
+    if (!cola_listos_encolar(&ctx->listos, id_jugador)) {
+        printf("[WARN] Jugador %d ya en LISTOS\n", id_jugador); // Lo encoló otro productor
+        return;
+    }
+
+    printf("[DEBUG] Jugador %d agregado a LISTOS\n", id_jugador);
+    pthread_cond_signal(&cond_listos);
+}
+
+// Quita a un jugador de la cola de listos, conservando el orden del resto
+static void quitar_de_cola_listos(contexto_juego_t *ctx, int id_jugador)
+{
+    if (cola_listos_quitar(&ctx->listos, id_jugador))
+        printf("[DEBUG] Jugador %d removido de LISTOS\n", id_jugador);
+}
+
+// Vuelve a llenar la cola de listos con todos los jugadores en juego.
+// Devuelve cuántos encoló.
+static int encolar_jugadores_en_juego(contexto_juego_t *ctx)
+{
+    int encolados = 0;
+
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+        cola_listos_quitar(&ctx->listos, ctx->jugadores[i].id);
+
+    cerrojo_tomar(&mutex_pcbs);
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        if (ctx->jugadores[i].en_juego)
+        {
+            cambiar_estado(ctx, ctx->jugadores[i].id, LISTO);
+            if (cola_listos_encolar(&ctx->listos, ctx->jugadores[i].id))
+                encolados++;
+        }
+    }
+    cerrojo_soltar(&mutex_pcbs);
+
+    pthread_cond_broadcast(&cond_listos);
+    return encolados;
+}
+
+// Pasa a LISTOS a los jugadores cuyo plazo de espera venció. Si quedan jugadores
+// esperando devuelve true y deja en *proximo el plazo más cercano.
+static bool atender_esperas_vencidas(contexto_juego_t *ctx, struct timespec *proximo)
+{
+    struct timespec ahora;
+    bool hay_pendientes = false;
+    bool hubo_cambios = false;
+    uint64_t inicio_ns = reloj_ns();
+
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+
+    for (int i = 0; i < ctx->num_de_esperas; i++) {
+        int id = ctx->cola_de_esperas[i];
+        long restante_ms = diferencia_ms(&ahora, &ctx->fin_de_espera[id-1]);
+
+        if (restante_ms > 0) {
+            // Segundos restantes (redondeo hacia arriba) para el PCB
+            cerrojo_tomar(&mutex_pcbs);
+            ctx->pcbs[id-1].tiempo_de_espera = (int)((restante_ms + 999) / 1000);
+            cerrojo_soltar(&mutex_pcbs);
+            if (!hay_pendientes || diferencia_ms(&ctx->fin_de_espera[id-1], proximo) > 0)
+                *proximo = ctx->fin_de_espera[id-1];
+            hay_pendientes = true;
+            continue;
+        }
+
+        // Paso 1: Mover a listos
+        // (restante_ms se trunca: puede faltar menos de un milisegundo para el plazo)
+        int64_t retraso_ns = (ahora.tv_sec - ctx->fin_de_espera[id-1].tv_sec) * 1000000000LL +
+                             (ahora.tv_nsec - ctx->fin_de_espera[id-1].tv_nsec);
+        histograma_registrar(METRICA_RETRASO_DESBLOQUEO, retraso_ns > 0 ? (uint64_t)retraso_ns : 0);
+        cerrojo_tomar(&mutex_pcbs);
+        ctx->pcbs[id-1].tiempo_de_espera = 0;
+        cerrojo_soltar(&mutex_pcbs);
+        encolar_listo(ctx, id);
+
+        // Paso 2: Eliminar de esperas
+        for (int j = i; j < ctx->num_de_esperas-1; j++) {
+            ctx->cola_de_esperas[j] = ctx->cola_de_esperas[j+1];
+        }
+        ctx->num_de_esperas--;
+        i--;  // Ajustar índice
+        hubo_cambios = true;
+    }
+
+    if (hubo_cambios)
+    {
+        cerrojo_tomar(&mutex_pcbs);
+        actualizar_tabla_procesos(ctx->pcbs, ctx->reglas.num_jugadores);
+        cerrojo_soltar(&mutex_pcbs);
+    }
+    histograma_desde(METRICA_REVISAR_ESPERAS, inicio_ns);
+    return hay_pendientes;
+}
+
+// Hilo principal que controla el estado global del juego
+void *hilo_juego_func(void *arg)
+{
+    contexto_juego_t *ctx = (contexto_juego_t *)arg;
+
+    cerrojo_tomar(&mutex_politica);
+    while (1)
+    {
+        // Detectar ganador al terminar cada turno
+        cerrojo_tomar(&mutex_mazo);
+        bloquear_manos();
+        int ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, ctx->mazo.cantidad == 0);
+        desbloquear_manos();
+        cerrojo_soltar(&mutex_mazo);
+        if (ganador != -1)
+        {
+            printf("\n¡Jugador %d (%s) ha ganado!\n", ctx->jugadores[ganador].id, ctx->jugadores[ganador].nombre);
+
+            // Actualizar estadísticas de todos los jugadores
+            cerrojo_tomar(&mutex_pcbs);
+            for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+            {
+                ctx->pcbs[i].partidas_jugadas++;
+                if (i == ganador)
+                    ctx->pcbs[i].partidas_ganadas++;
+                else
+                    ctx->pcbs[i].partidas_perdidas++;
+                escribir_pcb(ctx->pcbs[i]);
+            }
+            cerrojo_soltar(&mutex_pcbs);
+
+            bitacora_registrar(ctx, EVENTO_FIN, ganador + 1, 0, ctx->mazo.cantidad == 0);
+            bitacora_cerrar(ctx->bitacora);
+            detener_escritor_pcb();
+            cerrar_tabla_compartida();
+            histogramas_terminar();
+            perfil_cerrojos_informe(stderr);
+            exit(0);
+        }
+
+        // Cambiar política de planificación con teclas F/R
+        if (kbhit())
+        {
+            char c = getchar();
+            if (c == 'F' || c == 'f')
+                ctx->modo = 'F';
+            else if (c == 'R' || c == 'r')
+                ctx->modo = 'R';
+            printf("\nPolítica cambiada a %c\n", ctx->modo);
+        }
+
+        // Dormir hasta el próximo fin de turno
+        condicion_esperar(&cond_turno, &mutex_politica);
+    }
+    return NULL;
+}
+
+int calcular_quantum_dinamico(int jugadores_listos) {
+    int q = 20 / (jugadores_listos + 1);
+    return (q < 5) ? 5 : q;
+}
+
+// Requiere mutex_politica tomado
+void decidir_politica(contexto_juego_t *ctx) {
+    int total_espera = 0, jugadores_bloqueados = 0;
+
+    int jugadores_listos = cola_listos_cantidad(&ctx->listos);
+    cerrojo_tomar(&mutex_pcbs);
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++) {
+        if (ctx->pcbs[i].estado == DE_ESPERA) {
+            total_espera += ctx->pcbs[i].tiempo_de_espera;
+            jugadores_bloqueados++;
+        }
+    }
+    cerrojo_soltar(&mutex_pcbs);
+
+    if (jugadores_bloqueados > 1 || jugadores_listos >= ctx->reglas.num_jugadores / 2) {
+        // Modo Round Robin
+        ctx->modo = 'R';
+        ctx->quantum = 20 / (jugadores_listos + 1);
+        if (ctx->quantum < 5) ctx->quantum = 5;
+        printf("\n[Cambio] Modo RR - Quantum: %d segundos\n", ctx->quantum);
+    } else {
+        // Modo FCFS con quantum dinámico
+        ctx->modo = 'F';
+        
+        // Calcular quantum basado en tiempo de espera promedio y jugadores activos
+        int promedio_espera = (jugadores_bloqueados > 0) ? 
+                             (total_espera / jugadores_bloqueados) : 0;
+                             
+        ctx->quantum = 15 + (promedio_espera * 2) - (jugadores_listos * 1);
+        
+        // Aplicar límites
+        if (ctx->quantum < 10) ctx->quantum = 10;       // Mínimo 10s
+        else if (ctx->quantum > 30) ctx->quantum = 30;  // Máximo 30s
+        
+        printf("\n[Cambio] Modo FCFS - Quantum ajustado: %d segundos\n", ctx->quantum);
+    }
+}
+
+
+
+// Hilo planificador gestiona turnos de los jugadores
 void *planificador(void *arg)
 {
-    hilo_control_t *control = (hilo_control_t *)arg;
-    struct timespec sleep_time = {0, 100000000}; // 100ms
+    hilo_control_t *control = (hilo_control_t *)arg;
+    contexto_juego_t *ctx = control->contexto;
+    int turnos_vistos = 0;
+
+    cerrojo_tomar(control->mutex);
+    while (!*(control->terminar_flag))
+    {
+        // Dormir hasta que termine un turno o el juego (sin sondeo)
+        uint64_t dormido_desde = reloj_ns();
+        while (ctx->turnos_terminados == turnos_vistos && !*(control->terminar_flag))
+        {
+            condicion_esperar(control->cond, control->mutex);
+        }
+        if (*(control->terminar_flag))
+            break;
+        histograma_desde(METRICA_PLANIFICADOR_DORMIDO, dormido_desde);
+
+        turnos_vistos = ctx->turnos_terminados;
+        uint64_t decision_desde = reloj_ns();
+        decidir_politica(ctx); // Actualiza la política una vez por turno
+        histograma_desde(METRICA_DECIDIR_POLITICA, decision_desde);
+    }
+    cerrojo_soltar(control->mutex);
+    return NULL;
+}
+
+// Función para bloquear jugador
+void bloquear_jugador(contexto_juego_t *ctx, int id_jugador, int tiempo) {
+    uint64_t inicio_ns = reloj_ns();
+    cerrojo_tomar(&mutex_colas);
+    
+    // Paso 1: Remover de cola_listos si está presente
+    quitar_de_cola_listos(ctx, id_jugador);
+    
+    // Paso 2: Verificar si ya está en espera
+    bool ya_en_espera = false;
+    for (int i = 0; i < ctx->num_de_esperas; i++) {
+        if (ctx->cola_de_esperas[i] == id_jugador) {
+            ya_en_espera = true;
+            printf("[DEBUG] Jugador %d actualizado en DE_ESPERA: %ds\n", 
+                  id_jugador, tiempo);
+            break;
+        }
+    }
+    
+    // Paso 3: Agregar a espera si no estaba
+    cerrojo_tomar(&mutex_pcbs);
+    if (!ya_en_espera && ctx->num_de_esperas < ctx->reglas.num_jugadores) {
+        ctx->cola_de_esperas[ctx->num_de_esperas++] = id_jugador;
+        cambiar_estado(ctx, id_jugador, DE_ESPERA);
+        printf("[DEBUG] Jugador %d -> DE_ESPERA (%ds)\n", 
+              id_jugador, tiempo);
+    }
+
+    // El plazo es absoluto: el hilo de esperas duerme justo hasta el más cercano
+    ctx->pcbs[id_jugador-1].tiempo_de_espera = tiempo;
+    ctx->fin_de_espera[id_jugador-1] = plazo_en_ms(tiempo * 1000L);
+    pthread_cond_signal(&cond_esperas);
+    
+    // Actualizaciones comunes
+    escribir_pcb(ctx->pcbs[id_jugador-1]);
+    actualizar_tabla_procesos(ctx->pcbs, ctx->reglas.num_jugadores);
+    cerrojo_soltar(&mutex_pcbs);
+    
+    cerrojo_soltar(&mutex_colas);
+    histograma_desde(METRICA_BLOQUEAR_JUGADOR, inicio_ns);
+}
+
+// ----------------------------------------------------------------------
+// Turno del jugador como máquina de estados
+// ----------------------------------------------------------------------
+
+// Un turno no bloquea: avanza con cada línea de entrada (turno_entrada), con el
+// vencimiento de su plazo (turno_vencer) o con el cierre de la entrada
+// (turno_cerrar_entrada). Quien lo conduce decide cómo esperar esos eventos: el
+// hilo del jugador hace poll sobre la entrada estándar; el bucle de mesas
+// conduce miles de turnos a la vez desde un solo hilo.
+
+typedef enum
+{
+    FASE_OPCION, // Esperando la opción del menú (1-5)
+    FASE_FICHA,  // Esperando el número de ficha a embonar
+    FASE_FIN
+} fase_turno_t;
+
+typedef struct
+{
+    jugador_t *jugador;
+    fase_turno_t fase;
+    char modo;              // Política vigente al empezar: rige todo el turno
+    int quantum;
+    struct timespec inicio;
+    int fichas_a_elegir;    // Fichas en mano al pedir la ficha (FASE_FICHA)
+    bool entrada_cerrada;   // No llegará más entrada: solo queda agotar el plazo
+} turno_t;
+
+// Mensajes del turno: se callan en las partidas silenciosas
+static void turno_mensaje(const turno_t *turno, const char *formato, ...)
+{
+    if (turno->jugador->contexto->silencioso)
+        return;
+
+    va_list argumentos;
+    va_start(argumentos, formato);
+    vprintf(formato, argumentos);
+    va_end(argumentos);
+}
+
+static void turno_mostrar_menu(turno_t *turno)
+{
+    jugador_t *jugador = turno->jugador;
+
+    if (jugador->contexto->silencioso)
+        return;
+
+    cerrojo_tomar(&mutex_manos[jugador->id - 1]);
+    printf("\n=== Turno de %s ===\n", jugador->nombre);
+    mostrar_mano(&jugador->mano);
+    cerrojo_soltar(&mutex_manos[jugador->id - 1]);
+
+    printf("\nOpciones:\n");
+    printf("1. Robar ficha\n2. Hacer apeada\n3. Embonar ficha\n");
+    printf("4. Mostrar banco\n5. Pasar turno\n");
+    printf("\nSeleccione (1-5): ");
+    fflush(stdout);
+}
+
+// Plazo del turno en el reloj monotónico. Devuelve false si la fase actual no
+// tiene plazo (elegir ficha en FCFS espera sin límite).
+bool turno_plazo(const turno_t *turno, struct timespec *plazo)
+{
+    if (turno->fase == FASE_FICHA && turno->modo != 'R')
+        return false;
+
+    *plazo = turno->inicio;
+    plazo->tv_sec += turno->quantum;
+    return true;
+}
+
+// Cierra una acción: contabiliza el tiempo, actualiza los PCBs y decide si el
+// turno sigue (vuelve a mostrar el menú) o termina, y si terminó la partida
+static void turno_terminar_accion(turno_t *turno, bool hizo_accion, bool turno_activo)
+{
+    jugador_t *jugador = turno->jugador;
+    contexto_juego_t *ctx = jugador->contexto;
+    pthread_mutex_t *mi_mano = &mutex_manos[jugador->id - 1];
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - turno->inicio.tv_sec);
+    if (elapsed >= turno->quantum)
+    {
+        turno_mensaje(turno, "\n¡Quantum completado para %s!\n", jugador->nombre);
+        turno_activo = false;
+    }
+
+    cerrojo_tomar(mi_mano);
+    jugador->tiempo_restante = turno->quantum - (int)elapsed;
+
+    // Si hubo acción, actualizar PCB y tabla (las partidas silenciosas no los guardan)
+    if (hizo_accion && !ctx->silencioso)
+    {
+        cerrojo_tomar(&mutex_pcbs);
+        actualizar_y_escribir_pcb(&ctx->pcbs[jugador->id - 1], jugador);
+        actualizar_tabla_procesos(ctx->pcbs, ctx->reglas.num_jugadores);
+        cerrojo_soltar(&mutex_pcbs);
+    }
+    bool sin_fichas = (jugador->mano.cantidad == 0);
+    cerrojo_soltar(mi_mano);
+
+    if (!turno_activo)
+    {
+        turno_mensaje(turno, "\n=== Fin de turno de %s ===\n", jugador->nombre);
+    }
+
+    // Verificar condiciones de victoria
+    if (sin_fichas)
+    {
+        turno_mensaje(turno, "\n¡%s se ha quedado sin fichas y gana el juego!\n", jugador->nombre);
+        terminar_juego(ctx);
+        turno->fase = FASE_FIN;
+        return;
+    }
+
+    cerrojo_tomar(&mutex_mazo);
+    bool mazo_vacio = (ctx->mazo.cantidad == 0);
+    cerrojo_soltar(&mutex_mazo);
+
+    if (mazo_vacio)
+    {
+        turno_mensaje(turno, "\n¡El mazo se ha agotado!\n");
+        bloquear_manos();
+        int ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, true);
+        desbloquear_manos();
+        turno_mensaje(turno, "\n¡Jugador %d (%s) ha ganado!\n", ctx->jugadores[ganador].id,
+                      ctx->jugadores[ganador].nombre);
+        terminar_juego(ctx);
+        turno->fase = FASE_FIN;
+        return;
+    }
+
+    if (turno_activo && !juego_terminado(ctx))
+    {
+        turno->fase = FASE_OPCION;
+        turno_mostrar_menu(turno);
+    }
+    else
+    {
+        turno->fase = FASE_FIN;
+    }
+}
+
+// Roba la ficha del tope del mazo. Devuelve false si el mazo está vacío.
+static bool turno_robar(turno_t *turno)
+{
+    jugador_t *jugador = turno->jugador;
+    contexto_juego_t *ctx = jugador->contexto;
+    pcb_t *mi_pcb = &ctx->pcbs[jugador->id - 1];
+    bool robo = false;
+
+    cerrojo_tomar(&mutex_mazo);
+    cerrojo_tomar(&mutex_manos[jugador->id - 1]);
+    if (ctx->mazo.cantidad > 0)
+    {
+        ficha_t nueva = ctx->mazo.fichas[--ctx->mazo.cantidad];
+        agregar_ficha(&jugador->mano, nueva);
+        bitacora_registrar(ctx, EVENTO_ROBO, jugador->id, nueva, 0);
+        if (!ctx->silencioso)
+            mostrar_robo_ficha(&nueva, false);
+        robo = true;
+
+        cerrojo_tomar(&mutex_pcbs);
+        mi_pcb->fichas_en_mano = jugador->mano.cantidad;
+        mi_pcb->fichas_robadas++;
+        cerrojo_soltar(&mutex_pcbs);
+    }
+    cerrojo_soltar(&mutex_manos[jugador->id - 1]);
+    cerrojo_soltar(&mutex_mazo);
+    return robo;
+}
+
+// Empieza el turno del jugador con la política vigente y muestra el menú
+void turno_iniciar(turno_t *turno, jugador_t *jugador)
+{
+    contexto_juego_t *ctx = jugador->contexto;
+
+    turno->jugador = jugador;
+    turno->fichas_a_elegir = 0;
+    turno->entrada_cerrada = false;
+
+    // El planificador cambia la política entre turnos
+    cerrojo_tomar(&mutex_politica);
+    turno->modo = ctx->modo;
+    turno->quantum = ctx->quantum;
+    cerrojo_soltar(&mutex_politica);
+
+    clock_gettime(CLOCK_MONOTONIC, &turno->inicio);
+
+    if (juego_terminado(ctx))
+    {
+        turno->fase = FASE_FIN;
+        return;
+    }
+    turno->fase = FASE_OPCION;
+    turno_mostrar_menu(turno);
+}
+
+// Elige la ficha a embonar (FASE_FICHA)
+static void turno_elegir_ficha(turno_t *turno, const char *linea)
+{
+    jugador_t *jugador = turno->jugador;
+    contexto_juego_t *ctx = jugador->contexto;
+    bool hizo_accion = false;
+    bool turno_activo = true;
+
+    int idx = atoi(linea) - 1;
+    if (idx >= 0 && idx < turno->fichas_a_elegir)
+    {
+        cerrojo_escribir(&cerrojo_mesa);
+        cerrojo_tomar(&mutex_manos[jugador->id - 1]);
+        bool embono = embonar_ficha(jugador, &ctx->banco_apeadas, idx);
+        int en_mano = jugador->mano.cantidad;
+        cerrojo_soltar(&mutex_manos[jugador->id - 1]);
+        cerrojo_rw_soltar(&cerrojo_mesa);
+
+        if (embono)
+        {
+            turno_mensaje(turno, "\n¡Ficha embonada con éxito!\n");
+            hizo_accion = true;
+
+            // Actualizar PCB después de embonar
+            cerrojo_tomar(&mutex_pcbs);
+            ctx->pcbs[jugador->id - 1].fichas_en_mano = en_mano;
+            ctx->pcbs[jugador->id - 1].embones_realizados++;
+            cerrojo_soltar(&mutex_pcbs);
+
+            if (turno->modo == 'F')
+            {
+                turno_activo = false;
+            }
+        }
+        else
+        {
+            turno_mensaje(turno, "\nNo se pudo embonar la ficha\n");
+        }
+    }
+    else
+    {
+        turno_mensaje(turno, "\nÍndice inválido\n");
+    }
+
+    turno_terminar_accion(turno, hizo_accion, turno_activo);
+}
+
+// Procesa una línea de entrada del jugador
+void turno_entrada(turno_t *turno, const char *linea)
+{
+    jugador_t *jugador = turno->jugador;
+    contexto_juego_t *ctx = jugador->contexto;
+    pthread_mutex_t *mi_mano = &mutex_manos[jugador->id - 1];
+    bool hizo_accion = false;
+    bool turno_activo = true;
+
+    if (turno->fase == FASE_FICHA)
+    {
+        turno_elegir_ficha(turno, linea);
+        return;
+    }
+    if (turno->fase != FASE_OPCION)
+        return;
+
+    int opcion = atoi(linea);
+    switch (opcion)
+    {
+    case 1:
+        if (turno_robar(turno))
+        {
+            jugador->ficha_agregada = true;
+            turno_activo = false;
+            hizo_accion = true;
+        }
+        break;
+
+    case 2:
+        // realizar_apeada_optima cambia la mesa, la mano y las estadísticas
+        cerrojo_escribir(&cerrojo_mesa);
+        cerrojo_tomar(mi_mano);
+        cerrojo_tomar(&mutex_pcbs);
+        if (puede_hacer_apeada(jugador))
+        {
+            apeada_t apeada = calcular_mejor_apeada_aux(jugador);
+            if (realizar_apeada_optima(jugador, &ctx->banco_apeadas))
+            {
+                turno_mensaje(turno, "\n¡Apeada exitosa!\n");
+                if (!ctx->silencioso)
+                    mostrar_apeada(&apeada);
+                hizo_accion = true;
+
+                // Actualizar PCB después de apear
+                ctx->pcbs[jugador->id - 1].fichas_en_mano = jugador->mano.cantidad;
+                ctx->pcbs[jugador->id - 1].apeadas_realizadas++;
+
+                if (turno->modo == 'F')
+                {
+                    turno_activo = false;
+                }
+            }
+            apeada_liberar(&apeada);
+        }
+        else
+        {
+            turno_mensaje(turno, "\nNo tienes combinaciones válidas para apear\n");
+        }
+        cerrojo_soltar(&mutex_pcbs);
+        cerrojo_soltar(mi_mano);
+        cerrojo_rw_soltar(&cerrojo_mesa);
+        break;
+
+    case 3:
+    {
+        cerrojo_tomar(mi_mano);
+        int cantidad = jugador->mano.cantidad;
+        if (cantidad > 0 && !ctx->silencioso)
+            mostrar_mano(&jugador->mano);
+        cerrojo_soltar(mi_mano);
+
+        if (cantidad > 0)
+        {
+            // La acción sigue con la próxima línea
+            turno_mensaje(turno, "\nSeleccione ficha (1-%d): ", cantidad);
+            if (!ctx->silencioso)
+                fflush(stdout);
+            turno->fichas_a_elegir = cantidad;
+            turno->fase = FASE_FICHA;
+            return;
+        }
+        turno_mensaje(turno, "\nNo tienes fichas para embonar\n");
+        break;
+    }
+
+    case 4:
+        // Solo lectura: puede mostrarse mientras otros leen la mesa
+        if (!ctx->silencioso)
+        {
+            cerrojo_leer(&cerrojo_mesa);
+            mostrar_banco(&ctx->banco_apeadas);
+            cerrojo_rw_soltar(&cerrojo_mesa);
+        }
+        break;
+
+    case 5:
+        if (turno_robar(turno))
+            turno_mensaje(turno, "\nHas pasado el turno y robado una ficha.\n");
+        else
+            turno_mensaje(turno, "\nNo se puede robar una ficha: el mazo está vacío.\n");
+        turno_activo = false;
+        hizo_accion = true;
+        break;
+
+    default:
+        turno_mensaje(turno, "\nOpción inválida. Por favor seleccione 1-5\n");
+        break;
+    }
+
+    turno_terminar_accion(turno, hizo_accion, turno_activo);
+}
+
+// Venció el plazo del turno
+void turno_vencer(turno_t *turno)
+{
+    if (turno->fase == FASE_FIN)
+        return;
+
+    turno_mensaje(turno, "\n¡Tiempo agotado para %s!\n", turno->jugador->nombre);
+    turno_terminar_accion(turno, false, false);
+}
+
+// Se cerró la entrada: si se esperaba una ficha ya no hay cuál elegir; en el menú
+// el turno sigue hasta agotar su plazo
+void turno_cerrar_entrada(turno_t *turno)
+{
+    turno->entrada_cerrada = true;
+    if (turno->fase == FASE_FICHA)
+        turno_terminar_accion(turno, false, false);
+}
+
+// Termina el turno sin más acciones (el bot MCTS, después de colocar fichas)
+void turno_ceder(turno_t *turno)
+{
+    if (turno->fase != FASE_FIN)
+        turno_terminar_accion(turno, false, false);
+}
+
+// ----------------------------------------------------------------------
+// Función del hilo del jugador
+// ----------------------------------------------------------------------
+
+void turno_mcts_conducir(turno_t *turno);
+
+// Conduce el turno del jugador desde la entrada estándar: espera cada línea solo
+// lo que queda del quantum (sin despertares periódicos ni cerrojos tomados). Los
+// turnos del bot MCTS los conduce su búsqueda.
+void *jugador_thread(void *arg)
+{
+    jugador_t *jugador = (jugador_t *)arg;
+    turno_t turno;
+
+    // siguiente_turno marcó el instante en que pasó a EJECUTANDO, antes de la
+    // entrega al trabajador
+    uint64_t inicio_ns = reloj_ns();
+    histograma_desde(METRICA_DESPACHO, jugador->contexto->inicio_estado_ns[jugador->id - 1]);
+
+    turno_iniciar(&turno, jugador);
+    if (turno.fase != FASE_FIN && jugador->id <= jugador->contexto->bots_mcts)
+        turno_mcts_conducir(&turno);
+    while (turno.fase != FASE_FIN)
+    {
+        struct timespec plazo, ahora;
+        int espera_ms = -1;
+
+        if (turno_plazo(&turno, &plazo))
+        {
+            clock_gettime(CLOCK_MONOTONIC, &ahora);
+            long restante_ms = diferencia_ms(&ahora, &plazo);
+            if (restante_ms <= 0)
+            {
+                turno_vencer(&turno);
+                continue;
+            }
+            espera_ms = (int)restante_ms;
+        }
+
+        if (turno.entrada_cerrada)
+        {
+            poll(NULL, 0, espera_ms); // Agotar el quantum dormido
+            continue;
+        }
+
+        struct pollfd mypoll = {STDIN_FILENO, POLLIN, 0};
+        if (poll(&mypoll, 1, espera_ms) > 0)
+        {
+            char input[10] = {0};
+            if (read(STDIN_FILENO, input, sizeof(input) - 1) > 0)
+                turno_entrada(&turno, input);
+            else
+                turno_cerrar_entrada(&turno);
+        }
+    }
+
+    histograma_desde(METRICA_TURNO, inicio_ns);
+    return NULL;
+}
+
+// Marca el fin del juego y despierta a todos los hilos que esperan un evento
+// (no debe tenerse ningún cerrojo de la partida al llamarla)
+void terminar_juego(contexto_juego_t *ctx)
+{
+    cerrojo_tomar(&mutex_politica);
+    cerrojo_tomar(&mutex_colas);
+    __atomic_store_n(&ctx->terminado, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&cond_turno);
+    pthread_cond_broadcast(&cond_listos);
+    pthread_cond_broadcast(&cond_esperas);
+    cerrojo_soltar(&mutex_colas);
+    cerrojo_soltar(&mutex_politica);
+}
+
+// Función para agregar a cola de listos
+void agregar_a_cola_listos(contexto_juego_t *ctx, int id_jugador) {
+    cerrojo_tomar(&mutex_colas);
+    encolar_listo(ctx, id_jugador);
+    cerrojo_soltar(&mutex_colas);
+}
+
+
+// Función para inicializar PCBs
+void inicializar_pcbs(contexto_juego_t *ctx)
+{
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        // Identificación básica
+        ctx->pcbs[i].id_jugador = i + 1;
+        snprintf(ctx->pcbs[i].nombre, sizeof(ctx->pcbs[i].nombre), "Jugador %d", i + 1);
+
+        // Estado del proceso/jugador
+        ctx->pcbs[i].estado = LISTO;       // Estado inicial (LISTO, EJECUTANDO, DE_ESPERA)
+        ctx->pcbs[i].tiempo_de_espera = 0; // Tiempo restante de bloqueo
+
+        // Estadísticas del juego
+        ctx->pcbs[i].fichas_en_mano = ctx->reglas.fichas_iniciales;
+        ctx->pcbs[i].puntos = 0;
+        ctx->pcbs[i].partidas_jugadas = 0;
+        ctx->pcbs[i].partidas_ganadas = 0;
+        ctx->pcbs[i].partidas_perdidas = 0;
+
+        // Tiempos y contadores
+        ctx->pcbs[i].tiempo_total_juego = 0;
+        ctx->pcbs[i].turnos_jugados = 0;
+        ctx->pcbs[i].tiempo_restante = ctx->quantum;
+
+        // Acciones del juego
+        ctx->pcbs[i].fichas_robadas = 0;
+        ctx->pcbs[i].fichas_desfichadas = 0;
+        ctx->pcbs[i].grupos_formados = 0;
+        ctx->pcbs[i].escaleras_formadas = 0;
+        ctx->pcbs[i].apeadas_realizadas = 0;
+        ctx->pcbs[i].embones_realizados = 0;
+        ctx->pcbs[i].victorias_con_escalera = 0;
+
+        // Agregar a la cola de listos inicial
+        agregar_a_cola_listos(ctx, ctx->pcbs[i].id_jugador);
+    }
+}
+
+// Hilo que verifica jugadores de_esperas periódicamente
+void *verificar_de_esperas(void *arg)
+{
+    hilo_control_t *control = (hilo_control_t *)arg;
+    contexto_juego_t *ctx = control->contexto;
+
+    cerrojo_tomar(&mutex_colas);
+    while (!*(control->terminar_flag))
+    {
+        // Dormir hasta el plazo de espera más cercano, o hasta que alguien entre
+        // en espera si no hay ninguno
+        struct timespec proximo;
+        if (atender_esperas_vencidas(ctx, &proximo))
+            condicion_esperar_hasta(&cond_esperas, &mutex_colas, &proximo);
+        else
+            condicion_esperar(&cond_esperas, &mutex_colas);
+    }
+    cerrojo_soltar(&mutex_colas);
+
+    return NULL;
+}
+
+// Bloquea hasta que haya un jugador listo y lo saca de la cola. Si no queda nadie
+// listo ni en espera, vuelve a encolar a todos los que siguen en juego.
+// Devuelve -1 si el juego terminó.
+int siguiente_turno(contexto_juego_t *ctx)
+{
+    if (juego_terminado(ctx))
+        return -1;
+
+    // Camino rápido: sacar sin cerrojo. mutex_colas solo hace falta para dormir,
+    // y los productores avisan con él tomado, así que el aviso no se pierde.
+    int id = cola_listos_sacar(&ctx->listos);
+    if (id == -1)
+    {
+        cerrojo_tomar(&mutex_colas);
+        while (!ctx->terminado)
+        {
+            id = cola_listos_sacar(&ctx->listos);
+            if (id != -1)
+                break;
+
+            if (ctx->num_de_esperas == 0 && encolar_jugadores_en_juego(ctx) > 0)
+                continue;
+
+            condicion_esperar(&cond_listos, &mutex_colas);
+        }
+        cerrojo_soltar(&mutex_colas);
+    }
+
+    if (id != -1)
+    {
+        cerrojo_tomar(&mutex_pcbs);
+        cambiar_estado(ctx, id, EJECUTANDO);
+        cerrojo_soltar(&mutex_pcbs);
+    }
+    return id;
+}
+
+// Al terminar su turno el jugador pasa a DE_ESPERA entre 1 y 10 segundos; el
+// hilo de esperas lo devuelve a LISTOS cuando vence el plazo
+void mover_a_cola_de_esperas(contexto_juego_t *ctx, int id_jugador)
+{
+    bloquear_jugador(ctx, id_jugador, (int)generador_rango(&ctx->generador, 10) + 1);
+}
+
+
+// Un hilo fijo por jugador, dormido en su propia condición hasta que el
+// despachador le entrega un turno. Cada jugador tiene un único contexto de
+// ejecución: nunca corren dos turnos suyos a la vez.
+typedef struct
+{
+    pthread_mutex_t mutex; // Hoja: solo protege la entrega del turno
+    pthread_cond_t cond;   // Turno entregado o turno terminado
+    jugador_t *jugador;
+    bool turno_pendiente;  // El despachador lo pone, el trabajador lo limpia al terminar
+    bool detener;
+    pthread_t hilo;
+} trabajador_jugador_t;
+
+static trabajador_jugador_t trabajadores_jugadores[MAX_JUGADORES];
+static int num_trabajadores_jugadores; // Uno por jugador de la partida interactiva
+
+static void *trabajador_jugador_thread(void *arg)
+{
+    trabajador_jugador_t *trabajador = (trabajador_jugador_t *)arg;
+
+    cerrojo_tomar(&trabajador->mutex);
+    for (;;)
+    {
+        while (!trabajador->turno_pendiente && !trabajador->detener)
+            condicion_esperar(&trabajador->cond, &trabajador->mutex);
+        if (trabajador->detener)
+            break;
+
+        cerrojo_soltar(&trabajador->mutex);
+        jugador_thread(trabajador->jugador);
+        cerrojo_tomar(&trabajador->mutex);
+
+        trabajador->turno_pendiente = false;
+        pthread_cond_signal(&trabajador->cond);
+    }
+    cerrojo_soltar(&trabajador->mutex);
+    return NULL;
+}
+
+// Crea los trabajadores de los jugadores; quedan dormidos hasta su turno
+void iniciar_concurrencia(contexto_juego_t *ctx)
+{
+    num_trabajadores_jugadores = ctx->reglas.num_jugadores;
+    for (int i = 0; i < num_trabajadores_jugadores; i++)
+    {
+        trabajador_jugador_t *trabajador = &trabajadores_jugadores[i];
+
+        pthread_mutex_init(&trabajador->mutex, NULL);
+        pthread_cond_init(&trabajador->cond, NULL);
+        trabajador->jugador = &ctx->jugadores[i];
+        trabajador->turno_pendiente = false;
+        trabajador->detener = false;
+
+        if (pthread_create(&trabajador->hilo, NULL, trabajador_jugador_thread, trabajador) != 0)
+        {
+            perror("Error creando hilo de jugador");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Entrega el turno al trabajador del jugador y espera a que lo termine
+void jugar_turno(int id_jugador)
+{
+    trabajador_jugador_t *trabajador = &trabajadores_jugadores[id_jugador - 1];
+
+    cerrojo_tomar(&trabajador->mutex);
+    trabajador->turno_pendiente = true;
+    pthread_cond_signal(&trabajador->cond);
+    while (trabajador->turno_pendiente)
+        condicion_esperar(&trabajador->cond, &trabajador->mutex);
+    cerrojo_soltar(&trabajador->mutex);
+}
+
+void detener_concurrencia(void)
+{
+    for (int i = 0; i < num_trabajadores_jugadores; i++)
+    {
+        trabajador_jugador_t *trabajador = &trabajadores_jugadores[i];
+
+        cerrojo_tomar(&trabajador->mutex);
+        trabajador->detener = true;
+        pthread_cond_signal(&trabajador->cond);
+        cerrojo_soltar(&trabajador->mutex);
+
+        pthread_join(trabajador->hilo, NULL);
+        pthread_cond_destroy(&trabajador->cond);
+        pthread_mutex_destroy(&trabajador->mutex);
+    }
+}
+
+// Activa el perfil de contención con los nombres de los cerrojos del programa.
+// Antes de crear cualquier hilo.
+void perfil_cerrojos_iniciar(void)
+{
+    perfil_nombrar_cerrojo(&mutex_politica, "mutex_politica");
+    perfil_nombrar_cerrojo(&mutex_colas, "mutex_colas");
+    perfil_nombrar_cerrojo(&cerrojo_mesa, "cerrojo_mesa");
+    perfil_nombrar_cerrojo(&mutex_mazo, "mutex_mazo");
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        perfil_nombrar_cerrojo(&mutex_manos[i], "mutex_manos");
+    perfil_nombrar_cerrojo(&mutex_pcbs, "mutex_pcbs");
+    perfil_nombrar_cerrojo(&escritor_pcb.mutex, "escritor_pcb");
+    perfil_nombrar_cerrojo(&mutex_tabla_compartida, "mutex_tabla_compartida");
+    perfil_nombrar_cerrojo(&mutex_histogramas, "mutex_histogramas");
+    for (int i = 0; i < MAX_JUGADORES; i++)
+        perfil_nombrar_cerrojo(&trabajadores_jugadores[i].mutex, "trabajador_jugador");
+    perfil_cerrojos_activo = true;
+}
+
+// ----------------------------------------------------------------------
+// Funciones para Algoritmos de Planificación (FCFS y Round Robin)
+// ----------------------------------------------------------------------
+
+// Función para capturar teclas sin bloqueo
+int kbhit()
+{
+    struct termios oldt, newt;
+    int ch, oldf;
+
+    tcgetattr(STDIN_FILENO, &oldt);
+    newt = oldt;
+    newt.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
+    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
+
+    ch = getchar();
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+    fcntl(STDIN_FILENO, F_SETFL, oldf);
+
+    if (ch != EOF)
+    {
+        ungetc(ch, stdin);
+        return 1;
+    }
+    return 0;
+}
+
+// Muestra el estado actual del juego
+// Solo lee: la mesa se comparte con otros lectores
+void mostrar_estado_juego(contexto_juego_t *ctx)
+{
+    cerrojo_leer(&cerrojo_mesa);
+    bloquear_manos();
+
+    printf("\n=== ESTADO ACTUAL ===\n");
+    mostrar_banco(&ctx->banco_apeadas);
+
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        printf("\nJugador %d (%s): %d fichas, %d puntos\n",
+               ctx->jugadores[i].id,
+               ctx->jugadores[i].nombre,
+               ctx->jugadores[i].mano.cantidad,
+               calcular_puntos_mano(&ctx->jugadores[i].mano));
+    }
+
+    desbloquear_manos();
+    cerrojo_rw_soltar(&cerrojo_mesa);
+}
+
+// Manejador de turnos (se usa en un hilo)
+void *manejar_turnos(void *arg)
+{
+    contexto_juego_t *ctx = (contexto_juego_t *)arg;
+
+    while (1)
+    {
+        cerrojo_tomar(&mutex_politica);
+
+        // Si no hay jugadores listos, esperar
+        if (cola_listos_cantidad(&ctx->listos) == 0)
+        {
+            cerrojo_soltar(&mutex_politica);
+            sleep(1);
+            continue;
+        }
+
+        int jugador_id = siguiente_turno(ctx); // Tomar el jugador al frente de la cola
+        if (jugador_id == -1)
+        {
+            cerrojo_soltar(&mutex_politica);
+            return NULL;
+        }
+
+        // Round Robin: reinsertar al final de la cola si sigue en juego
+        if (ctx->modo == 'R' && ctx->jugadores[jugador_id - 1].en_juego)
+        {
+            agregar_a_cola_listos(ctx, jugador_id);
+        }
+
+        ctx->turno_actual = jugador_id;
+        jugador_t *jugador_actual = &ctx->jugadores[jugador_id - 1];
+
+        printf("\nTurno del jugador: %s (ID: %d)\n", jugador_actual->nombre, jugador_id);
+
+        // Verificar si el jugador tiene tiempo restante
+        if (jugador_actual->tiempo_restante <= 0)
+        {
+            printf("\nJugador %s ha perdido su turno por falta de tiempo.\n", jugador_actual->nombre);
+            cerrojo_soltar(&mutex_politica);
+            continue; // Pasar al siguiente jugador
+        }
+
+        // Simulación del turno
+        int tiempo_juego = (ctx->modo == 'R' && jugador_actual->tiempo_restante > ctx->quantum) ? ctx->quantum : jugador_actual->tiempo_restante;
+        sleep(tiempo_juego);
+        jugador_actual->tiempo_restante -= tiempo_juego;
+
+        if (jugador_actual->tiempo_restante <= 0)
+        {
+            printf("\nTiempo agotado para el jugador %s\n", jugador_actual->nombre);
+        }
+
+        cerrojo_soltar(&mutex_politica);
+        sleep(1);
+    }
+    return NULL;
+}
+
+void mostrar_politica_actual(contexto_juego_t *ctx) {
+    cerrojo_tomar(&mutex_politica);
+    char modo = ctx->modo;
+    int quantum = ctx->quantum;
+    cerrojo_soltar(&mutex_politica);
+
+    const char* politica = (modo == 'F') ? 
+        "FCFS (Turnos completos en orden de llegada)" : 
+        "Round Robin (Quantum de %d segundos)";
+    
+    if (modo == 'F') {
+        printf("\nPolítica actual: %s\n", politica);
+    } else {
+        printf("\nPolítica actual: ");
+        printf(politica, quantum);
+        printf("\n");
+    }
+    printf("───────────────────────────────────────────────────────\n");
+}
+
+void elegir_politica(contexto_juego_t *ctx)
+{
+    cerrojo_tomar(&mutex_politica);
+    int quantum = ctx->quantum;
+    cerrojo_soltar(&mutex_politica);
+
+    printf("\n╔════════════════════════════════════════════╗");
+    printf("\n║   SELECCIÓN DE POLÍTICA DE PLANIFICACIÓN   ║");
+    printf("\n╠════════════════════════════════════════════╣");
+    printf("\n║ F - First Come First Served (FCFS)         ║");
+    printf("\n║ R - Round Robin (Quantum %d segundos)      ║", quantum);
+    printf("\n╚════════════════════════════════════════════╝");
+    printf("\nSeleccione política (F/R): ");
+
+    char opcion;
+    scanf(" %c", &opcion);
+    getchar(); // Limpiar buffer
+
+    // La respuesta se lee sin cerrojo; solo el cambio se hace con mutex_politica
+    cerrojo_tomar(&mutex_politica);
+    if (opcion == 'F' || opcion == 'f')
+    {
+        ctx->modo = 'F';
+        printf("\nPolítica cambiada a FCFS: Turnos completos en orden de llegada\n");
+    }
+    else if (opcion == 'R' || opcion == 'r')
+    {
+        ctx->modo = 'R';
+        printf("\nPolítica cambiada a Round Robin: Quantum de %d segundos\n", ctx->quantum);
+    }
+    else
+    {
+        printf("\nManteniendo política actual: %s\n",
+               (ctx->modo == 'F') ? "FCFS" : "Round Robin");
+    }
+    cerrojo_soltar(&mutex_politica);
+
+    mostrar_politica_actual(ctx);
+}
+
+// Función auxiliar para mostrar mensajes de robo de ficha
+void mostrar_robo_ficha(const ficha_t *ficha, bool es_automatico)
+{
+    printf("%s: %d de %s\n",
+           es_automatico ? "\nRobaste automáticamente" : "Robaste",
+           ficha_numero(*ficha),
+           ficha_nombre_color(*ficha));
+}
+
+// ----------------------------------------------------------------------
+// Simulación por lotes (sin interfaz)
+// ----------------------------------------------------------------------
+
+#define MAX_TURNOS_SIMULACION 2000 // Corte de seguridad por partida simulada
+
+// Resultado de una partida simulada
+typedef struct
+{
+    int ganador;                       // Índice del jugador ganador
+    int turnos;                        // Turnos jugados (tiempo virtual de la partida)
+    bool por_puntos;                   // true si se decidió por menor puntaje y no por quedarse sin fichas
+    int puntos_en_mano[MAX_JUGADORES]; // Puntos que le quedaron en mano a cada jugador
+} resultado_simulacion_t;
+
+// Un hilo del torneo: juega partidas con su propio contexto hasta agotar el total
+typedef struct
+{
+    contexto_juego_t contexto;
+    pthread_t hilo;
+    int *siguiente_partida; // Contador compartido entre hilos (operaciones atómicas)
+    int partidas_totales;
+    uint64_t semilla_base;  // La partida k se juega con semilla_base + k
+    int partidas_jugadas;
+    long turnos;
+    int partidas_por_puntos;
+    long puntos_en_mano[MAX_JUGADORES];
+    int turnos_partida_mas_larga;     // Para repetir la partida más lenta con --semilla
+    uint64_t semilla_partida_mas_larga;
+} trabajador_torneo_t;
+
+// Turno de un jugador automático: apea si puede, embona en la mesa todo lo que quepa
+// y, si no colocó ninguna ficha, roba del mazo. Devuelve false si tenía que robar y
+// el mazo ya estaba vacío. coloco_fichas indica que el turno ya colocó fichas antes
+// (el bot MCTS termina así los turnos que deja a medias).
+static bool turno_automatico_desde(jugador_t *jugador, bool coloco_fichas)
+{
+    contexto_juego_t *ctx = jugador->contexto;
+    pcb_t *pcb = &ctx->pcbs[jugador->id - 1];
+
+    if (puede_hacer_apeada(jugador) && realizar_apeada_optima(jugador, &ctx->banco_apeadas))
+    {
+        pcb->apeadas_realizadas++;
+        coloco_fichas = true;
+    }
+
+    // Solo se embona después de la primera apeada; se repite porque cada ficha
+    // embonada puede abrir hueco para otra
+    bool embono = jugador->puntos_suficientes;
+    while (embono)
+    {
+        embono = false;
+        for (int i = jugador->mano.cantidad - 1; i >= 0; i--)
+        {
+            if (embonar_ficha(jugador, &ctx->banco_apeadas, i))
+            {
+                pcb->embones_realizados++;
+                coloco_fichas = embono = true;
+            }
+        }
+    }
+
+    // Cada turno avanza una unidad de tiempo virtual
+    pcb->turnos_jugados++;
+    pcb->tiempo_total_juego++;
+
+    if (!coloco_fichas && jugador->mano.cantidad > 0)
+    {
+        if (ctx->mazo.cantidad == 0)
+            return false;
+
+        ficha_t nueva = ctx->mazo.fichas[--ctx->mazo.cantidad];
+        agregar_ficha(&jugador->mano, nueva);
+        bitacora_registrar(ctx, EVENTO_ROBO, jugador->id, nueva, 0);
+        pcb->fichas_robadas++;
+    }
+
+    pcb->fichas_en_mano = jugador->mano.cantidad;
+    return true;
+}
+
+static bool turno_automatico(jugador_t *jugador)
+{
+    return turno_automatico_desde(jugador, false);
+}
+
+// Juega una partida completa entre jugadores automáticos en orden circular. La
+// partida depende solo de la semilla. Los PCBs del contexto acumulan las
+// estadísticas de todas sus partidas.
+static resultado_simulacion_t simular_partida(contexto_juego_t *ctx, uint64_t semilla)
+{
+    resultado_simulacion_t resultado = {-1, 0, false, {0}};
+
+    ctx->semilla = semilla;
+    generador_sembrar(&ctx->generador, semilla);
+    bitacora_iniciar_partida(ctx);
+
+    inicializar_mazo(&ctx->mazo, &ctx->reglas);
+    barajar_mazo(&ctx->mazo, &ctx->generador);
+    banco_inicializar(&ctx->banco_apeadas);
+    inicializar_jugadores(ctx);
+
+    for (int turno = 0; turno < MAX_TURNOS_SIMULACION; turno++)
+    {
+        jugador_t *actual = &ctx->jugadores[turno % ctx->reglas.num_jugadores];
+        resultado.turnos++;
+
+        bool jugo = actual->id <= ctx->bots_mcts ? turno_mcts(actual) : turno_automatico(actual);
+        if (!jugo || jugador_ha_ganado(actual))
+            break;
+    }
+
+    // Mazo agotado o corte de seguridad: gana el de menor puntaje en mano
+    resultado.ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, true);
+    resultado.por_puntos = !jugador_ha_ganado(&ctx->jugadores[resultado.ganador]);
+    bitacora_registrar(ctx, EVENTO_FIN, resultado.ganador + 1, 0, 1);
+
+    for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+    {
+        resultado.puntos_en_mano[i] = calcular_puntos_mano(&ctx->jugadores[i].mano);
+
+        ctx->pcbs[i].partidas_jugadas++;
+        if (i == resultado.ganador)
+            ctx->pcbs[i].partidas_ganadas++;
+        else
+            ctx->pcbs[i].partidas_perdidas++;
+    }
+
+    banco_liberar(&ctx->banco_apeadas);
+    liberar_jugadores(ctx);
+    return resultado;
+}
+
+// Hilo del torneo: toma números de partida del contador compartido y acumula
+// los resultados en su propio trabajador (sin compartir estado de juego)
+static void *hilo_torneo(void *arg)
+{
+    trabajador_torneo_t *trabajador = (trabajador_torneo_t *)arg;
+    int numero;
+
+    while ((numero = __atomic_fetch_add(trabajador->siguiente_partida, 1, __ATOMIC_RELAXED)) <
+           trabajador->partidas_totales)
+    {
+        uint64_t semilla = trabajador->semilla_base + (uint64_t)numero;
+        resultado_simulacion_t resultado = simular_partida(&trabajador->contexto, semilla);
+
+        if (resultado.turnos > trabajador->turnos_partida_mas_larga)
+        {
+            trabajador->turnos_partida_mas_larga = resultado.turnos;
+            trabajador->semilla_partida_mas_larga = semilla;
+        }
+
+        trabajador->partidas_jugadas++;
+        trabajador->turnos += resultado.turnos;
+        if (resultado.por_puntos)
+            trabajador->partidas_por_puntos++;
+        for (int i = 0; i < trabajador->contexto.reglas.num_jugadores; i++)
+            trabajador->puntos_en_mano[i] += resultado.puntos_en_mano[i];
+    }
+
+    return NULL;
+}
+
+// Juega partidas_totales partidas repartidas entre num_hilos hilos, cada uno con su
+// propio contexto, y reporta el rendimiento y las estadísticas agregadas. Los
+// resultados no dependen de qué hilo jugó cada partida. Con un solo hilo, las
+// partidas pueden registrarse en una bitácora y los primeros bots_mcts jugadores
+// pueden ser el bot MCTS (ya iniciado con mcts_iniciar).
+int simular_partidas(int partidas_totales, int num_hilos, uint64_t semilla_base, bitacora_t *bitacora,
+                     const reglas_t *reglas, int bots_mcts)
+{
+    trabajador_torneo_t *trabajadores = (trabajador_torneo_t *)calloc(num_hilos, sizeof(trabajador_torneo_t));
+    if (trabajadores == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para los hilos del torneo\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int siguiente_partida = 0;
+    struct timespec inicio, fin;
+
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (int h = 0; h < num_hilos; h++)
+    {
+        trabajador_torneo_t *trabajador = &trabajadores[h];
+        contexto_inicializar(&trabajador->contexto, reglas);
+        trabajador->contexto.silencioso = true;
+        trabajador->contexto.bitacora = (num_hilos == 1) ? bitacora : NULL;
+        trabajador->contexto.bots_mcts = (num_hilos == 1) ? bots_mcts : 0;
+        trabajador->siguiente_partida = &siguiente_partida;
+        trabajador->partidas_totales = partidas_totales;
+        trabajador->semilla_base = semilla_base;
+
+        if (pthread_create(&trabajador->hilo, NULL, hilo_torneo, trabajador) != 0)
+        {
+            perror("Error creando hilos del torneo");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Agregar los resultados de todos los hilos
+    pcb_t total[MAX_JUGADORES] = {0};
+    long puntos_en_mano[MAX_JUGADORES] = {0};
+    long turnos_totales = 0;
+    int partidas_por_puntos = 0;
+    int turnos_mas_larga = 0;
+    uint64_t semilla_mas_larga = semilla_base;
+
+    for (int h = 0; h < num_hilos; h++)
+    {
+        trabajador_torneo_t *trabajador = &trabajadores[h];
+        pthread_join(trabajador->hilo, NULL);
+
+        if (trabajador->turnos_partida_mas_larga > turnos_mas_larga)
+        {
+            turnos_mas_larga = trabajador->turnos_partida_mas_larga;
+            semilla_mas_larga = trabajador->semilla_partida_mas_larga;
+        }
+
+        turnos_totales += trabajador->turnos;
+        partidas_por_puntos += trabajador->partidas_por_puntos;
+        for (int i = 0; i < reglas->num_jugadores; i++)
+        {
+            const pcb_t *pcb = &trabajador->contexto.pcbs[i];
+            total[i].partidas_ganadas += pcb->partidas_ganadas;
+            total[i].apeadas_realizadas += pcb->apeadas_realizadas;
+            total[i].embones_realizados += pcb->embones_realizados;
+            total[i].fichas_robadas += pcb->fichas_robadas;
+            total[i].puntos += pcb->puntos;
+            puntos_en_mano[i] += trabajador->puntos_en_mano[i];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+
+    double segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+
+    printf("=== Simulación de %d partidas en %d hilo(s), semilla %llu ===\n", partidas_totales, num_hilos,
+           (unsigned long long)semilla_base);
+    mostrar_reglas(reglas);
+    if (bots_mcts > 0)
+        printf("Jugadores 1-%d: bot MCTS; el resto, jugador automático\n", bots_mcts);
+    printf("Tiempo total: %.3f s (%.1f partidas/s)\n", segundos,
+           segundos > 0 ? partidas_totales / segundos : 0.0);
+    printf("Turnos promedio por partida: %.1f\n", (double)turnos_totales / partidas_totales);
+    printf("Partidas decididas por puntos: %d\n", partidas_por_puntos);
+    printf("Partida más larga: %d turnos (repetir con --simular 1 --semilla %llu)\n", turnos_mas_larga,
+           (unsigned long long)semilla_mas_larga);
+
+    printf("\n%-10s %8s %7s %8s %8s %8s %8s %9s\n", "Jugador", "Ganadas", "%Vict",
+           "Apeadas", "Embones", "Robadas", "Puntos", "PtsMano");
+    for (int i = 0; i < reglas->num_jugadores; i++)
+    {
+        printf("Jugador %-2d %8d %6.1f%% %8d %8d %8d %8d %9.1f\n", i + 1, total[i].partidas_ganadas,
+               100.0 * total[i].partidas_ganadas / partidas_totales, total[i].apeadas_realizadas,
+               total[i].embones_realizados, total[i].fichas_robadas, total[i].puntos,
+               (double)puntos_en_mano[i] / partidas_totales);
+    }
+
+    free(trabajadores);
+    return 0;
+}
+
+// ----------------------------------------------------------------------
+// Jugador automático con búsqueda de Monte Carlo (MCTS)
+// ----------------------------------------------------------------------
+
+// El bot decide su turno con un árbol sobre sus propias acciones: apear
+// (realizar_apeada_optima), embonar una ficha, robar o dar el turno por
+// terminado. Esas acciones dependen solo de su mano y de la mesa, que ve; lo
+// que no ve (las manos rivales y el orden del mazo) se sortea de nuevo en cada
+// simulación (determinización) y el resto de la partida se juega con
+// turno_automatico. Robar termina el turno, así que la ficha sorteada nunca
+// cambia las acciones del árbol.
+//
+// Los hilos de la piscina comparten el árbol, protegido por un mutex que solo
+// se toma para bajar por él y para sumar el resultado: cada hilo toma una
+// iteración tras otra hasta agotar el presupuesto, así ninguno se queda sin
+// trabajo mientras otro tiene. Las visitas cuentan desde que se elige la rama
+// (pérdida virtual) para que los hilos no bajen todos por el mismo camino.
+//
+// Embonar A y luego B deja la misma posición que B y luego A. Además de en su
+// nodo, cada resultado se suma en la tabla de transposición bajo la posición a
+// la que llega la acción (ver mcts_posicion), y UCT usa la media de la posición:
+// las ramas que se transponen comparten lo aprendido.
+
+#define MCTS_MAX_ACCIONES (MAX_FICHAS + 3) // Embonar cada ficha distinta, apear, robar y terminar
+#define MCTS_MAX_NODOS (1 << 16)           // Nodos por búsqueda; con la arena llena solo se simula
+#define MCTS_EXPLORACION 0.7               // Constante de UCT (las recompensas van de 0 a 1)
+
+typedef enum
+{
+    ACCION_APEAR,
+    ACCION_EMBONAR,
+    ACCION_ROBAR,   // Termina el turno
+    ACCION_TERMINAR // Termina el turno sin robar (solo si ya colocó o el mazo está vacío)
+} tipo_accion_mcts_t;
+
+typedef struct
+{
+    tipo_accion_mcts_t tipo;
+    ficha_t ficha; // ACCION_EMBONAR
+} accion_mcts_t;
+
+typedef struct nodo_mcts
+{
+    accion_mcts_t accion;    // Acción que lleva del padre a este nodo
+    struct nodo_mcts *padre;
+    struct nodo_mcts *hijos; // num_hijos seguidos en la arena; NULL: sin expandir
+    int num_hijos;
+    bool fin_de_turno;       // Después de la acción el turno del bot terminó
+    bool expandiendo;        // Un hilo está calculando sus acciones
+    uint32_t visitas;        // Incluye las simulaciones en curso (pérdida virtual)
+    uint32_t terminadas;     // Simulaciones que ya sumaron su resultado
+    double recompensa;       // Suma de las simulaciones terminadas
+    uint64_t posicion;       // Clave en la tabla de transposición de la posición tras la acción
+} nodo_mcts_t;
+
+typedef struct
+{
+    contexto_juego_t estado; // Partida de la simulación en curso
+    contexto_juego_t prueba; // Para probar qué acciones son legales
+    generador_t generador;   // Sorteo de lo que el bot no ve
+    pthread_t hilo;
+} trabajador_mcts_t;
+
+typedef struct
+{
+    pthread_mutex_t mutex;        // Árbol, arena y reparto de búsquedas (hoja)
+    pthread_cond_t cond_busqueda; // Hay búsqueda nueva o hay que detenerse
+    pthread_cond_t cond_fin;      // Un trabajador terminó su parte
+    trabajador_mcts_t *trabajadores;
+    int num_trabajadores;
+    int presupuesto_ms;           // 0: no hay bot
+    bool preparada;               // Las copias tienen memoria para estas reglas
+
+    contexto_juego_t raiz;        // Copia de la partida desde la que se busca
+    int id_bot;
+    bool una_accion;              // FCFS: la primera jugada termina el turno
+    nodo_mcts_t *nodos;           // Arena; nodos[0] es la raíz
+    int num_nodos;
+    struct timespec plazo;
+    uint64_t busqueda;            // Cambia con cada búsqueda nueva
+    int trabajando;               // Trabajadores que siguen en la búsqueda actual
+    uint64_t simulaciones;        // De la búsqueda actual
+    bool detener;
+
+    uint64_t total_busquedas;     // Acumulados para el informe
+    uint64_t total_simulaciones;
+    double total_segundos;
+} piscina_mcts_t;
+
+static piscina_mcts_t piscina_mcts;
+
+// Deja ctx listo para recibir copias de partidas con estas reglas
+static void contexto_preparar_copia(contexto_juego_t *ctx, const reglas_t *reglas)
+{
+    contexto_inicializar(ctx, reglas);
+    ctx->silencioso = true;
+    banco_inicializar(&ctx->banco_apeadas);
+    for (int i = 0; i < reglas->num_jugadores; i++)
+        mano_inicializar(&ctx->jugadores[i].mano, reglas->fichas_iniciales * 2);
+}
+
+// Copia mazo, mesa, jugadores y PCBs sobre un contexto preparado con
+// contexto_preparar_copia, reutilizando su memoria. Colas y planificador no.
+static void contexto_copiar_juego(contexto_juego_t *destino, const contexto_juego_t *origen)
+{
+    destino->mazo = origen->mazo;
+    banco_copiar(&destino->banco_apeadas, &origen->banco_apeadas);
+    memcpy(destino->pcbs, origen->pcbs, sizeof(destino->pcbs));
+
+    for (int i = 0; i < origen->reglas.num_jugadores; i++)
+    {
+        const jugador_t *jugador = &origen->jugadores[i];
+        jugador_t *copia = &destino->jugadores[i];
+
+        copia->contexto = destino;
+        copia->id = jugador->id;
+        copia->puntos_suficientes = jugador->puntos_suficientes;
+        copia->en_juego = jugador->en_juego;
+        copia->ficha_agregada = jugador->ficha_agregada;
+        mano_copiar(&copia->mano, &jugador->mano);
+    }
+}
+
+// Reparte de nuevo lo que el bot no ve: junta las manos rivales con el mazo,
+// las baraja y devuelve a cada rival tantas fichas como tenía (eso sí se ve)
+static void mcts_determinizar(contexto_juego_t *estado, int id_bot, generador_t *generador)
+{
+    mazo_t ocultas = estado->mazo;
+
+    for (int i = 0; i < estado->reglas.num_jugadores; i++)
+    {
+        const mano_t *mano = &estado->jugadores[i].mano;
+        if (i == id_bot - 1)
+            continue;
+        memcpy(&ocultas.fichas[ocultas.cantidad], mano->fichas, sizeof(ficha_t) * mano->cantidad);
+        ocultas.cantidad += mano->cantidad;
+    }
+    barajar_mazo(&ocultas, generador);
+
+    int usadas = 0;
+    for (int i = 0; i < estado->reglas.num_jugadores; i++)
+    {
+        mano_t *mano = &estado->jugadores[i].mano;
+        if (i == id_bot - 1)
+            continue;
+
+        int cantidad = mano->cantidad;
+        mano->cantidad = 0;
+        memset(&mano->bits, 0, sizeof(mano_bits_t));
+        for (int k = 0; k < cantidad; k++)
+            agregar_ficha(mano, ocultas.fichas[usadas++]);
+    }
+    memcpy(estado->mazo.fichas, &ocultas.fichas[usadas], sizeof(ficha_t) * estado->mazo.cantidad);
+}
+
+// Aplica la acción del bot a la partida, con las mismas cuentas de PCB que
+// turno_automatico. Devuelve false si no era legal.
+static bool mcts_aplicar(jugador_t *jugador, const accion_mcts_t *accion)
+{
+    contexto_juego_t *ctx = jugador->contexto;
+    pcb_t *pcb = &ctx->pcbs[jugador->id - 1];
+
+    switch (accion->tipo)
+    {
+    case ACCION_APEAR:
+        if (!puede_hacer_apeada(jugador) || !realizar_apeada_optima(jugador, &ctx->banco_apeadas))
+            return false;
+        pcb->apeadas_realizadas++;
+        break;
+
+    case ACCION_EMBONAR:
+    {
+        // Como turno_automatico, solo se embona después de la primera apeada
+        int indice = encontrar_indice_ficha(&jugador->mano, &accion->ficha);
+        if (!jugador->puntos_suficientes || indice < 0 || !embonar_ficha(jugador, &ctx->banco_apeadas, indice))
+            return false;
+        pcb->embones_realizados++;
+        break;
+    }
+
+    case ACCION_ROBAR:
+    {
+        if (ctx->mazo.cantidad == 0)
+            return false;
+        ficha_t nueva = ctx->mazo.fichas[--ctx->mazo.cantidad];
+        agregar_ficha(&jugador->mano, nueva);
+        bitacora_registrar(ctx, EVENTO_ROBO, jugador->id, nueva, 0);
+        pcb->fichas_robadas++;
+        break;
+    }
+
+    case ACCION_TERMINAR:
+        break;
+    }
+
+    pcb->fichas_en_mano = jugador->mano.cantidad;
+    return true;
+}
+
+static inline bool accion_coloca(const accion_mcts_t *accion)
+{
+    return accion->tipo == ACCION_APEAR || accion->tipo == ACCION_EMBONAR;
+}
+
+// Clave de lo que el bot ve después de una acción: su mano, la mesa, el mazo y
+// cuántas fichas tiene cada rival, si ya colocó en este turno y cómo terminó el
+// turno. estado es la partida tras la acción (antes, si roba o termina).
+static uint64_t mcts_posicion(const contexto_juego_t *estado, int id_bot, bool coloco, bool una_accion,
+                              tipo_accion_mcts_t tipo)
+{
+    uint64_t clave = estado->jugadores[id_bot - 1].mano.bits.zobrist ^ estado->banco_apeadas.zobrist;
+
+    clave ^= zobrist_clave(ZOBRIST_JUEGO | (uint64_t)estado->mazo.cantidad << 8 | (uint64_t)coloco << 1 | una_accion);
+    if (tipo == ACCION_ROBAR || tipo == ACCION_TERMINAR)
+        clave ^= zobrist_clave(ZOBRIST_JUEGO | 1ULL << 24 | tipo);
+    for (int i = 0; i < estado->reglas.num_jugadores; i++)
+    {
+        if (i != id_bot - 1)
+            clave ^= zobrist_clave(ZOBRIST_JUEGO | 2ULL << 24 | (uint64_t)i << 8 | estado->jugadores[i].mano.cantidad);
+    }
+    return clave ^ TT_EVALUACION;
+}
+
+// Acciones legales del bot en estado, sin cambiarlo: apear y embonar se prueban
+// sobre una copia. Las dos copias de una ficha dan la misma acción y van una vez.
+// fin[k] dice si la acción k termina el turno y posiciones[k] adónde lleva.
+static int mcts_acciones(trabajador_mcts_t *trabajador, contexto_juego_t *estado, bool coloco,
+                         accion_mcts_t acciones[], bool fin[], uint64_t posiciones[])
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    jugador_t *bot = &estado->jugadores[piscina->id_bot - 1];
+    jugador_t *bot_prueba = &trabajador->prueba.jugadores[piscina->id_bot - 1];
+    int num = 0;
+
+    if (puede_hacer_apeada(bot))
+    {
+        acciones[num] = (accion_mcts_t){ACCION_APEAR, 0};
+        contexto_copiar_juego(&trabajador->prueba, estado);
+        if (mcts_aplicar(bot_prueba, &acciones[num]))
+        {
+            fin[num] = piscina->una_accion || bot_prueba->mano.cantidad == 0;
+            posiciones[num] = mcts_posicion(&trabajador->prueba, piscina->id_bot, true, piscina->una_accion,
+                                            ACCION_APEAR);
+            num++;
+        }
+    }
+
+    for (int i = 0; bot->puntos_suficientes && i < bot->mano.cantidad; i++)
+    {
+        ficha_t ficha = bot->mano.fichas[i];
+        bool repetida = false;
+        for (int j = 0; j < i && !repetida; j++)
+            repetida = son_fichas_iguales(bot->mano.fichas[j], ficha);
+        if (repetida)
+            continue;
+
+        acciones[num] = (accion_mcts_t){ACCION_EMBONAR, ficha};
+        contexto_copiar_juego(&trabajador->prueba, estado);
+        if (mcts_aplicar(bot_prueba, &acciones[num]))
+        {
+            fin[num] = piscina->una_accion || bot_prueba->mano.cantidad == 0;
+            posiciones[num] = mcts_posicion(&trabajador->prueba, piscina->id_bot, true, piscina->una_accion,
+                                            ACCION_EMBONAR);
+            num++;
+        }
+    }
+
+    if (estado->mazo.cantidad > 0)
+    {
+        fin[num] = true;
+        posiciones[num] = mcts_posicion(estado, piscina->id_bot, coloco, piscina->una_accion, ACCION_ROBAR);
+        acciones[num++] = (accion_mcts_t){ACCION_ROBAR, 0};
+    }
+    if (coloco || estado->mazo.cantidad == 0)
+    {
+        fin[num] = true;
+        posiciones[num] = mcts_posicion(estado, piscina->id_bot, coloco, piscina->una_accion, ACCION_TERMINAR);
+        acciones[num++] = (accion_mcts_t){ACCION_TERMINAR, 0};
+    }
+    return num;
+}
+
+// Raíz cuadrada por Newton y logaritmo aproximado, para no depender de libm:
+// a UCT le basta con unas pocas cifras
+static double mcts_raiz(double x)
+{
+    if (x <= 0)
+        return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 20; i++)
+        r = 0.5 * (r + x / r);
+    return r;
+}
+
+static double mcts_logaritmo(uint32_t n)
+{
+    int exponente = 31 - __builtin_clz(n);
+    double fraccion = (double)(n - (1u << exponente)) / (double)(1u << exponente);
+    return 0.693147 * (exponente + fraccion); // log2 lineal entre potencias de dos
+}
+
+// Media de las simulaciones que pasaron por la posición del nodo, desde
+// cualquier rama; las que siguen en curso en este nodo cuentan como derrotas
+static double mcts_media(const nodo_mcts_t *nodo)
+{
+    uint32_t en_curso = nodo->visitas - nodo->terminadas;
+    uint64_t dato;
+
+    if (tt_buscar(nodo->posicion, &dato) && (dato >> 32) >= nodo->terminadas)
+        return (double)(uint32_t)dato / ((dato >> 32) + en_curso);
+    return nodo->recompensa / nodo->visitas;
+}
+
+// UCT: el hijo sin visitar primero; si no, el de mejor media más exploración
+static nodo_mcts_t *mcts_elegir_hijo(const nodo_mcts_t *nodo)
+{
+    double exploracion = MCTS_EXPLORACION * mcts_raiz(mcts_logaritmo(nodo->visitas));
+    nodo_mcts_t *mejor = NULL;
+    double mejor_valor = -1;
+
+    for (int i = 0; i < nodo->num_hijos; i++)
+    {
+        nodo_mcts_t *hijo = &nodo->hijos[i];
+        if (hijo->visitas == 0)
+            return hijo;
+
+        double valor = mcts_media(hijo) + exploracion / mcts_raiz(hijo->visitas);
+        if (valor > mejor_valor)
+        {
+            mejor_valor = valor;
+            mejor = hijo;
+        }
+    }
+    return mejor;
+}
+
+// Termina el turno del bot si quedó abierto y juega el resto de la partida
+// como simular_partida. Devuelve 1 si gana el bot y 0 si no.
+static double mcts_simular(contexto_juego_t *estado, int id_bot, bool turno_abierto, bool coloco, bool sigue)
+{
+    int num_jugadores = estado->reglas.num_jugadores;
+    int actual = id_bot - 1;
+
+    if (turno_abierto)
+        sigue = turno_automatico_desde(&estado->jugadores[actual], coloco);
+
+    for (int turno = 0; sigue && !jugador_ha_ganado(&estado->jugadores[actual]) && turno < MAX_TURNOS_SIMULACION;
+         turno++)
+    {
+        actual = (actual + 1) % num_jugadores;
+        sigue = turno_automatico(&estado->jugadores[actual]);
+    }
+
+    return determinar_ganador(estado->jugadores, num_jugadores, true) == id_bot - 1 ? 1.0 : 0.0;
+}
+
+// Una iteración: baja por el árbol, expande la hoja, simula con una partida
+// sorteada y suma el resultado en el camino
+static void mcts_iterar(trabajador_mcts_t *trabajador)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    nodo_mcts_t *camino[MCTS_MAX_ACCIONES + 1];
+    int profundidad = 0;
+
+    cerrojo_tomar(&piscina->mutex);
+    nodo_mcts_t *nodo = &piscina->nodos[0];
+    nodo->visitas++;
+    while (nodo->hijos != NULL && !nodo->fin_de_turno)
+    {
+        nodo = mcts_elegir_hijo(nodo);
+        nodo->visitas++;
+        camino[profundidad++] = nodo;
+    }
+    bool expandir = !nodo->fin_de_turno && nodo->hijos == NULL && !nodo->expandiendo;
+    if (expandir)
+        nodo->expandiendo = true;
+    cerrojo_soltar(&piscina->mutex);
+
+    // El camino solo depende de lo que el bot ve: se repite sobre la partida sorteada
+    contexto_juego_t *estado = &trabajador->estado;
+    jugador_t *bot = &estado->jugadores[piscina->id_bot - 1];
+    bool coloco = false;
+
+    contexto_copiar_juego(estado, &piscina->raiz);
+    mcts_determinizar(estado, piscina->id_bot, &trabajador->generador);
+    for (int i = 0; i < profundidad; i++)
+    {
+        mcts_aplicar(bot, &camino[i]->accion);
+        coloco |= accion_coloca(&camino[i]->accion);
+    }
+
+    if (expandir)
+    {
+        accion_mcts_t acciones[MCTS_MAX_ACCIONES];
+        bool fin[MCTS_MAX_ACCIONES];
+        uint64_t posiciones[MCTS_MAX_ACCIONES];
+        int num = mcts_acciones(trabajador, estado, coloco, acciones, fin, posiciones);
+
+        bool expandido = false;
+        cerrojo_tomar(&piscina->mutex);
+        if (piscina->num_nodos + num <= MCTS_MAX_NODOS)
+        {
+            nodo_mcts_t *hijos = &piscina->nodos[piscina->num_nodos];
+            piscina->num_nodos += num;
+            for (int k = 0; k < num; k++)
+                hijos[k] = (nodo_mcts_t){.accion = acciones[k], .padre = nodo, .fin_de_turno = fin[k],
+                                         .posicion = posiciones[k]};
+            nodo->hijos = hijos;
+            nodo->num_hijos = num;
+
+            nodo = &hijos[0];
+            nodo->visitas++;
+            expandido = true;
+        }
+        cerrojo_soltar(&piscina->mutex);
+
+        if (expandido)
+        {
+            mcts_aplicar(bot, &nodo->accion);
+            coloco |= accion_coloca(&nodo->accion);
+        }
+    }
+
+    // Terminar sin haber colocado nada solo es legal con el mazo vacío: la partida se acaba
+    bool sigue = !(nodo->padre != NULL && nodo->accion.tipo == ACCION_TERMINAR && !coloco);
+    double recompensa = mcts_simular(estado, piscina->id_bot, !nodo->fin_de_turno, coloco, sigue);
+
+    // La tabla se lee sin cerrojos, pero solo se escribe aquí, con el del árbol:
+    // ninguna suma se pierde. Dato: visitas en los 32 bits altos, victorias abajo.
+    cerrojo_tomar(&piscina->mutex);
+    for (nodo_mcts_t *n = nodo; n != NULL; n = n->padre)
+    {
+        n->recompensa += recompensa;
+        n->terminadas++;
+        if (n->padre == NULL)
+            continue;
+
+        uint64_t dato = 0;
+        tt_buscar(n->posicion, &dato);
+        tt_guardar(n->posicion, dato + (1ULL << 32) + (uint64_t)recompensa);
+    }
+    piscina->simulaciones++;
+    cerrojo_soltar(&piscina->mutex);
+}
+
+static bool mcts_antes_del_plazo(const struct timespec *plazo)
+{
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return ahora.tv_sec < plazo->tv_sec || (ahora.tv_sec == plazo->tv_sec && ahora.tv_nsec < plazo->tv_nsec);
+}
+
+static void *trabajador_mcts_thread(void *arg)
+{
+    trabajador_mcts_t *trabajador = (trabajador_mcts_t *)arg;
+    piscina_mcts_t *piscina = &piscina_mcts;
+    uint64_t vista = 0;
+
+    cerrojo_tomar(&piscina->mutex);
+    for (;;)
+    {
+        while (piscina->busqueda == vista && !piscina->detener)
+            condicion_esperar(&piscina->cond_busqueda, &piscina->mutex);
+        if (piscina->detener)
+            break;
+        vista = piscina->busqueda;
+        cerrojo_soltar(&piscina->mutex);
+
+        // Al menos una iteración aunque el presupuesto sea mínimo
+        do
+            mcts_iterar(trabajador);
+        while (mcts_antes_del_plazo(&piscina->plazo));
+
+        cerrojo_tomar(&piscina->mutex);
+        if (--piscina->trabajando == 0)
+            pthread_cond_signal(&piscina->cond_fin);
+    }
+    cerrojo_soltar(&piscina->mutex);
+    return NULL;
+}
+
+// Arranca hilos trabajadores que buscan durante presupuesto_ms cada turno del
+// bot. Las copias de la partida se preparan en la primera búsqueda.
+void mcts_iniciar(int presupuesto_ms, int hilos, uint64_t semilla)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+
+    piscina->presupuesto_ms = presupuesto_ms;
+    piscina->num_trabajadores = hilos;
+    piscina->nodos = (nodo_mcts_t *)malloc(sizeof(nodo_mcts_t) * MCTS_MAX_NODOS);
+    piscina->trabajadores = (trabajador_mcts_t *)calloc(hilos, sizeof(trabajador_mcts_t));
+    if (piscina->nodos == NULL || piscina->trabajadores == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para el bot MCTS\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&piscina->mutex, NULL);
+    pthread_cond_init(&piscina->cond_busqueda, NULL);
+    pthread_cond_init(&piscina->cond_fin, NULL);
+    perfil_nombrar_cerrojo(&piscina->mutex, "piscina_mcts");
+
+    for (int i = 0; i < hilos; i++)
+    {
+        trabajador_mcts_t *trabajador = &piscina->trabajadores[i];
+        generador_sembrar(&trabajador->generador, semilla + (uint64_t)i + 1);
+        if (pthread_create(&trabajador->hilo, NULL, trabajador_mcts_thread, trabajador) != 0)
+        {
+            perror("Error creando hilos del bot MCTS");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void mcts_liberar_copia(contexto_juego_t *ctx)
+{
+    banco_liberar(&ctx->banco_apeadas);
+    liberar_jugadores(ctx);
+}
+
+void mcts_detener(void)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    if (piscina->presupuesto_ms == 0)
+        return;
+
+    cerrojo_tomar(&piscina->mutex);
+    piscina->detener = true;
+    pthread_cond_broadcast(&piscina->cond_busqueda);
+    cerrojo_soltar(&piscina->mutex);
+
+    for (int i = 0; i < piscina->num_trabajadores; i++)
+    {
+        pthread_join(piscina->trabajadores[i].hilo, NULL);
+        if (piscina->preparada)
+        {
+            mcts_liberar_copia(&piscina->trabajadores[i].estado);
+            mcts_liberar_copia(&piscina->trabajadores[i].prueba);
+        }
+    }
+    if (piscina->preparada)
+        mcts_liberar_copia(&piscina->raiz);
+
+    pthread_cond_destroy(&piscina->cond_fin);
+    pthread_cond_destroy(&piscina->cond_busqueda);
+    pthread_mutex_destroy(&piscina->mutex);
+    free(piscina->trabajadores);
+    free(piscina->nodos);
+    memset(piscina, 0, sizeof(piscina_mcts_t));
+}
+
+// Copia la partida desde la que buscará el bot (quien llama impide que cambie)
+void mcts_copiar_raiz(const contexto_juego_t *ctx)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+
+    // Los trabajadores solo tocan sus copias durante una búsqueda
+    if (!piscina->preparada)
+    {
+        contexto_preparar_copia(&piscina->raiz, &ctx->reglas);
+        for (int i = 0; i < piscina->num_trabajadores; i++)
+        {
+            contexto_preparar_copia(&piscina->trabajadores[i].estado, &ctx->reglas);
+            contexto_preparar_copia(&piscina->trabajadores[i].prueba, &ctx->reglas);
+        }
+        piscina->preparada = true;
+    }
+    contexto_copiar_juego(&piscina->raiz, ctx);
+}
+
+// Completa un plan que el árbol dejó a medio turno como lo terminan las
+// simulaciones (turno_automatico_desde): apea si puede, embona todo lo que quepa
+// y, si no colocó nada, roba. Solo mira lo que el bot ve; gasta la raíz.
+static int mcts_completar_plan(accion_mcts_t plan[], int num, bool coloco)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    jugador_t *bot = &piscina->raiz.jugadores[piscina->id_bot - 1];
+    accion_mcts_t accion = {ACCION_APEAR, 0};
+
+    for (int i = 0; i < num; i++)
+        mcts_aplicar(bot, &plan[i]);
+
+    if (mcts_aplicar(bot, &accion))
+    {
+        plan[num++] = accion;
+        coloco = true;
+        if (piscina->una_accion)
+            return num;
+    }
+
+    bool embono = bot->puntos_suficientes;
+    while (embono)
+    {
+        embono = false;
+        for (int i = bot->mano.cantidad - 1; i >= 0; i--)
+        {
+            accion = (accion_mcts_t){ACCION_EMBONAR, bot->mano.fichas[i]};
+            if (mcts_aplicar(bot, &accion))
+            {
+                plan[num++] = accion;
+                coloco = embono = true;
+                if (piscina->una_accion)
+                    return num;
+            }
+        }
+    }
+
+    if (bot->mano.cantidad > 0)
+        plan[num++] = (accion_mcts_t){(coloco || piscina->raiz.mazo.cantidad == 0) ? ACCION_TERMINAR : ACCION_ROBAR, 0};
+    return num;
+}
+
+// Busca el turno del bot id_bot desde la raíz copiada durante el presupuesto y
+// deja en plan sus acciones, la última de las cuales termina el turno. Devuelve
+// cuántas son.
+int mcts_buscar(int id_bot, bool una_accion, accion_mcts_t plan[])
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    struct timespec inicio, fin;
+
+    piscina->id_bot = id_bot;
+    piscina->una_accion = una_accion;
+    piscina->nodos[0] = (nodo_mcts_t){.accion = {ACCION_TERMINAR, 0}};
+    piscina->num_nodos = 1;
+    piscina->simulaciones = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    piscina->plazo = plazo_en_ms(piscina->presupuesto_ms);
+
+    cerrojo_tomar(&piscina->mutex);
+    piscina->busqueda++;
+    piscina->trabajando = piscina->num_trabajadores;
+    pthread_cond_broadcast(&piscina->cond_busqueda);
+    while (piscina->trabajando > 0)
+        condicion_esperar(&piscina->cond_fin, &piscina->mutex);
+    cerrojo_soltar(&piscina->mutex);
+
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    piscina->total_busquedas++;
+    piscina->total_simulaciones += piscina->simulaciones;
+    piscina->total_segundos += (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+
+    // La rama más visitada; si se corta antes del fin del turno, lo termina como
+    // lo supusieron las simulaciones
+    int num = 0;
+    bool coloco = false;
+    const nodo_mcts_t *nodo = &piscina->nodos[0];
+    while (nodo->hijos != NULL && !nodo->fin_de_turno)
+    {
+        const nodo_mcts_t *mejor = &nodo->hijos[0];
+        for (int i = 1; i < nodo->num_hijos; i++)
+            if (nodo->hijos[i].visitas > mejor->visitas)
+                mejor = &nodo->hijos[i];
+        plan[num++] = mejor->accion;
+        coloco |= accion_coloca(&mejor->accion);
+        nodo = mejor;
+    }
+    if (!nodo->fin_de_turno)
+        num = mcts_completar_plan(plan, num, coloco);
+    return num;
+}
+
+// Turno del bot en una partida simulada (un solo hilo, sin cerrojos). Devuelve
+// false, como turno_automatico, si no colocó nada y no pudo robar.
+bool turno_mcts(jugador_t *jugador)
+{
+    contexto_juego_t *ctx = jugador->contexto;
+    pcb_t *pcb = &ctx->pcbs[jugador->id - 1];
+    accion_mcts_t plan[MCTS_MAX_ACCIONES];
+    bool coloco = false;
+    bool robo = false;
+
+    mcts_copiar_raiz(ctx);
+    int num = mcts_buscar(jugador->id, false, plan);
+    for (int i = 0; i < num; i++)
+    {
+        if (!mcts_aplicar(jugador, &plan[i]))
+            break;
+        coloco |= accion_coloca(&plan[i]);
+        robo |= plan[i].tipo == ACCION_ROBAR;
+    }
+
+    pcb->turnos_jugados++;
+    pcb->tiempo_total_juego++;
+    return coloco || robo || jugador->mano.cantidad == 0;
+}
+
+// Turno del bot en la partida interactiva: busca sobre una copia de la partida
+// y manda cada acción al turno como si la hubiera tecleado
+void turno_mcts_conducir(turno_t *turno)
+{
+    jugador_t *jugador = turno->jugador;
+    contexto_juego_t *ctx = jugador->contexto;
+    piscina_mcts_t *piscina = &piscina_mcts;
+    accion_mcts_t plan[MCTS_MAX_ACCIONES];
+
+    bloquear_partida();
+    mcts_copiar_raiz(ctx);
+    desbloquear_partida();
+
+    int num = mcts_buscar(jugador->id, turno->modo == 'F', plan);
+    turno_mensaje(turno, "\n[MCTS] %s: %llu simulaciones en %d ms con %d hilos\n", jugador->nombre,
+                  (unsigned long long)piscina->simulaciones, piscina->presupuesto_ms, piscina->num_trabajadores);
+
+    for (int i = 0; i < num && turno->fase != FASE_FIN; i++)
+    {
+        switch (plan[i].tipo)
+        {
+        case ACCION_APEAR:
+            turno_entrada(turno, "2");
+            break;
+
+        case ACCION_EMBONAR:
+        {
+            char linea[16];
+            cerrojo_tomar(&mutex_manos[jugador->id - 1]);
+            int indice = encontrar_indice_ficha(&jugador->mano, &plan[i].ficha);
+            cerrojo_soltar(&mutex_manos[jugador->id - 1]);
+            if (indice < 0)
+                break;
+            snprintf(linea, sizeof(linea), "%d", indice + 1);
+            turno_entrada(turno, "3");
+            turno_entrada(turno, linea);
+            break;
+        }
+
+        case ACCION_ROBAR:
+            turno_entrada(turno, "1");
+            break;
+
+        case ACCION_TERMINAR:
+            turno_ceder(turno);
+            break;
+        }
+    }
+    turno_ceder(turno);
+}
+
+// Simulaciones por segundo de todas las búsquedas del bot
+void mcts_informe(FILE *salida)
+{
+    piscina_mcts_t *piscina = &piscina_mcts;
+    if (piscina->presupuesto_ms == 0 || piscina->total_busquedas == 0)
+        return;
+
+    fprintf(salida, "MCTS: %llu búsquedas de %d ms, %llu simulaciones (%.0f por búsqueda, %.0f simulaciones/s con %d hilos)\n",
+            (unsigned long long)piscina->total_busquedas, piscina->presupuesto_ms,
+            (unsigned long long)piscina->total_simulaciones,
+            (double)piscina->total_simulaciones / piscina->total_busquedas,
+            piscina->total_segundos > 0 ? piscina->total_simulaciones / piscina->total_segundos : 0.0,
+            piscina->num_trabajadores);
+}
+
+// ----------------------------------------------------------------------
+// Bucle de mesas: muchas partidas conducidas por un solo hilo
+// ----------------------------------------------------------------------
+
+// Cada mesa tiene un único evento pendiente: la respuesta de su jugador
+// automático o el fin del plazo del turno, lo que llegue antes. Las mesas están
+// en un montículo ordenado por ese instante; el hilo duerme hasta el primero, lo
+// atiende (turno_entrada o turno_vencer) y vuelve a programar la mesa.
+typedef struct
+{
+    contexto_juego_t contexto;
+    turno_t turno;
+    int jugador;                // Índice del jugador en turno
+    int respuestas;             // Líneas ya enviadas en este turno
+    int turnos;
+    struct timespec respuesta;  // Cuándo contesta el jugador automático
+    struct timespec evento;     // Próximo evento de la mesa (clave del montículo)
+    int posicion;               // Lugar en el montículo (-1: fuera)
+    int clientes[MAX_JUGADORES]; // Servidor: conexión de cada asiento (-1: libre o caída)
+    bool iniciada;              // Servidor: la mesa ya tiene todos sus jugadores
+} mesa_t;
+
+typedef struct
+{
+    mesa_t **mesas;
+    int cantidad;
+} monticulo_mesas_t;
+
+static bool antes_que(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void monticulo_intercambiar(monticulo_mesas_t *monticulo, int i, int j)
+{
+    mesa_t *t = monticulo->mesas[i];
+    monticulo->mesas[i] = monticulo->mesas[j];
+    monticulo->mesas[j] = t;
+    monticulo->mesas[i]->posicion = i;
+    monticulo->mesas[j]->posicion = j;
+}
+
+static void monticulo_subir(monticulo_mesas_t *monticulo, int i)
+{
+    while (i > 0)
+    {
+        int padre = (i - 1) / 2;
+        if (!antes_que(&monticulo->mesas[i]->evento, &monticulo->mesas[padre]->evento))
+            break;
+        monticulo_intercambiar(monticulo, i, padre);
+        i = padre;
+    }
+}
+
+static void monticulo_bajar(monticulo_mesas_t *monticulo, int i)
+{
+    for (;;)
+    {
+        int menor = i;
+        int izq = 2 * i + 1, der = 2 * i + 2;
+        if (izq < monticulo->cantidad && antes_que(&monticulo->mesas[izq]->evento, &monticulo->mesas[menor]->evento))
+            menor = izq;
+        if (der < monticulo->cantidad && antes_que(&monticulo->mesas[der]->evento, &monticulo->mesas[menor]->evento))
+            menor = der;
+        if (menor == i)
+            break;
+        monticulo_intercambiar(monticulo, i, menor);
+        i = menor;
+    }
+}
+
+// El arreglo del montículo debe tener lugar para todas las mesas
+static void monticulo_insertar(monticulo_mesas_t *monticulo, mesa_t *mesa)
+{
+    mesa->posicion = monticulo->cantidad;
+    monticulo->mesas[monticulo->cantidad++] = mesa;
+    monticulo_subir(monticulo, mesa->posicion);
+}
+
+static void monticulo_quitar(monticulo_mesas_t *monticulo, mesa_t *mesa)
+{
+    int i = mesa->posicion;
+    monticulo->cantidad--;
+    if (i != monticulo->cantidad)
+    {
+        monticulo_intercambiar(monticulo, i, monticulo->cantidad);
+        monticulo_subir(monticulo, i);
+        monticulo_bajar(monticulo, monticulo->mesas[i]->posicion);
+    }
+    mesa->posicion = -1;
+}
+
+// Reubica la mesa después de cambiar su evento
+static void monticulo_actualizar(monticulo_mesas_t *monticulo, mesa_t *mesa)
+{
+    monticulo_subir(monticulo, mesa->posicion);
+    monticulo_bajar(monticulo, mesa->posicion);
+}
+
+// Reparte una partida nueva en la mesa y empieza el primer turno
+static void mesa_iniciar(mesa_t *mesa, uint64_t semilla, const reglas_t *reglas)
+{
+    contexto_juego_t *ctx = &mesa->contexto;
+
+    contexto_inicializar(ctx, reglas);
+    ctx->silencioso = true;
+    ctx->semilla = semilla;
+    generador_sembrar(&ctx->generador, semilla);
+    inicializar_mazo(&ctx->mazo, &ctx->reglas);
+    barajar_mazo(&ctx->mazo, &ctx->generador);
+    banco_inicializar(&ctx->banco_apeadas);
+    inicializar_jugadores(ctx);
+
+    mesa->jugador = 0;
+    mesa->respuestas = 0;
+    mesa->turnos = 0;
+    mesa->iniciada = true;
+    turno_iniciar(&mesa->turno, &ctx->jugadores[0]);
+}
+
+// Tras un turno terminado pasa al siguiente jugador. Devuelve true si la
+// partida terminó (o llegó al corte de seguridad).
+static bool mesa_pasar_turno(mesa_t *mesa)
+{
+    contexto_juego_t *ctx = &mesa->contexto;
+
+    mesa->turnos++;
+    if (juego_terminado(ctx) || mesa->turnos >= MAX_TURNOS_SIMULACION)
+        return true;
+
+    mesa->jugador = (mesa->jugador + 1) % ctx->reglas.num_jugadores;
+    mesa->respuestas = 0;
+    turno_iniciar(&mesa->turno, &ctx->jugadores[mesa->jugador]);
+    return false;
+}
+
+// Devuelve el ganador y libera la partida de la mesa
+static int mesa_cerrar(mesa_t *mesa, bool *por_puntos)
+{
+    contexto_juego_t *ctx = &mesa->contexto;
+
+    int ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, true);
+    *por_puntos = !jugador_ha_ganado(&ctx->jugadores[ganador]);
+    banco_liberar(&ctx->banco_apeadas);
+    liberar_jugadores(ctx);
+    return ganador;
+}
+
+// Programa la próxima respuesta del jugador automático y el evento de la mesa
+static void mesa_programar(mesa_t *mesa, generador_t *generador, int espera_max_ms)
+{
+    struct timespec plazo;
+
+    mesa->respuesta = plazo_en_ms((long)generador_rango(generador, (uint32_t)espera_max_ms + 1));
+    mesa->evento = mesa->respuesta;
+    if (turno_plazo(&mesa->turno, &plazo) && antes_que(&plazo, &mesa->evento))
+        mesa->evento = plazo;
+}
+
+// Jugador automático: apea si puede y si no roba; después pasa
+static const char *mesa_respuesta_automatica(mesa_t *mesa)
+{
+    if (mesa->respuestas > 0)
+        return "5";
+    return puede_hacer_apeada(&mesa->contexto.jugadores[mesa->jugador]) ? "2" : "1";
+}
+
+// Juega num_mesas partidas a la vez en el hilo que llama. espera_max_ms es lo que
+// tarda como máximo un jugador automático en contestar cada pregunta.
+int hospedar_mesas(int num_mesas, uint64_t semilla_base, int espera_max_ms, const reglas_t *reglas)
+{
+    mesa_t *mesas = (mesa_t *)calloc(num_mesas, sizeof(mesa_t));
+    monticulo_mesas_t monticulo = {(mesa_t **)malloc(sizeof(mesa_t *) * num_mesas), 0};
+    if (mesas == NULL || monticulo.mesas == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para las mesas\n");
+        exit(EXIT_FAILURE);
+    }
+
+    generador_t generador;
+    generador_sembrar(&generador, semilla_base ^ 0x9E3779B97F4A7C15ull);
+
+    struct timespec inicio, fin;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+    for (int m = 0; m < num_mesas; m++)
+    {
+        mesa_iniciar(&mesas[m], semilla_base + (uint64_t)m, reglas);
+        mesa_programar(&mesas[m], &generador, espera_max_ms);
+        monticulo_insertar(&monticulo, &mesas[m]);
+    }
+
+    long turnos_totales = 0, turnos_vencidos = 0, eventos = 0;
+    long retraso_total_us = 0, retraso_max_us = 0;
+    int partidas_por_puntos = 0;
+    int ganadas[MAX_JUGADORES] = {0};
+
+    while (monticulo.cantidad > 0)
+    {
+        mesa_t *mesa = monticulo.mesas[0];
+        struct timespec ahora;
+
+        // Dormir hasta el evento más próximo de todas las mesas (si no venció ya)
+        clock_gettime(CLOCK_MONOTONIC, &ahora);
+        if (antes_que(&ahora, &mesa->evento))
+        {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &mesa->evento, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &ahora);
+        }
+
+        long retraso_us = (ahora.tv_sec - mesa->evento.tv_sec) * 1000000L + (ahora.tv_nsec - mesa->evento.tv_nsec) / 1000;
+        retraso_total_us += retraso_us;
+        if (retraso_us > retraso_max_us)
+            retraso_max_us = retraso_us;
+        eventos++;
+
+        if (antes_que(&mesa->evento, &mesa->respuesta))
+        {
+            turno_vencer(&mesa->turno);
+            turnos_vencidos++;
+        }
+        else
+        {
+            turno_entrada(&mesa->turno, mesa_respuesta_automatica(mesa));
+            mesa->respuestas++;
+        }
+
+        if (mesa->turno.fase == FASE_FIN)
+        {
+            turnos_totales++;
+            if (mesa_pasar_turno(mesa))
+            {
+                bool por_puntos;
+                ganadas[mesa_cerrar(mesa, &por_puntos)]++;
+                partidas_por_puntos += por_puntos;
+                monticulo_quitar(&monticulo, mesa);
+                continue;
+            }
+        }
+
+        mesa_programar(mesa, &generador, espera_max_ms);
+        monticulo_actualizar(&monticulo, mesa);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+
+    double segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+
+    printf("=== %d mesas en un hilo, semilla %llu, respuestas en 0-%d ms ===\n", num_mesas,
+           (unsigned long long)semilla_base, espera_max_ms);
+    mostrar_reglas(reglas);
+    printf("Tiempo total: %.3f s (%.1f turnos/s, %.1f eventos/s)\n", segundos,
+           segundos > 0 ? turnos_totales / segundos : 0.0, segundos > 0 ? eventos / segundos : 0.0);
+    printf("Turnos promedio por partida: %.1f\n", (double)turnos_totales / num_mesas);
+    printf("Turnos cortados por el quantum: %ld\n", turnos_vencidos);
+    printf("Partidas decididas por puntos: %d\n", partidas_por_puntos);
+    printf("Retraso de los eventos: promedio %.1f us, máximo %.1f ms\n",
+           eventos > 0 ? (double)retraso_total_us / eventos : 0.0, retraso_max_us / 1000.0);
+    for (int i = 0; i < reglas->num_jugadores; i++)
+        printf("Jugador %d: %d victorias (%.1f%%)\n", i + 1, ganadas[i], 100.0 * ganadas[i] / num_mesas);
+
+    free(monticulo.mesas);
+    free(mesas);
+    return 0;
+}
+
+// ----------------------------------------------------------------------
+// Servidor de mesas por socket (epoll) y cliente generador de carga
+// ----------------------------------------------------------------------
+
+// Protocolo de líneas de texto. Cada conexión ocupa un asiento; la mesa empieza
+// cuando se llenan sus asientos (uno por jugador de las reglas del servidor).
+//   servidor -> cliente
+//     ASIENTO <mesa> <jugador>          al conectarse
+//     INICIO                            la mesa está completa
+//     TURNO <plazo_ms> <n> <ficha>...   empieza su turno (fichas como IDs 0-107)
+//     MANO <n> <ficha>...               su mano, tras cada línea que la cambia
+//     MESA <grupos> <escaleras>         respuesta a la 4; sigue una línea por combinación:
+//       GRUPO <n> <ficha>...
+//       ESCALERA <n> <ficha>...
+//     OK <MENU|FICHA|FIN> <fichas> <grupos> <escaleras>   resultado de cada línea
+//                                       (después de sus MANO y MESA)
+//     VENCIDO                           se agotó el quantum
+//     FIN_PARTIDA <ganador>             y el servidor cierra la conexión
+//     ERROR <motivo>
+//   cliente -> servidor: las mismas líneas que el menú del turno (1-5 y, tras la
+//   3, el número de ficha).
+#define MAX_LINEA_PROTOCOLO 512
+
+typedef struct
+{
+    int fd;
+    mesa_t *mesa; // NULL: sin asiento
+    int asiento;
+    int usados;
+    char entrada[MAX_LINEA_PROTOCOLO];
+} conexion_t;
+
+typedef struct
+{
+    int escucha;
+    int epoll;
+    conexion_t **conexiones; // Indexadas por descriptor
+    int capacidad_conexiones;
+    mesa_t *abierta;         // Mesa que se está llenando
+    monticulo_mesas_t monticulo;
+    int capacidad_monticulo;
+    uint64_t semilla_base;
+    reglas_t reglas;         // Las de todas las mesas: fijan los asientos por mesa
+    int mesas_creadas;
+    int mesas_terminadas;
+    int mesas_maximas;       // 0: sin límite
+    long acciones;
+    long turnos;
+    long turnos_vencidos;
+} servidor_t;
+
+// Dirección "PUERTO" (solo dígitos): TCP en 127.0.0.1; cualquier otra: socket Unix
+static bool direccion_es_tcp(const char *direccion)
+{
+    return direccion[0] != '\0' && strspn(direccion, "0123456789") == strlen(direccion);
+}
+
+static socklen_t armar_direccion(const char *direccion, struct sockaddr_storage *destino)
+{
+    memset(destino, 0, sizeof(*destino));
+    if (direccion_es_tcp(direccion))
+    {
+        struct sockaddr_in *tcp = (struct sockaddr_in *)destino;
+        tcp->sin_family = AF_INET;
+        tcp->sin_port = htons((uint16_t)atoi(direccion));
+        tcp->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return sizeof(struct sockaddr_in);
+    }
+
+    struct sockaddr_un *unix_ = (struct sockaddr_un *)destino;
+    if (strlen(direccion) >= sizeof(unix_->sun_path))
+    {
+        fprintf(stderr, "Error: Ruta de socket demasiado larga: %s\n", direccion);
+        exit(EXIT_FAILURE);
+    }
+    unix_->sun_family = AF_UNIX;
+    strcpy(unix_->sun_path, direccion);
+    return sizeof(struct sockaddr_un);
+}
+
+// Sin Nagle: cada respuesta es una línea corta y la latencia importa
+static void configurar_conexion(int fd)
+{
+    int uno = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno)); // Falla (sin daño) en sockets Unix
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Envía una línea completa. Las líneas son cortas: si el búfer del socket está
+// lleno el cliente no está leyendo y se lo trata como desconectado.
+static bool enviar_linea(int fd, const char *formato, ...)
+{
+    char linea[MAX_LINEA_PROTOCOLO];
+    va_list argumentos;
+
+    va_start(argumentos, formato);
+    int largo = vsnprintf(linea, sizeof(linea) - 1, formato, argumentos);
+    va_end(argumentos);
+    if (largo < 0 || largo > (int)sizeof(linea) - 2)
+        largo = (int)sizeof(linea) - 2;
+    linea[largo++] = '\n';
+
+    return send(fd, linea, (size_t)largo, MSG_NOSIGNAL) == largo;
+}
+
+// Envía "<cabecera> <n> <ficha>..." (la mano de un jugador o una combinación)
+static bool enviar_fichas(int fd, const char *cabecera, const ficha_t *fichas, int cantidad)
+{
+    char linea[MAX_LINEA_PROTOCOLO];
+    int largo = snprintf(linea, sizeof(linea), "%s %d", cabecera, cantidad);
+    for (int k = 0; k < cantidad && largo < (int)sizeof(linea) - 5; k++)
+        largo += snprintf(linea + largo, sizeof(linea) - largo, " %d", fichas[k]);
+
+    return enviar_linea(fd, "%s", linea);
+}
+
+// Saca la próxima línea completa del búfer de entrada (sin '\n'). Devuelve false
+// si no hay ninguna.
+static bool extraer_linea(char *entrada, int *usados, char *linea, size_t maximo)
+{
+    char *fin = memchr(entrada, '\n', (size_t)*usados);
+    if (fin == NULL)
+        return false;
+
+    size_t largo = (size_t)(fin - entrada);
+    size_t copiar = largo < maximo - 1 ? largo : maximo - 1;
+    memcpy(linea, entrada, copiar);
+    linea[copiar] = '\0';
+    if (copiar > 0 && linea[copiar - 1] == '\r')
+        linea[copiar - 1] = '\0';
+
+    *usados -= (int)(largo + 1);
+    memmove(entrada, fin + 1, (size_t)*usados);
+    return true;
+}
+
+static void servidor_cerrar_conexion(servidor_t *servidor, conexion_t *conexion);
+
+// Programa el vencimiento del turno en curso de la mesa
+static void servidor_programar_mesa(servidor_t *servidor, mesa_t *mesa)
+{
+    if (!turno_plazo(&mesa->turno, &mesa->evento))
+    {
+        // Sin plazo en esta fase: que no venza nunca
+        clock_gettime(CLOCK_MONOTONIC, &mesa->evento);
+        mesa->evento.tv_sec += 365L * 24 * 3600;
+    }
+
+    if (mesa->posicion < 0)
+        monticulo_insertar(&servidor->monticulo, mesa);
+    else
+        monticulo_actualizar(&servidor->monticulo, mesa);
+}
+
+static void servidor_terminar_mesa(servidor_t *servidor, mesa_t *mesa)
+{
+    bool por_puntos;
+    int ganador = mesa_cerrar(mesa, &por_puntos);
+
+    if (mesa->posicion >= 0)
+        monticulo_quitar(&servidor->monticulo, mesa);
+
+    for (int i = 0; i < servidor->reglas.num_jugadores; i++)
+    {
+        int fd = mesa->clientes[i];
+        if (fd < 0)
+            continue;
+        enviar_linea(fd, "FIN_PARTIDA %d", ganador + 1);
+        conexion_t *conexion = servidor->conexiones[fd];
+        conexion->mesa = NULL;
+        servidor_cerrar_conexion(servidor, conexion);
+    }
+
+    servidor->mesas_terminadas++;
+    free(mesa);
+}
+
+// Avisa al jugador en turno. Los asientos sin conexión pasan solos. Devuelve
+// false si la partida terminó (la mesa ya fue liberada).
+static bool servidor_anunciar_turno(servidor_t *servidor, mesa_t *mesa)
+{
+    for (;;)
+    {
+        int fd = mesa->clientes[mesa->jugador];
+        if (fd >= 0)
+        {
+            const mano_t *mano = &mesa->contexto.jugadores[mesa->jugador].mano;
+            char cabecera[32];
+            snprintf(cabecera, sizeof(cabecera), "TURNO %d", mesa->contexto.quantum * 1000);
+
+            if (enviar_fichas(fd, cabecera, mano->fichas, mano->cantidad))
+            {
+                servidor_programar_mesa(servidor, mesa);
+                return true;
+            }
+
+            // No se cierra aquí (liberaría la mesa a mitad del turno): epoll
+            // informa el cierre y este turno pasa solo
+            shutdown(fd, SHUT_RDWR);
+        }
+
+        turno_cerrar_entrada(&mesa->turno);
+        turno_vencer(&mesa->turno);
+        servidor->turnos++;
+        if (mesa_pasar_turno(mesa))
+        {
+            servidor_terminar_mesa(servidor, mesa);
+            return false;
+        }
+    }
+}
+
+// Después de cada evento del turno: si terminó, pasa al siguiente jugador
+static void servidor_despues_de_evento(servidor_t *servidor, mesa_t *mesa)
+{
+    if (mesa->turno.fase != FASE_FIN)
+    {
+        servidor_programar_mesa(servidor, mesa);
+        return;
+    }
+
+    servidor->turnos++;
+    if (mesa_pasar_turno(mesa))
+    {
+        servidor_terminar_mesa(servidor, mesa);
+        return;
+    }
+    servidor_anunciar_turno(servidor, mesa);
+}
+
+static void servidor_atender_linea(servidor_t *servidor, conexion_t *conexion, const char *linea)
+{
+    mesa_t *mesa = conexion->mesa;
+
+    if (mesa == NULL || !mesa->iniciada)
+    {
+        enviar_linea(conexion->fd, "ERROR esperando jugadores");
+        return;
+    }
+    if (mesa->jugador != conexion->asiento)
+    {
+        enviar_linea(conexion->fd, "ERROR no es tu turno");
+        return;
+    }
+
+    // Sin terminal, lo que turno_entrada mostraría viaja como MANO y MESA
+    const contexto_juego_t *ctx = &mesa->contexto;
+    const mano_t *mano = &ctx->jugadores[conexion->asiento].mano;
+    bool pide_mesa = mesa->turno.fase == FASE_OPCION && atoi(linea) == 4;
+    int cantidad_antes = mano->cantidad;
+    uint64_t zobrist_antes = mano->bits.zobrist;
+
+    turno_entrada(&mesa->turno, linea);
+    servidor->acciones++;
+
+    if (mano->cantidad != cantidad_antes || mano->bits.zobrist != zobrist_antes)
+        enviar_fichas(conexion->fd, "MANO", mano->fichas, mano->cantidad);
+    if (pide_mesa)
+    {
+        const banco_de_apeadas_t *banco = &ctx->banco_apeadas;
+        enviar_linea(conexion->fd, "MESA %d %d", banco->total_grupos, banco->total_escaleras);
+        for (int g = 0; g < banco->total_grupos; g++)
+            enviar_fichas(conexion->fd, "GRUPO", banco->grupos[g].fichas, banco->grupos[g].cantidad);
+        for (int e = 0; e < banco->total_escaleras; e++)
+            enviar_fichas(conexion->fd, "ESCALERA", banco->escaleras[e].fichas, banco->escaleras[e].cantidad);
+    }
+
+    static const char *fases[] = {"MENU", "FICHA", "FIN"};
+    enviar_linea(conexion->fd, "OK %s %d %d %d", fases[mesa->turno.fase], mano->cantidad,
+                 ctx->banco_apeadas.total_grupos, ctx->banco_apeadas.total_escaleras);
+
+    servidor_despues_de_evento(servidor, mesa);
+}
+
+// Sienta la conexión en la mesa abierta; la mesa empieza al llenarse
+static void servidor_sentar(servidor_t *servidor, conexion_t *conexion)
+{
+    if (servidor->abierta == NULL)
+    {
+        if (servidor->mesas_maximas > 0 && servidor->mesas_creadas >= servidor->mesas_maximas)
+        {
+            enviar_linea(conexion->fd, "ERROR servidor lleno");
+            servidor_cerrar_conexion(servidor, conexion);
+            return;
+        }
+
+        mesa_t *mesa = (mesa_t *)calloc(1, sizeof(mesa_t));
+        if (mesa == NULL)
+        {
+            fprintf(stderr, "Error al asignar memoria para la mesa\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < servidor->reglas.num_jugadores; i++)
+            mesa->clientes[i] = -1;
+        mesa->posicion = -1;
+        mesa->contexto.semilla = servidor->semilla_base + (uint64_t)servidor->mesas_creadas++;
+        servidor->abierta = mesa;
+
+        // Cada mesa viva puede estar una vez en el montículo
+        if (servidor->mesas_creadas - servidor->mesas_terminadas > servidor->capacidad_monticulo)
+        {
+            servidor->capacidad_monticulo = servidor->capacidad_monticulo * 2 + 16;
+            servidor->monticulo.mesas = (mesa_t **)realloc(servidor->monticulo.mesas,
+                                                           sizeof(mesa_t *) * servidor->capacidad_monticulo);
+            if (servidor->monticulo.mesas == NULL)
+            {
+                fprintf(stderr, "Error al asignar memoria para las mesas\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    mesa_t *mesa = servidor->abierta;
+    int ocupados = 0;
+    for (int i = 0; i < servidor->reglas.num_jugadores; i++)
+    {
+        if (mesa->clientes[i] < 0 && conexion->mesa == NULL)
+        {
+            mesa->clientes[i] = conexion->fd;
+            conexion->mesa = mesa;
+            conexion->asiento = i;
+        }
+        ocupados += mesa->clientes[i] >= 0;
+    }
+    enviar_linea(conexion->fd, "ASIENTO %d %d", servidor->mesas_creadas, conexion->asiento + 1);
+
+    if (ocupados < servidor->reglas.num_jugadores)
+        return;
+
+    servidor->abierta = NULL;
+    mesa_iniciar(mesa, mesa->contexto.semilla, &servidor->reglas);
+    for (int i = 0; i < servidor->reglas.num_jugadores; i++)
+        enviar_linea(mesa->clientes[i], "INICIO");
+    servidor_anunciar_turno(servidor, mesa);
+}
+
+static void servidor_aceptar(servidor_t *servidor)
+{
+    for (;;)
+    {
+        int fd = accept(servidor->escucha, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("Error aceptando conexión");
+            return;
+        }
+        configurar_conexion(fd);
+
+        if (fd >= servidor->capacidad_conexiones)
+        {
+            int nueva = fd * 2 + 16;
+            servidor->conexiones = (conexion_t **)realloc(servidor->conexiones, sizeof(conexion_t *) * nueva);
+            if (servidor->conexiones == NULL)
+            {
+                fprintf(stderr, "Error al asignar memoria para las conexiones\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(servidor->conexiones + servidor->capacidad_conexiones, 0,
+                   sizeof(conexion_t *) * (nueva - servidor->capacidad_conexiones));
+            servidor->capacidad_conexiones = nueva;
+        }
+
+        conexion_t *conexion = (conexion_t *)calloc(1, sizeof(conexion_t));
+        if (conexion == NULL)
+        {
+            fprintf(stderr, "Error al asignar memoria para la conexión\n");
+            exit(EXIT_FAILURE);
+        }
+        conexion->fd = fd;
+        servidor->conexiones[fd] = conexion;
+
+        struct epoll_event evento = {.events = EPOLLIN, .data.fd = fd};
+        if (epoll_ctl(servidor->epoll, EPOLL_CTL_ADD, fd, &evento) != 0)
+        {
+            perror("Error registrando conexión");
+            exit(EXIT_FAILURE);
+        }
+        servidor_sentar(servidor, conexion);
+    }
+}
+
+// Libera el asiento. Si la mesa queda sin nadie se abandona la partida; si es el
+// turno del que se fue, pasa solo.
+static void servidor_cerrar_conexion(servidor_t *servidor, conexion_t *conexion)
+{
+    int fd = conexion->fd;
+    mesa_t *mesa = conexion->mesa;
 
-    while (!*(control->terminar_flag))
-    {
-        decidir_politica(); // Actualiza la política en cada ciclo
-        pthread_mutex_lock(&mutex);
+    epoll_ctl(servidor->epoll, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    servidor->conexiones[fd] = NULL;
+    free(conexion);
+
+    if (mesa == NULL)
+        return;
 
-        if (proceso_en_ejecucion == -1)
+    int asiento = -1, quedan = 0;
+    for (int i = 0; i < servidor->reglas.num_jugadores; i++)
+    {
+        if (mesa->clientes[i] == fd)
         {
-            int siguiente = siguiente_turno();
-            if (siguiente != -1)
-            {
-                proceso_en_ejecucion = siguiente;
-                jugador_t *jugador = &jugadores[siguiente - 1];
-                
-                // Actualizar PCB al pasar a EJECUTANDO
-                pcbs[siguiente - 1].estado = EJECUTANDO;
-                escribir_pcb(pcbs[siguiente - 1]);
-                
-                printf("\n[PLANIFICADOR] Jugador %d (%s) pasa a EJECUTANDO\n", 
-                       siguiente, jugador->nombre);
-
-                pthread_t hilo_jugador;
-                pthread_create(&hilo_jugador, NULL, jugador_thread, jugador);
-                pthread_detach(hilo_jugador);
-
-                // Esperar a que termine el turno o se agote el quantum
-                struct timespec timeout;
-                clock_gettime(CLOCK_REALTIME, &timeout);
-                timeout.tv_sec += QUANTUM;
-                pthread_cond_timedwait(control->cond, &mutex, &timeout);
-
-                proceso_en_ejecucion = -1;
-
-                // El jugador siempre pasa a DE_ESPERA, independientemente de la política
-                int tiempo_bloqueo = rand() % 30 + 5; // Entre 1-3 segundos
-                printf("\n[PLANIFICADOR] Jugador %d (%s) pasa a DE_ESPERA por %d segundos\n", 
-                       siguiente, jugador->nombre, tiempo_bloqueo);
-                
-                // La función bloquear_jugador se encarga de actualizar el PCB y la tabla
-                bloquear_jugador(siguiente, tiempo_bloqueo);
-                pcbs[siguiente-1].tiempo_total_juego += QUANTUM; //Registra tiempo de juego usado
-
-                verificar_cola_de_esperas(); 
-                // Nota: No agregamos inmediatamente a la cola de listos
-                // El jugador SIEMPRE debe pasar por DE_ESPERA primero
-                // La función verificar_cola_de_esperas se encargará de moverlo 
-                // a la cola de listos una vez que haya cumplido su tiempo de espera
-            }
+            mesa->clientes[i] = -1;
+            asiento = i;
         }
+        quedan += mesa->clientes[i] >= 0;
+    }
 
-        pthread_mutex_unlock(&mutex);
-        nanosleep(&sleep_time, NULL);
+    if (!mesa->iniciada)
+        return; // El asiento queda libre para el próximo que llegue
+
+    if (quedan == 0)
+    {
+        servidor_terminar_mesa(servidor, mesa);
+        return;
+    }
+
+    if (asiento == mesa->jugador)
+    {
+        turno_cerrar_entrada(&mesa->turno);
+        turno_vencer(&mesa->turno);
+        servidor_despues_de_evento(servidor, mesa);
     }
-    return NULL;
 }
 
-// Función para bloquear jugador
-void bloquear_jugador(int id_jugador, int tiempo) {
-    pthread_mutex_lock(&mutex_colas);
-    
-    // Paso 1: Remover de cola_listos si está presente
-    bool encontrado = false;
-    for (int i = 0; i < num_listos; i++) {
-        if (cola_listos[i] == id_jugador) {
-            // Eliminar desplazando elementos
-            for (int j = i; j < num_listos - 1; j++) {
-                cola_listos[j] = cola_listos[j + 1];
-            }
-            num_listos--;
-            encontrado = true;
-            printf("[DEBUG] Jugador %d removido de LISTOS\n", id_jugador);
-            break;
+static void servidor_leer(servidor_t *servidor, conexion_t *conexion)
+{
+    for (;;)
+    {
+        if (conexion->usados == (int)sizeof(conexion->entrada))
+        {
+            enviar_linea(conexion->fd, "ERROR línea demasiado larga");
+            servidor_cerrar_conexion(servidor, conexion);
+            return;
         }
-    }
-    
-    // Paso 2: Verificar si ya está en espera
-    bool ya_en_espera = false;
-    for (int i = 0; i < num_de_esperas; i++) {
-        if (cola_de_esperas[i] == id_jugador) {
-            ya_en_espera = true;
-            pcbs[id_jugador-1].tiempo_de_espera = tiempo;
-            printf("[DEBUG] Jugador %d actualizado en DE_ESPERA: %ds\n", 
-                  id_jugador, tiempo);
-            break;
+
+        ssize_t leidos = read(conexion->fd, conexion->entrada + conexion->usados,
+                              sizeof(conexion->entrada) - conexion->usados);
+        if (leidos == 0 || (leidos < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            servidor_cerrar_conexion(servidor, conexion);
+            return;
+        }
+        if (leidos < 0)
+            return;
+
+        conexion->usados += (int)leidos;
+        int fd = conexion->fd;
+        char linea[MAX_LINEA_PROTOCOLO];
+        while (extraer_linea(conexion->entrada, &conexion->usados, linea, sizeof(linea)))
+        {
+            servidor_atender_linea(servidor, conexion, linea);
+            if (servidor->conexiones[fd] != conexion)
+                return; // Se cerró al terminar la partida
         }
     }
-    
-    // Paso 3: Agregar a espera si no estaba
-    if (!ya_en_espera && num_de_esperas < NUM_JUGADORES) {
-        cola_de_esperas[num_de_esperas++] = id_jugador;
-        pcbs[id_jugador-1].estado = DE_ESPERA;
-        pcbs[id_jugador-1].tiempo_de_espera = tiempo;
-        printf("[DEBUG] Jugador %d -> DE_ESPERA (%ds)\n", 
-              id_jugador, tiempo);
-    }
-    
-    // Actualizaciones comunes
-    escribir_pcb(pcbs[id_jugador-1]);
-    actualizar_tabla_procesos(pcbs, NUM_JUGADORES);
-    
-    pthread_mutex_unlock(&mutex_colas);
 }
 
-// ----------------------------------------------------------------------
-// Función del hilo del jugador
-// ----------------------------------------------------------------------
-
-// Hilo que representa a cada jugador en el juego
-// Cada jugador tiene su propio hilo que ejecuta esta función
-// El jugador espera su turno, realiza acciones y luego pasa el turno
-
-void *jugador_thread(void *arg)
+// Atiende conexiones en dirección (puerto TCP de 127.0.0.1 o ruta de socket Unix)
+// con un solo hilo: epoll para la entrada y el montículo de mesas para los
+// plazos de turno. Con mesas_maximas > 0 termina tras jugar esas mesas.
+int servidor_mesas(const char *direccion, int mesas_maximas, uint64_t semilla_base, const reglas_t *reglas)
 {
-    jugador_t *jugador = (jugador_t *)arg;
-    pcb_t *mi_pcb = &pcbs[jugador->id - 1];
-    struct timespec start, now;
-    bool turno_activo = true;
+    servidor_t servidor = {0};
+    servidor.semilla_base = semilla_base;
+    servidor.reglas = *reglas;
+    servidor.mesas_maximas = mesas_maximas;
 
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct sockaddr_storage dir;
+    socklen_t largo = armar_direccion(direccion, &dir);
+    servidor.escucha = socket(dir.ss_family, SOCK_STREAM, 0);
+    if (servidor.escucha < 0)
+    {
+        perror("Error creando socket");
+        exit(EXIT_FAILURE);
+    }
+    if (dir.ss_family == AF_UNIX)
+        unlink(direccion);
+    int uno = 1;
+    setsockopt(servidor.escucha, SOL_SOCKET, SO_REUSEADDR, &uno, sizeof(uno));
+    if (bind(servidor.escucha, (struct sockaddr *)&dir, largo) != 0 || listen(servidor.escucha, SOMAXCONN) != 0)
+    {
+        perror("Error escuchando en la dirección");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(servidor.escucha, F_SETFL, fcntl(servidor.escucha, F_GETFL, 0) | O_NONBLOCK);
 
-    while (turno_activo && !juego_terminado)
+    servidor.epoll = epoll_create1(0);
+    struct epoll_event evento = {.events = EPOLLIN, .data.fd = servidor.escucha};
+    if (servidor.epoll < 0 || epoll_ctl(servidor.epoll, EPOLL_CTL_ADD, servidor.escucha, &evento) != 0)
     {
-        pthread_mutex_lock(&mutex);
+        perror("Error creando epoll");
+        exit(EXIT_FAILURE);
+    }
 
-        printf("\n=== Turno de %s ===\n", jugador->nombre);
-        mostrar_mano(&jugador->mano);
-        printf("\nOpciones:\n");
-        printf("1. Robar ficha\n2. Hacer apeada\n3. Embonar ficha\n");
-        printf("4. Mostrar banco\n5. Pasar turno\n");
-        printf("\nSeleccione (1-5): ");
-        fflush(stdout);
+    printf("Servidor de mesas escuchando en %s%s\n", direccion_es_tcp(direccion) ? "127.0.0.1:" : "", direccion);
+    fflush(stdout);
 
-        pthread_mutex_unlock(&mutex);
+    struct epoll_event eventos[256];
+    while (mesas_maximas == 0 || servidor.mesas_terminadas < mesas_maximas)
+    {
+        // Esperar entrada solo hasta el próximo vencimiento de turno
+        int espera_ms = -1;
+        if (servidor.monticulo.cantidad > 0)
+        {
+            struct timespec ahora;
+            clock_gettime(CLOCK_MONOTONIC, &ahora);
+            long restante = diferencia_ms(&ahora, &servidor.monticulo.mesas[0]->evento) + 1;
+            espera_ms = restante > 0 ? (int)(restante < INT_MAX ? restante : INT_MAX) : 0;
+        }
 
-        int opcion = -1;
-        char input[10] = {0};
-        bool hizo_accion = false;
+        int n = epoll_wait(servidor.epoll, eventos, 256, espera_ms);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("Error en epoll_wait");
+            exit(EXIT_FAILURE);
+        }
 
-        while (true)
+        for (int k = 0; k < n; k++)
         {
-            struct pollfd mypoll = {STDIN_FILENO, POLLIN, 0};
-            int ret = poll(&mypoll, 1, 200);
+            int fd = eventos[k].data.fd;
+            if (fd == servidor.escucha)
+                servidor_aceptar(&servidor);
+            else if (fd < servidor.capacidad_conexiones && servidor.conexiones[fd] != NULL)
+                servidor_leer(&servidor, servidor.conexiones[fd]);
+        }
 
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            double elapsed = (now.tv_sec - start.tv_sec);
+        // Turnos vencidos
+        struct timespec ahora;
+        clock_gettime(CLOCK_MONOTONIC, &ahora);
+        while (servidor.monticulo.cantidad > 0 && !antes_que(&ahora, &servidor.monticulo.mesas[0]->evento))
+        {
+            mesa_t *mesa = servidor.monticulo.mesas[0];
+            turno_vencer(&mesa->turno);
+            servidor.turnos_vencidos++;
+            if (mesa->clientes[mesa->jugador] >= 0)
+                enviar_linea(mesa->clientes[mesa->jugador], "VENCIDO");
+            servidor_despues_de_evento(&servidor, mesa);
+        }
+    }
 
-            if (elapsed >= QUANTUM)
-            {
-                printf("\n¡Tiempo agotado para %s!\n", jugador->nombre);
-                turno_activo = false;
-                break;
-            }
+    printf("Mesas jugadas: %d, turnos: %ld (%ld vencidos), acciones: %ld\n", servidor.mesas_terminadas,
+           servidor.turnos, servidor.turnos_vencidos, servidor.acciones);
 
-            if (ret > 0 && read(STDIN_FILENO, input, sizeof(input)) > 0)
-            {
-                opcion = atoi(input);
-                break;
-            }
+    close(servidor.epoll);
+    close(servidor.escucha);
+    if (!direccion_es_tcp(direccion))
+        unlink(direccion);
+    free(servidor.monticulo.mesas);
+    free(servidor.conexiones);
+    return 0;
+}
+
+// Conexión del generador de carga: juega su asiento como el jugador automático
+// (intenta apear y pasa) y mide cada acción hasta su respuesta
+typedef struct
+{
+    int fd;
+    int usados;
+    char entrada[MAX_LINEA_PROTOCOLO * 2];
+    struct timespec enviado;
+    bool en_partida;
+    bool terminada;
+} conexion_cliente_t;
+
+static int comparar_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static bool cliente_enviar(conexion_cliente_t *conexion, const char *linea)
+{
+    clock_gettime(CLOCK_MONOTONIC, &conexion->enviado);
+    return enviar_linea(conexion->fd, "%s", linea);
+}
+
+// Abre num_conexiones conexiones (num_conexiones / asientos mesas) contra el
+// servidor y las juega hasta que terminan todas sus partidas. Informa la latencia
+// de las acciones (p50/p99) y cuántas mesas estuvieron en juego a la vez.
+int cliente_carga(const char *direccion, int num_conexiones, int asientos)
+{
+    conexion_cliente_t *conexiones = (conexion_cliente_t *)calloc(num_conexiones, sizeof(conexion_cliente_t));
+    long capacidad_latencias = 1 << 16, num_latencias = 0;
+    long *latencias_ns = (long *)malloc(sizeof(long) * capacidad_latencias);
+    int epoll = epoll_create1(0);
+    if (conexiones == NULL || latencias_ns == NULL || epoll < 0)
+    {
+        fprintf(stderr, "Error al preparar el cliente de carga\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_storage dir;
+    socklen_t largo = armar_direccion(direccion, &dir);
+    for (int i = 0; i < num_conexiones; i++)
+    {
+        int fd = socket(dir.ss_family, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&dir, largo) != 0)
+        {
+            perror("Error conectando con el servidor");
+            exit(EXIT_FAILURE);
         }
+        configurar_conexion(fd);
+        conexiones[i].fd = fd;
 
-        pthread_mutex_lock(&mutex);
+        struct epoll_event evento = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &evento);
+    }
+
+    int abiertas = num_conexiones, en_partida = 0, max_en_partida = 0;
+    long vencidos = 0, errores = 0;
+    struct timespec inicio, fin;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
 
-        switch (opcion)
+    struct epoll_event eventos[256];
+    while (abiertas > 0)
+    {
+        int n = epoll_wait(epoll, eventos, 256, -1);
+        if (n < 0 && errno != EINTR)
         {
-        case 1:
-            if (mazo.cantidad > 0)
-            {
-                ficha_t nueva = mazo.fichas[--mazo.cantidad];
-                agregar_ficha(&jugador->mano, nueva);
-                mostrar_robo_ficha(&nueva, false);
-                jugador->ficha_agregada = true;
-                turno_activo = false;
-                hizo_accion = true;
-                
-                // Actualizar PCB después de robar
-                mi_pcb->fichas_en_mano = jugador->mano.cantidad;
-                mi_pcb->fichas_robadas++;
-            }
-            break;
+            perror("Error en epoll_wait");
+            exit(EXIT_FAILURE);
+        }
 
-        case 2:
-            if (puede_hacer_apeada(jugador))
-            {
-                apeada_t apeada = calcular_mejor_apeada_aux(jugador);
-                if (realizar_apeada_optima(jugador, &banco_apeadas))
-                {
-                    printf("\n¡Apeada exitosa!\n");
-                    mostrar_apeada(&apeada);
-                    hizo_accion = true;
-                    
-                    // Actualizar PCB después de apear
-                    mi_pcb->fichas_en_mano = jugador->mano.cantidad;
-                    mi_pcb->apeadas_realizadas++;
-                    
-                    if (modo == 'F')
-                    {
-                        turno_activo = false;
-                    }
-                }
-                apeada_liberar(&apeada);
-            }
-            else
-            {
-                printf("\nNo tienes combinaciones válidas para apear\n");
-            }
-            break;
+        for (int k = 0; k < n; k++)
+        {
+            conexion_cliente_t *conexion = &conexiones[eventos[k].data.u32];
+            ssize_t leidos = read(conexion->fd, conexion->entrada + conexion->usados,
+                                  sizeof(conexion->entrada) - conexion->usados);
+            if (leidos < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                continue;
 
-        case 3:
-            if (jugador->mano.cantidad > 0)
+            if (leidos > 0)
             {
-                mostrar_mano(&jugador->mano);
-                printf("\nSeleccione ficha (1-%d): ", jugador->mano.cantidad);
-                fflush(stdout);
-
-                struct pollfd ficha_poll = {STDIN_FILENO, POLLIN, 0};
-                char input2[10] = {0};
-                while (true)
+                conexion->usados += (int)leidos;
+                char linea[MAX_LINEA_PROTOCOLO * 2];
+                while (extraer_linea(conexion->entrada, &conexion->usados, linea, sizeof(linea)))
                 {
-                    int ret = poll(&ficha_poll, 1, 200);
-                    clock_gettime(CLOCK_MONOTONIC, &now);
-                    double elapsed = (now.tv_sec - start.tv_sec);
+                    struct timespec ahora;
+                    clock_gettime(CLOCK_MONOTONIC, &ahora);
 
-                    if (modo == 'R' && elapsed >= QUANTUM)
+                    if (strncmp(linea, "INICIO", 6) == 0)
                     {
-                        printf("\n¡Tiempo agotado para %s!\n", jugador->nombre);
-                        turno_activo = false;
-                        break;
+                        conexion->en_partida = true;
+                        if (++en_partida > max_en_partida)
+                            max_en_partida = en_partida;
                     }
-
-                    if (ret > 0 && read(STDIN_FILENO, input2, sizeof(input2)) > 0)
+                    else if (strncmp(linea, "TURNO", 5) == 0)
+                    {
+                        cliente_enviar(conexion, "2"); // Intentar apear
+                    }
+                    else if (strncmp(linea, "OK", 2) == 0)
                     {
-                        int idx = atoi(input2) - 1;
-                        if (idx >= 0 && idx < jugador->mano.cantidad)
+                        long ns = (ahora.tv_sec - conexion->enviado.tv_sec) * 1000000000L +
+                                  (ahora.tv_nsec - conexion->enviado.tv_nsec);
+                        if (num_latencias == capacidad_latencias)
                         {
-                            if (embonar_ficha(jugador, &banco_apeadas, idx))
-                            {
-                                printf("\n¡Ficha embonada con éxito!\n");
-                                hizo_accion = true;
-                                
-                                // Actualizar PCB después de embonar
-                                mi_pcb->fichas_en_mano = jugador->mano.cantidad;
-                                mi_pcb->embones_realizados++;
-                                
-                                if (modo == 'F')
-                                {
-                                    turno_activo = false;
-                                }
-                            }
-                            else
+                            capacidad_latencias *= 2;
+                            latencias_ns = (long *)realloc(latencias_ns, sizeof(long) * capacidad_latencias);
+                            if (latencias_ns == NULL)
                             {
-                                printf("\nNo se pudo embonar la ficha\n");
+                                fprintf(stderr, "Error al asignar memoria para las latencias\n");
+                                exit(EXIT_FAILURE);
                             }
                         }
-                        else
-                        {
-                            printf("\nÍndice inválido\n");
-                        }
-                        break;
+                        latencias_ns[num_latencias++] = ns;
+
+                        if (strncmp(linea, "OK MENU", 7) == 0)
+                            cliente_enviar(conexion, "5"); // Pasar (y robar)
+                        else if (strncmp(linea, "OK FICHA", 8) == 0)
+                            cliente_enviar(conexion, "1");
+                    }
+                    else if (strncmp(linea, "VENCIDO", 7) == 0)
+                    {
+                        vencidos++;
+                    }
+                    else if (strncmp(linea, "FIN_PARTIDA", 11) == 0)
+                    {
+                        conexion->terminada = true;
+                    }
+                    else if (strncmp(linea, "ERROR", 5) == 0)
+                    {
+                        errores++;
                     }
                 }
+                continue;
             }
-            else
-            {
-                printf("\nNo tienes fichas para embonar\n");
-            }
-            break;
 
-        case 4:
-            mostrar_banco(&banco_apeadas);
-            break;
+            // El servidor cerró la conexión (al terminar la partida o por error)
+            if (conexion->en_partida)
+                en_partida--;
+            epoll_ctl(epoll, EPOLL_CTL_DEL, conexion->fd, NULL);
+            close(conexion->fd);
+            abiertas--;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+
+    int terminadas = 0;
+    for (int i = 0; i < num_conexiones; i++)
+        terminadas += conexiones[i].terminada;
+
+    double segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+    qsort(latencias_ns, (size_t)num_latencias, sizeof(long), comparar_long);
+
+    printf("=== Cliente de carga: %d conexiones contra %s ===\n", num_conexiones, direccion);
+    printf("Mesas simultáneas: %d (partidas terminadas: %d)\n", max_en_partida / asientos,
+           terminadas / asientos);
+    printf("Acciones: %ld en %.3f s (%.1f acciones/s)\n", num_latencias, segundos,
+           segundos > 0 ? num_latencias / segundos : 0.0);
+    if (num_latencias > 0)
+        printf("Latencia por acción: p50 %.1f us, p99 %.1f us, máxima %.1f us\n",
+               latencias_ns[num_latencias / 2] / 1000.0, latencias_ns[num_latencias * 99 / 100] / 1000.0,
+               latencias_ns[num_latencias - 1] / 1000.0);
+    printf("Turnos vencidos: %ld, errores: %ld\n", vencidos, errores);
+
+    close(epoll);
+    free(latencias_ns);
+    free(conexiones);
+    return 0;
+}
+
+// ----------------------------------------------------------------------
+// Reproducción de bitácoras
+// ----------------------------------------------------------------------
+
+static const char *nombre_evento(int tipo)
+{
+    static const char *nombres[] = {"?", "PARTIDA", "REPARTO", "ROBO", "APEADA",
+                                    "EMBON", "COMODIN", "ESTADO", "FIN"};
+    return (tipo >= EVENTO_PARTIDA && tipo <= EVENTO_FIN) ? nombres[tipo] : nombres[0];
+}
+
+static void bitacora_discrepancia(size_t indice, const evento_t *evento, const char *detalle)
+{
+    fprintf(stderr, "Error: La bitácora no coincide en el evento %zu (%s, jugador %d, ficha %d): %s\n",
+            indice, nombre_evento(evento->tipo), evento->jugador, evento->ficha, detalle);
+    exit(EXIT_FAILURE);
+}
+
+// Rearma cada partida de la bitácora con su semilla y vuelve a ejecutar sus
+// acciones (apeadas, embones, robos) sin esperas ni E/S, verificando que den el
+// mismo resultado. Sirve para repetir bajo un perfilador los turnos lentos de una
+// partida real; con repeticiones > 1 se recorre la bitácora varias veces.
+int reproducir_bitacora(const char *ruta, int repeticiones)
+{
+    FILE *archivo = fopen(ruta, "rb");
+    if (archivo == NULL)
+    {
+        fprintf(stderr, "Error: No se pudo abrir la bitácora %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    cabecera_bitacora_t cabecera = {0};
+    reglas_t reglas = {0};
+    if (fread(&cabecera, sizeof(cabecera), 1, archivo) == 1)
+        reglas = (reglas_t){(int)cabecera.num_jugadores, cabecera.fichas_iniciales, cabecera.barajas,
+                            cabecera.comodines};
+    if (cabecera.magico != BITACORA_MAGICO || cabecera.version != BITACORA_VERSION ||
+        cabecera.tamano_evento != sizeof(evento_t) || !reglas_validas(&reglas))
+    {
+        fprintf(stderr, "Error: %s no es una bitácora compatible\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+
+    // Toda la bitácora en memoria: la reproducción no hace E/S
+    fseek(archivo, 0, SEEK_END);
+    size_t num_eventos = ((size_t)ftell(archivo) - sizeof(cabecera)) / sizeof(evento_t);
+    fseek(archivo, sizeof(cabecera), SEEK_SET);
+
+    evento_t *eventos = (evento_t *)malloc(num_eventos * sizeof(evento_t) + 1);
+    if (eventos == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para la bitácora\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(eventos, sizeof(evento_t), num_eventos, archivo) != num_eventos)
+    {
+        fprintf(stderr, "Error leyendo la bitácora %s\n", ruta);
+        exit(EXIT_FAILURE);
+    }
+    fclose(archivo);
+
+    static contexto_juego_t contexto;
+    contexto_juego_t *ctx = &contexto;
+    long contadores[EVENTO_FIN + 1] = {0};
+    int partidas = 0;
+    long mas_lento_ns = 0;
+    size_t indice_mas_lento = 0;
+    struct timespec inicio, fin, antes, despues;
+
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (int r = 0; r < repeticiones; r++)
+    {
+        bool en_partida = false;
 
-        case 5:
-            if (mazo.cantidad > 0)
+        for (size_t i = 0; i < num_eventos; i++)
+        {
+            const evento_t *evento = &eventos[i];
+            int tipo = evento->tipo;
+
+            if (tipo < EVENTO_PARTIDA || tipo > EVENTO_FIN)
+                bitacora_discrepancia(i, evento, "tipo de evento desconocido");
+            contadores[tipo]++;
+
+            if (tipo == EVENTO_PARTIDA)
             {
-                ficha_t nueva = mazo.fichas[--mazo.cantidad];
-                agregar_ficha(&jugador->mano, nueva);
-                mostrar_robo_ficha(&nueva, false);
-                
-                // Actualizar PCB al pasar turno
-                mi_pcb->fichas_en_mano = jugador->mano.cantidad;
-                mi_pcb->fichas_robadas++;
-                printf("\nHas pasado el turno y robado una ficha.\n");
+                if (i + 1 >= num_eventos)
+                    bitacora_discrepancia(i, evento, "falta la semilla");
+                if (en_partida)
+                {
+                    banco_liberar(&ctx->banco_apeadas);
+                    liberar_jugadores(ctx);
+                }
+
+                contexto_inicializar(ctx, &reglas);
+                ctx->silencioso = true;
+                memcpy(&ctx->semilla, &eventos[++i], sizeof(ctx->semilla));
+                generador_sembrar(&ctx->generador, ctx->semilla);
+                inicializar_mazo(&ctx->mazo, &ctx->reglas);
+                barajar_mazo(&ctx->mazo, &ctx->generador);
+                banco_inicializar(&ctx->banco_apeadas);
+                inicializar_jugadores(ctx);
+                en_partida = true;
+                partidas++;
+                continue;
             }
-            else
+
+            if (!en_partida)
+                bitacora_discrepancia(i, evento, "evento fuera de una partida");
+            if (tipo != EVENTO_FIN && (evento->jugador < 1 || evento->jugador > reglas.num_jugadores))
+                bitacora_discrepancia(i, evento, "jugador inválido");
+
+            jugador_t *jugador = &ctx->jugadores[evento->jugador > 0 ? evento->jugador - 1 : 0];
+            ficha_t ficha = evento->ficha;
+
+            clock_gettime(CLOCK_MONOTONIC, &antes);
+            switch (tipo)
             {
-                printf("\nNo se puede robar una ficha: el mazo está vacío.\n");
-            }
-        
-            turno_activo = false;
-            hizo_accion = true;
-            break;
+            case EVENTO_REPARTO:
+                if (encontrar_indice_ficha(&jugador->mano, &ficha) < 0)
+                    bitacora_discrepancia(i, evento, "la ficha no se repartió con esta semilla");
+                break;
 
-        default:
-            if (opcion != -1)
+            case EVENTO_ROBO:
+                if (ctx->mazo.cantidad == 0 || ctx->mazo.fichas[ctx->mazo.cantidad - 1] != ficha)
+                    bitacora_discrepancia(i, evento, "el mazo no tiene esa ficha arriba");
+                agregar_ficha(&jugador->mano, ctx->mazo.fichas[--ctx->mazo.cantidad]);
+                break;
+
+            case EVENTO_APEADA:
             {
-                printf("\nOpción inválida. Por favor seleccione 1-5\n");
+                int fichas_antes = jugador->mano.cantidad;
+                realizar_apeada_optima(jugador, &ctx->banco_apeadas);
+                if (fichas_antes - jugador->mano.cantidad != ficha)
+                    bitacora_discrepancia(i, evento, "la apeada colocó otras fichas");
+                break;
             }
-            break;
-        }
-
-        pthread_mutex_unlock(&mutex);
 
-        // Si hubo acción, actualizar PCB y tabla
-        if (hizo_accion)
-        {
-            actualizar_y_escribir_pcb(mi_pcb, jugador);
-            actualizar_tabla_procesos(pcbs, NUM_JUGADORES);
-        }
+            case EVENTO_EMBON:
+                if (!embonar_ficha(jugador, &ctx->banco_apeadas, encontrar_indice_ficha(&jugador->mano, &ficha)))
+                    bitacora_discrepancia(i, evento, "la ficha no se pudo embonar");
+                break;
 
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        double elapsed = (now.tv_sec - start.tv_sec);
-        if (elapsed >= QUANTUM)
-        {
-            printf("\n¡Quantum completado para %s!\n", jugador->nombre);
-            turno_activo = false;
-        }
+            case EVENTO_COMODIN:
+                // Si le sigue el embón de la misma ficha, embonar_ficha repite el
+                // movimiento; si no, el embón falló y el comodín quedó movido
+                if (i + 1 < num_eventos && eventos[i + 1].tipo == EVENTO_EMBON &&
+                    eventos[i + 1].jugador == evento->jugador && eventos[i + 1].ficha == ficha)
+                    break;
+                if (!mover_comodin_para_embonar(&ctx->banco_apeadas, &ficha))
+                    bitacora_discrepancia(i, evento, "no había comodín que mover");
+                break;
 
-        jugador->tiempo_restante = QUANTUM - (int)elapsed;
+            case EVENTO_ESTADO:
+                ctx->pcbs[evento->jugador - 1].estado = (estado_jugador)evento->dato;
+                break;
 
-        if (!turno_activo)
-        {
-            printf("\n=== Fin de turno de %s ===\n", jugador->nombre);
-            
-            // No es necesario actualizar el estado aquí, el planificador lo hará
-            // al finalizar el turno del jugador
-        }
+            case EVENTO_FIN:
+            {
+                int ganador = determinar_ganador(ctx->jugadores, reglas.num_jugadores, evento->dato != 0);
+                if (evento->jugador != 0 && ganador + 1 != evento->jugador)
+                    bitacora_discrepancia(i, evento, "el ganador es otro");
+                break;
+            }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &despues);
 
-        // Verificar condiciones de victoria
-        if (jugador->mano.cantidad == 0)
-        {
-            printf("\n¡%s se ha quedado sin fichas y gana el juego!\n", jugador->nombre);
-            juego_terminado = true;
-            return NULL;
+            long ns = (despues.tv_sec - antes.tv_sec) * 1000000000L + (despues.tv_nsec - antes.tv_nsec);
+            if (ns > mas_lento_ns)
+            {
+                mas_lento_ns = ns;
+                indice_mas_lento = i;
+            }
         }
 
-        if (mazo.cantidad == 0)
+        if (en_partida)
         {
-            printf("\n¡El mazo se ha agotado!\n");
-            int ganador = determinar_ganador(jugadores, NUM_JUGADORES, true);
-            printf("\n¡Jugador %d (%s) ha ganado!\n", jugadores[ganador].id, jugadores[ganador].nombre);
-            juego_terminado = true;
-            return NULL;
+            banco_liberar(&ctx->banco_apeadas);
+            liberar_jugadores(ctx);
         }
     }
+    clock_gettime(CLOCK_MONOTONIC, &fin);
 
-    return NULL;
-}
+    double segundos = (fin.tv_sec - inicio.tv_sec) + (fin.tv_nsec - inicio.tv_nsec) / 1e9;
+    long total = 0;
+    for (int t = EVENTO_PARTIDA; t <= EVENTO_FIN; t++)
+        total += contadores[t];
 
-// Función para agregar a cola de listos
-void agregar_a_cola_listos(int id_jugador) {
-    pthread_mutex_lock(&mutex_colas);
-    
-    // Verificar capacidad máxima de la cola
-    if ((final + 1) % NUM_JUGADORES == frente) {
-        printf("[ERROR] Cola de listos llena (Jugador %d)\n", id_jugador);
-        pthread_mutex_unlock(&mutex_colas);
-        return;
-    }
-    
-    // Verificar si ya está en cola
-    for (int i = frente; i != final; i = (i+1) % NUM_JUGADORES) {
-        if (cola_listos[i] == id_jugador) {
-            printf("[WARN] Jugador %d ya en LISTOS\n", id_jugador);
-            pthread_mutex_unlock(&mutex_colas);
-            return;
-        }
-    }
-    
-    // Agregar a cola
-    cola_listos[final] = id_jugador;
-    final = (final + 1) % NUM_JUGADORES;
-    
-    // Actualizar PCB
-    pcbs[id_jugador-1].estado = LISTO;
-    escribir_pcb(pcbs[id_jugador-1]);
-    
-    printf("[DEBUG] Jugador %d agregado a LISTOS\n", id_jugador);
-    
-    pthread_mutex_unlock(&mutex_colas);
+    printf("=== Reproducción de %s (%d vez/veces) ===\n", ruta, repeticiones);
+    printf("Partidas: %d, eventos: %ld, tiempo: %.3f s (%.0f eventos/s)\n", partidas, total, segundos,
+           segundos > 0 ? total / segundos : 0.0);
+    for (int t = EVENTO_PARTIDA; t <= EVENTO_FIN; t++)
+        printf("  %-8s %10ld\n", nombre_evento(t), contadores[t]);
+    if (total > 0)
+        printf("Evento más lento: #%zu (%s, jugador %d) %.1f us, a los %.3f s de la partida original\n",
+               indice_mas_lento, nombre_evento(eventos[indice_mas_lento].tipo), eventos[indice_mas_lento].jugador,
+               mas_lento_ns / 1000.0, eventos[indice_mas_lento].tiempo_us / 1e6);
+
+    free(eventos);
+    return 0;
 }
 
+// ----------------------------------------------------------------------
+// Benchmark de los núcleos de apeada y embón
+// ----------------------------------------------------------------------
+// Manos de 14, 30 y 50 fichas y una mesa vacía o llena, al azar pero repetibles
+// (dependen solo de la semilla). Las funciones baratas tardan menos que leer el
+// reloj: se cronometran en lotes de BENCHMARK_LOTE llamadas y cada muestra es
+// el promedio del lote. Las que cambian la mano o la mesa se miden de a una y
+// se restauran fuera del tiempo medido. Al tiempo de cada muestra se le resta
+// lo que cuesta leer el reloj. La salida es CSV, una fila por caso.
+#define BENCHMARK_SEMILLA 20240601ull
+#define BENCHMARK_LOTE 64
+#define BENCHMARK_FICHAS_MESA 54       // Fichas con las que se arma la mesa llena
+#define BENCHMARK_MAX_CANDIDATOS 256   // Secuencias para es_escalera_valida
 
-// Función para inicializar PCBs
-void inicializar_pcbs()
+typedef struct
 {
-    for (int i = 0; i < NUM_JUGADORES; i++)
-    {
-        // Identificación básica
-        pcbs[i].id_jugador = i + 1;
-        snprintf(pcbs[i].nombre, sizeof(pcbs[i].nombre), "Jugador %d", i + 1);
-
-        // Estado del proceso/jugador
-        pcbs[i].estado = LISTO;       // Estado inicial (LISTO, EJECUTANDO, DE_ESPERA)
-        pcbs[i].tiempo_de_espera = 0; // Tiempo restante de bloqueo
-
-        // Estadísticas del juego
-        pcbs[i].fichas_en_mano = FICHAS_INICIALES;
-        pcbs[i].puntos = 0;
-        pcbs[i].partidas_jugadas = 0;
-        pcbs[i].partidas_ganadas = 0;
-        pcbs[i].partidas_perdidas = 0;
-
-        // Tiempos y contadores
-        pcbs[i].tiempo_total_juego = 0;
-        pcbs[i].turnos_jugados = 0;
-        pcbs[i].tiempo_restante = QUANTUM;
-
-        // Acciones del juego
-        pcbs[i].fichas_robadas = 0;
-        pcbs[i].fichas_desfichadas = 0;
-        pcbs[i].grupos_formados = 0;
-        pcbs[i].escaleras_formadas = 0;
-        pcbs[i].apeadas_realizadas = 0;
-        pcbs[i].embones_realizados = 0;
-        pcbs[i].victorias_con_escalera = 0;
-
-        // Agregar a la cola de listos inicial
-        agregar_a_cola_listos(pcbs[i].id_jugador);
-    }
-}
+    ficha_t fichas[MAX_FICHAS_ESCALERA];
+    int cantidad;
+} candidato_escalera_t;
 
-// Hilo que verifica jugadores de_esperas periódicamente
-void *verificar_de_esperas(void *arg)
+typedef struct
 {
-    hilo_control_t *control = (hilo_control_t *)arg;
-    struct timespec sleep_time = {0, 100000000}; // 100ms
+    contexto_juego_t contexto;     // jugadores[0] tiene la mano del caso; banco_apeadas, la mesa
+    mano_t mano_original;          // Para restaurar tras una llamada que cambia la mano
+    banco_de_apeadas_t mesa_llena; // Mesa llena sin tocar (la vacía no cambia)
+    const char *nombre_mesa;
+    candidato_escalera_t candidatos[BENCHMARK_MAX_CANDIDATOS];
+    int num_candidatos;
+} caso_benchmark_t;
 
-    while (1)
-    {
-        pthread_mutex_lock(control->mutex);
-        if (*(control->terminar_flag))
-        {
-            pthread_mutex_unlock(control->mutex);
-            break;
-        }
-        pthread_mutex_unlock(control->mutex);
+typedef struct
+{
+    const char *nombre;
+    void (*medir)(caso_benchmark_t *caso, int i);
+    bool modifica;  // Cambia la mano o la mesa: se restaura antes de cada llamada
+    bool usa_mesa;  // Se mide con la mesa vacía y con la llena
+} nucleo_benchmark_t;
 
-        pthread_mutex_lock(&mutex);
-        verificar_cola_de_esperas();
-        pthread_mutex_unlock(&mutex);
+static volatile long benchmark_sumidero; // Evita que el compilador descarte las llamadas
 
-        // Usar nanosleep en lugar de usleep
-        nanosleep(&sleep_time, NULL);
-    }
+static void medir_puede_hacer_apeada(caso_benchmark_t *caso, int i)
+{
+    (void)i;
+    benchmark_sumidero += puede_hacer_apeada(&caso->contexto.jugadores[0]);
+}
 
-    return NULL;
+static void medir_calcular_mejor_apeada(caso_benchmark_t *caso, int i)
+{
+    (void)i;
+    apeada_t apeada = calcular_mejor_apeada_aux(&caso->contexto.jugadores[0]);
+    benchmark_sumidero += apeada.total_grupos + apeada.total_escaleras;
 }
 
-// Función para obtener el siguiente jugador en la cola de listos
-int siguiente_turno()
+static void medir_crear_mejor_apeada(caso_benchmark_t *caso, int i)
 {
-    int id = -1;
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec += 1;
+    (void)i;
+    apeada_t apeada = crear_mejor_apeada(&caso->contexto.jugadores[0]);
+    benchmark_sumidero += apeada.total_grupos + apeada.total_escaleras;
+}
 
-    // Usar trylock para evitar bloqueos
-    if (pthread_mutex_trylock(&mutex) == 0)
-    {
-        if (num_listos > 0)
-        {
-            id = cola_listos[frente];
-            frente = (frente + 1) % NUM_JUGADORES;
-            num_listos--;
-        }
-        pthread_mutex_unlock(&mutex);
-    }
+static void medir_es_escalera_valida(caso_benchmark_t *caso, int i)
+{
+    const candidato_escalera_t *candidato = &caso->candidatos[i % caso->num_candidatos];
+    benchmark_sumidero += es_escalera_valida(candidato->fichas, candidato->cantidad);
+}
 
-    return id;
+static void medir_existe_embon_posible(caso_benchmark_t *caso, int i)
+{
+    (void)i;
+    benchmark_sumidero += existe_embon_posible_aux(&caso->contexto.jugadores[0], &caso->contexto.banco_apeadas);
 }
 
-void reiniciar_cola_listos()
+static void medir_mover_comodin(caso_benchmark_t *caso, int i)
 {
-    pthread_mutex_lock(&mutex);
+    const mano_t *mano = &caso->contexto.jugadores[0].mano;
+    ficha_t ficha = mano->fichas[i % mano->cantidad];
+    benchmark_sumidero += mover_comodin_para_embonar(&caso->contexto.banco_apeadas, &ficha);
+}
 
-    frente = 0;
-    final = 0;
-    num_listos = 0;
+static const nucleo_benchmark_t nucleos_benchmark[] = {
+    {"puede_hacer_apeada", medir_puede_hacer_apeada, false, false},
+    {"calcular_mejor_apeada_aux", medir_calcular_mejor_apeada, false, false},
+    {"crear_mejor_apeada", medir_crear_mejor_apeada, true, false},
+    {"es_escalera_valida", medir_es_escalera_valida, false, false},
+    {"existe_embon_posible_aux", medir_existe_embon_posible, false, true},
+    {"mover_comodin_para_embonar", medir_mover_comodin, true, true},
+};
 
-    for (int i = 0; i < NUM_JUGADORES; i++)
-    {
-        if (jugadores[i].en_juego)
-        {
-            cola_listos[final] = jugadores[i].id;
-            final = (final + 1) % NUM_JUGADORES;
-            num_listos++;
-            pcbs[i].estado = LISTO; // Añadir esta línea
-        }
-    }
+static void benchmark_restaurar(caso_benchmark_t *caso, bool mesa_llena)
+{
+    mano_t *mano = &caso->contexto.jugadores[0].mano;
+    memcpy(mano->fichas, caso->mano_original.fichas, sizeof(ficha_t) * caso->mano_original.cantidad);
+    mano->cantidad = caso->mano_original.cantidad;
+    mano->bits = caso->mano_original.bits;
 
-    pthread_mutex_unlock(&mutex);
-    pthread_cond_signal(&cond_turno); // Notificar al planificador
+    if (mesa_llena)
+        banco_copiar(&caso->contexto.banco_apeadas, &caso->mesa_llena);
 }
 
-void mover_a_cola_de_esperas(int id_jugador)
+// Mano de num_fichas fichas y mesa llena armada con la mejor apeada de otras
+// BENCHMARK_FICHAS_MESA fichas del mismo mazo. Candidatos para es_escalera_valida:
+// las escaleras de esa mesa (válidas) y tramos de la mano (casi nunca válidos).
+static void benchmark_preparar(caso_benchmark_t *caso, int num_fichas, uint64_t semilla)
 {
-    // Bloquear el jugador en su PCB
-    pcbs[id_jugador - 1].estado = DE_ESPERA;
-    pcbs[id_jugador - 1].tiempo_de_espera = rand() % 10 + 1;
+    static const reglas_t reglas = REGLAS_ESTANDAR;
+    contexto_juego_t *ctx = &caso->contexto;
+
+    contexto_inicializar(ctx, &reglas);
+    ctx->silencioso = true;
+    generador_sembrar(&ctx->generador, semilla);
+    inicializar_mazo(&ctx->mazo, &ctx->reglas);
+    barajar_mazo(&ctx->mazo, &ctx->generador);
+
+    mano_t fichas_mesa;
+    mano_inicializar(&fichas_mesa, BENCHMARK_FICHAS_MESA);
+    for (int i = 0; i < BENCHMARK_FICHAS_MESA; i++)
+        agregar_ficha(&fichas_mesa, ctx->mazo.fichas[--ctx->mazo.cantidad]);
+
+    apeada_t apeada;
+    apeada_inicializar(&apeada);
+    resolver_mejor_apeada(&fichas_mesa, &apeada, NULL);
+    mano_liberar(&fichas_mesa);
 
-    // Agregar a la cola de de_esperas
-    if (num_de_esperas < NUM_JUGADORES)
+    banco_inicializar(&caso->mesa_llena);
+    banco_reservar(&caso->mesa_llena, apeada.total_grupos, apeada.total_escaleras);
+    for (int g = 0; g < apeada.total_grupos; g++)
     {
-        cola_de_esperas[num_de_esperas++] = id_jugador;
+        caso->mesa_llena.grupos[caso->mesa_llena.total_grupos++] = apeada.grupos[g];
+        indice_actualizar_grupo(&caso->mesa_llena, g);
+    }
+    for (int e = 0; e < apeada.total_escaleras; e++)
+    {
+        caso->mesa_llena.escaleras[caso->mesa_llena.total_escaleras++] = apeada.escaleras[e];
+        indice_actualizar_escalera(&caso->mesa_llena, e);
     }
 
-    printf("\nJugador %d de_espera por %d segundos\n", id_jugador, pcbs[id_jugador - 1].tiempo_de_espera);
-}
+    jugador_t *jugador = &ctx->jugadores[0];
+    jugador->contexto = ctx;
+    jugador->id = 1;
+    jugador->en_juego = true;
+    jugador->puntos_suficientes = true; // Sin el mínimo de la primera apeada: se mide el caso completo
+    mano_inicializar(&jugador->mano, num_fichas);
+    mano_inicializar(&caso->mano_original, num_fichas);
+    for (int i = 0; i < num_fichas; i++)
+    {
+        ficha_t ficha = ctx->mazo.fichas[--ctx->mazo.cantidad];
+        agregar_ficha(&jugador->mano, ficha);
+        agregar_ficha(&caso->mano_original, ficha);
+    }
 
-void verificar_cola_de_esperas() {
-    pthread_mutex_lock(&mutex_colas);
-    
-    for (int i = 0; i < num_de_esperas; i++) {
-        int id = cola_de_esperas[i];
-        
-        // Reducir tiempo y verificar
-        if (--pcbs[id-1].tiempo_de_espera <= 0) {
-            // Paso 1: Mover a listos (con verificación)
-            bool agregado = false;
-            for (int j = 0; j < num_listos; j++) {
-                if (cola_listos[j] == id) {
-                    agregado = true;
-                    break;
-                }
-            }
-            
-            if (!agregado && num_listos < NUM_JUGADORES) {
-                cola_listos[num_listos++] = id;
-                pcbs[id-1].estado = LISTO;
-                printf("[DEBUG] Jugador %d -> LISTO\n", id);
-            }
-            
-            // Paso 2: Eliminar de esperas
-            for (int j = i; j < num_de_esperas-1; j++) {
-                cola_de_esperas[j] = cola_de_esperas[j+1];
-            }
-            num_de_esperas--;
-            i--;  // Ajustar índice
-            
-            // Paso 3: Actualizar registros
-            escribir_pcb(pcbs[id-1]);
-        }
+    caso->num_candidatos = 0;
+    for (int e = 0; e < apeada.total_escaleras && caso->num_candidatos < BENCHMARK_MAX_CANDIDATOS / 2; e++)
+    {
+        candidato_escalera_t *candidato = &caso->candidatos[caso->num_candidatos++];
+        candidato->cantidad = apeada.escaleras[e].cantidad;
+        memcpy(candidato->fichas, apeada.escaleras[e].fichas, sizeof(ficha_t) * candidato->cantidad);
+    }
+    int validas = caso->num_candidatos;
+    for (int k = 0; k < (validas > 0 ? validas : BENCHMARK_MAX_CANDIDATOS / 2); k++)
+    {
+        candidato_escalera_t *candidato = &caso->candidatos[caso->num_candidatos++];
+        int largo = MIN_FICHAS_ESCALERA + (int)generador_rango(&ctx->generador, MAX_FICHAS_ESCALERA - MIN_FICHAS_ESCALERA + 1);
+        if (largo > num_fichas)
+            largo = num_fichas;
+        int inicio = (int)generador_rango(&ctx->generador, (uint32_t)(num_fichas - largo + 1));
+        candidato->cantidad = largo;
+        memcpy(candidato->fichas, &caso->mano_original.fichas[inicio], sizeof(ficha_t) * largo);
     }
-    
-    pthread_mutex_unlock(&mutex_colas);
-    actualizar_tabla_procesos(pcbs, NUM_JUGADORES);
 }
 
-
-void iniciar_concurrencia()
+static void benchmark_liberar(caso_benchmark_t *caso)
 {
-    pthread_t hilos[NUM_JUGADORES];
+    banco_liberar(&caso->contexto.banco_apeadas);
+    banco_liberar(&caso->mesa_llena);
+    mano_liberar(&caso->contexto.jugadores[0].mano);
+    mano_liberar(&caso->mano_original);
+}
 
-    // Crear un hilo para cada jugador
-    for (int i = 0; i < NUM_JUGADORES; i++)
-    {
-        pthread_create(&hilos[i], NULL, jugador_thread, (void *)&jugadores[i]);
-    }
+static long benchmark_ns(const struct timespec *antes, const struct timespec *despues)
+{
+    return (despues->tv_sec - antes->tv_sec) * 1000000000L + (despues->tv_nsec - antes->tv_nsec);
+}
 
-    // Esperar a que todos los hilos terminen
-    for (int i = 0; i < NUM_JUGADORES; i++)
+// Lo menos que tarda un par de lecturas del reloj: se descuenta de cada muestra
+static long benchmark_costo_reloj(void)
+{
+    long minimo = LONG_MAX;
+    for (int i = 0; i < 1000; i++)
     {
-        pthread_join(hilos[i], NULL);
+        struct timespec antes, despues;
+        clock_gettime(CLOCK_MONOTONIC, &antes);
+        clock_gettime(CLOCK_MONOTONIC, &despues);
+        long ns = benchmark_ns(&antes, &despues);
+        if (ns < minimo)
+            minimo = ns;
     }
+    return minimo;
 }
 
-// ----------------------------------------------------------------------
-// Funciones para Algoritmos de Planificación (FCFS y Round Robin)
-// ----------------------------------------------------------------------
-
-// Función para capturar teclas sin bloqueo
-int kbhit()
+// Mide un núcleo sobre un caso e imprime su fila CSV
+static void benchmark_medir(caso_benchmark_t *caso, const nucleo_benchmark_t *nucleo, int num_fichas, bool mesa_llena,
+                            int operaciones, long costo_reloj, long *muestras)
 {
-    struct termios oldt, newt;
-    int ch, oldf;
+    int lote = nucleo->modifica ? 1 : BENCHMARK_LOTE;
+    int num_muestras = (operaciones + lote - 1) / lote;
+
+    // Calentar cachés y el predictor antes de medir
+    for (int i = 0; i < lote; i++)
+    {
+        benchmark_restaurar(caso, mesa_llena);
+        nucleo->medir(caso, i);
+    }
+    benchmark_restaurar(caso, mesa_llena);
+
+    uint64_t asignaciones_antes = asignaciones_hilo;
+    long total_ns = 0;
+    int i = 0;
+    for (int m = 0; m < num_muestras; m++)
+    {
+        struct timespec antes, despues;
+        if (nucleo->modifica)
+            benchmark_restaurar(caso, mesa_llena);
+
+        clock_gettime(CLOCK_MONOTONIC, &antes);
+        for (int k = 0; k < lote; k++)
+            nucleo->medir(caso, i++);
+        clock_gettime(CLOCK_MONOTONIC, &despues);
+
+        long ns = benchmark_ns(&antes, &despues) - costo_reloj;
+        if (ns < 0)
+            ns = 0;
+        total_ns += ns;
+        muestras[m] = ns / lote;
+    }
+    uint64_t asignaciones = asignaciones_hilo - asignaciones_antes;
+    benchmark_restaurar(caso, mesa_llena);
+
+    qsort(muestras, (size_t)num_muestras, sizeof(long), comparar_long);
+    printf("%s,%d,%s,%d,%d,%.1f,%.3f,%ld,%ld,%ld,%ld\n", nucleo->nombre, num_fichas,
+           nucleo->usa_mesa ? caso->nombre_mesa : "-",
+           nucleo->usa_mesa ? caso->contexto.banco_apeadas.total_grupos + caso->contexto.banco_apeadas.total_escaleras : 0,
+           i, (double)total_ns / i, (double)asignaciones / i, muestras[num_muestras / 2],
+           muestras[num_muestras * 90 / 100], muestras[num_muestras * 99 / 100], muestras[num_muestras - 1]);
+}
 
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
+// Corre todos los núcleos sobre todas las manos y mesas, operaciones llamadas
+// por caso. Una fila CSV por caso en la salida estándar.
+int benchmark_nucleos(int operaciones, uint64_t semilla)
+{
+    static const int tamanos_mano[] = {14, 30, 50};
+    static caso_benchmark_t caso;
+    long *muestras = (long *)malloc(sizeof(long) * operaciones);
+    if (muestras == NULL)
+    {
+        fprintf(stderr, "Error al asignar memoria para las muestras\n");
+        exit(EXIT_FAILURE);
+    }
 
-    ch = getchar();
+    // Cada núcleo repite la misma mano: con la tabla se mediría una consulta y
+    // no el solucionador
+    tt_apagada = true;
 
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
+    long costo_reloj = benchmark_costo_reloj();
+    printf("funcion,fichas,mesa,combinaciones_mesa,operaciones,ns_op,asignaciones_op,p50_ns,p90_ns,p99_ns,max_ns\n");
 
-    if (ch != EOF)
+    for (size_t t = 0; t < sizeof(tamanos_mano) / sizeof(tamanos_mano[0]); t++)
     {
-        ungetc(ch, stdin);
-        return 1;
-    }
-    return 0;
-}
+        // Cada tamaño de mano tiene su propio mazo: semilla + t
+        benchmark_preparar(&caso, tamanos_mano[t], semilla + t);
 
-// Muestra el estado actual del juego
-void mostrar_estado_juego()
-{
-    pthread_mutex_lock(&mutex);
+        for (size_t n = 0; n < sizeof(nucleos_benchmark) / sizeof(nucleos_benchmark[0]); n++)
+        {
+            const nucleo_benchmark_t *nucleo = &nucleos_benchmark[n];
 
-    printf("\n=== ESTADO ACTUAL ===\n");
-    mostrar_banco(&banco_apeadas);
+            banco_liberar(&caso.contexto.banco_apeadas);
+            banco_inicializar(&caso.contexto.banco_apeadas);
+            caso.nombre_mesa = "vacia";
+            benchmark_medir(&caso, nucleo, tamanos_mano[t], false, operaciones, costo_reloj, muestras);
 
-    for (int i = 0; i < NUM_JUGADORES; i++)
-    {
-        printf("\nJugador %d (%s): %d fichas, %d puntos\n",
-               jugadores[i].id,
-               jugadores[i].nombre,
-               jugadores[i].mano.cantidad,
-               calcular_puntos_mano(&jugadores[i].mano));
+            if (nucleo->usa_mesa)
+            {
+                caso.nombre_mesa = "llena";
+                banco_copiar(&caso.contexto.banco_apeadas, &caso.mesa_llena);
+                benchmark_medir(&caso, nucleo, tamanos_mano[t], true, operaciones, costo_reloj, muestras);
+            }
+        }
+        benchmark_liberar(&caso);
     }
 
-    pthread_mutex_unlock(&mutex);
+    fprintf(stderr, "benchmark: semilla %llu, %d operaciones por caso, lectura del reloj %ld ns (descontada)\n",
+            (unsigned long long)semilla, operaciones, costo_reloj);
+    free(muestras);
+    return 0;
 }
 
-// Manejador de turnos (se usa en un hilo)
-void *manejar_turnos(void *arg)
+// ----------------------------------------------------------------------
+// Función Principal (Versión Mejorada)
+// ----------------------------------------------------------------------
+
+static void mostrar_uso(const char *programa)
 {
-    while (1)
-    {
-        pthread_mutex_lock(&mutex);
+    fprintf(stderr, "Uso: %s [--semilla S] [--intervalo-pcb MS] [--tabla-compartida RUTA] [--bitacora RUTA]\n", programa);
+    fprintf(stderr, "       %*s [--instantanea RUTA] [--restaurar RUTA] [--histogramas RUTA] [--perfil-cerrojos]\n",
+            (int)strlen(programa), "");
+    fprintf(stderr, "       %*s [--mcts MS [hilos]]\n", (int)strlen(programa), "");
+    fprintf(stderr, "       %s --simular N [--semilla S] [--bitacora RUTA] [--mcts MS [hilos]]\n", programa);
+    fprintf(stderr, "       %s --torneo N [hilos] [--semilla S]\n", programa);
+    fprintf(stderr, "       %s --mesas N [espera_ms] [--semilla S] [--perfil-cerrojos]\n", programa);
+    fprintf(stderr, "       %s --servidor PUERTO|RUTA [mesas] [--semilla S] [--perfil-cerrojos]\n", programa);
+    fprintf(stderr, "       %s --cliente PUERTO|RUTA [conexiones]\n", programa);
+    fprintf(stderr, "Reglas (partida, simulación, mesas, servidor y cliente):\n");
+    fprintf(stderr, "       [--jugadores 2-%d] [--fichas-iniciales N] [--barajas 1-%d] [--comodines 0-%d]\n",
+            MAX_JUGADORES, MAX_BARAJAS, MAX_COMODINES);
+    fprintf(stderr, "       %s --monitor RUTA [MS]\n", programa);
+    fprintf(stderr, "       %s --reproducir RUTA [veces]\n", programa);
+    fprintf(stderr, "       %s --benchmark [operaciones] [--semilla S]\n", programa);
+    exit(EXIT_FAILURE);
+}
 
-        // Si no hay jugadores listos, esperar
-        if (frente == final)
+int main(int argc, char *argv[])
+{
+    uint64_t semilla = (uint64_t)time(NULL);
+    bool semilla_fijada = false;
+    int partidas = 0;
+    int hilos = 0; // 0: partida interactiva
+    int intervalo_pcb = INTERVALO_PCB_MS;
+    const char *ruta_tabla = NULL;
+    const char *ruta_bitacora = NULL;
+    const char *ruta_instantanea = NULL;
+    const char *ruta_restaurar = NULL;
+    const char *ruta_histogramas_latencia = NULL;
+    bool perfil_cerrojos = false;
+    bitacora_t bitacora = {NULL};
+    int mesas = 0;
+    int espera_mesas_ms = 50;
+    const char *direccion_servidor = NULL;
+    const char *direccion_cliente = NULL;
+    int conexiones_cliente = 0; // 0: una mesa
+    int operaciones_benchmark = 0;
+    int presupuesto_mcts = 0; // 0: sin bot
+    int hilos_mcts = 0;
+    reglas_t reglas = REGLAS_ESTANDAR;
+
+    // Modos por lotes: --simular N juega N partidas automáticas en un hilo;
+    // --torneo N [hilos] las reparte entre varios hilos (por defecto uno por núcleo).
+    // --semilla S fija la semilla para repetir exactamente una partida o simulación.
+    // --intervalo-pcb MS fija cada cuánto se vuelcan los PCBs a disco (0: en cuanto cambian).
+    // --tabla-compartida RUTA publica los PCBs en un archivo mapeado; --monitor RUTA [MS] lo muestra en vivo.
+    // --bitacora RUTA registra los eventos de la partida; --reproducir RUTA [veces] la vuelve a ejecutar.
+    // --instantanea RUTA guarda el estado tras cada turno; --restaurar RUTA continúa desde él.
+    // --histogramas RUTA mide las latencias del planificador y las vuelca en RUTA al
+    // terminar la partida y con cada SIGUSR1 (kill -USR1 <pid>).
+    // --perfil-cerrojos cuenta esperas y retenciones de cada cerrojo (partida, mesas y
+    // servidor) e informa al final los más disputados.
+    // --mesas N [espera_ms] juega N partidas a la vez en un solo hilo, con jugadores
+    // automáticos que tardan hasta espera_ms en contestar cada pregunta del turno.
+    // --servidor PUERTO|RUTA [mesas] sienta a cada conexión en una mesa (TCP en 127.0.0.1
+    // o socket Unix); --cliente PUERTO|RUTA [conexiones] le mete carga y mide la latencia.
+    // --jugadores, --fichas-iniciales, --barajas y --comodines cambian las reglas de
+    // todas las partidas (el cliente las necesita para saber cuántos asientos tiene una mesa).
+    // --benchmark [operaciones] mide los núcleos de apeada y embón y escribe CSV; sin
+    // --semilla usa siempre la misma, para comparar corridas.
+    // --mcts MS [hilos] sienta en el lugar del Jugador 1 un bot que busca su jugada
+    // con MCTS durante MS milisegundos por turno (partida o --simular; por defecto un
+    // hilo de búsqueda por núcleo).
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--simular") == 0 && i + 1 < argc)
         {
-            pthread_mutex_unlock(&mutex);
-            sleep(1);
-            continue;
+            partidas = atoi(argv[++i]);
+            hilos = 1;
         }
-
-        int jugador_id = siguiente_turno(); // Obtener siguiente jugador
-
-        // Seleccionar el jugador según el modo de planificación
-        if (modo == 'F') // FCFS
+        else if (strcmp(argv[i], "--torneo") == 0 && i + 1 < argc)
         {
-            jugador_id = cola_listos[frente];      // Tomar el jugador al frente de la cola
-            frente = (frente + 1) % NUM_JUGADORES; // Avanzar el frente
+            partidas = atoi(argv[++i]);
+            hilos = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                hilos = atoi(argv[++i]);
         }
-        else if (modo == 'R') // Round Robin
+        else if (strcmp(argv[i], "--mesas") == 0 && i + 1 < argc)
         {
-            jugador_id = cola_listos[frente];      // Tomar el jugador al frente de la cola
-            frente = (frente + 1) % NUM_JUGADORES; // Avanzar el frente
-
-            // Reinsertar al final de la cola si sigue en juego
-            if (jugadores[jugador_id - 1].en_juego)
+            mesas = atoi(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                espera_mesas_ms = atoi(argv[++i]);
+            if (mesas <= 0 || espera_mesas_ms < 0)
+                mostrar_uso(argv[0]);
+        }
+        else if (strcmp(argv[i], "--servidor") == 0 && i + 1 < argc)
+        {
+            direccion_servidor = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                mesas = atoi(argv[++i]);
+            if (mesas < 0)
+                mostrar_uso(argv[0]);
+        }
+        else if (strcmp(argv[i], "--cliente") == 0 && i + 1 < argc)
+        {
+            direccion_cliente = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
             {
-                cola_listos[final] = jugador_id;
-                final = (final + 1) % NUM_JUGADORES;
+                conexiones_cliente = atoi(argv[++i]);
+                if (conexiones_cliente <= 0)
+                    mostrar_uso(argv[0]);
             }
         }
-
-        turno_actual = jugador_id;
-        jugador_t *jugador_actual = &jugadores[jugador_id - 1];
-
-        printf("\nTurno del jugador: %s (ID: %d)\n", jugador_actual->nombre, jugador_id);
-
-        // Verificar si el jugador tiene tiempo restante
-        if (jugador_actual->tiempo_restante <= 0)
+        else if (strcmp(argv[i], "--benchmark") == 0)
         {
-            printf("\nJugador %s ha perdido su turno por falta de tiempo.\n", jugador_actual->nombre);
-            pthread_mutex_unlock(&mutex);
-            continue; // Pasar al siguiente jugador
+            operaciones_benchmark = 5000;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                operaciones_benchmark = atoi(argv[++i]);
+            if (operaciones_benchmark <= 0)
+                mostrar_uso(argv[0]);
         }
-
-        // Simulación del turno
-        int tiempo_juego = (modo == 'R' && jugador_actual->tiempo_restante > QUANTUM) ? QUANTUM : jugador_actual->tiempo_restante;
-        sleep(tiempo_juego);
-        jugador_actual->tiempo_restante -= tiempo_juego;
-
-        if (jugador_actual->tiempo_restante <= 0)
+        else if (strcmp(argv[i], "--jugadores") == 0 && i + 1 < argc)
         {
-            printf("\nTiempo agotado para el jugador %s\n", jugador_actual->nombre);
+            reglas.num_jugadores = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--fichas-iniciales") == 0 && i + 1 < argc)
+        {
+            reglas.fichas_iniciales = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--barajas") == 0 && i + 1 < argc)
+        {
+            reglas.barajas = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--comodines") == 0 && i + 1 < argc)
+        {
+            reglas.comodines = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--semilla") == 0 && i + 1 < argc)
+        {
+            semilla = strtoull(argv[++i], NULL, 0);
+            semilla_fijada = true;
+        }
+        else if (strcmp(argv[i], "--intervalo-pcb") == 0 && i + 1 < argc)
+        {
+            intervalo_pcb = atoi(argv[++i]);
+            if (intervalo_pcb < 0)
+            {
+                fprintf(stderr, "Error: Intervalo de PCB inválido\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(argv[i], "--tabla-compartida") == 0 && i + 1 < argc)
+        {
+            ruta_tabla = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bitacora") == 0 && i + 1 < argc)
+        {
+            ruta_bitacora = argv[++i];
+        }
+        else if (strcmp(argv[i], "--instantanea") == 0 && i + 1 < argc)
+        {
+            ruta_instantanea = argv[++i];
+        }
+        else if (strcmp(argv[i], "--restaurar") == 0 && i + 1 < argc)
+        {
+            ruta_restaurar = argv[++i];
+        }
+        else if (strcmp(argv[i], "--histogramas") == 0 && i + 1 < argc)
+        {
+            ruta_histogramas_latencia = argv[++i];
+        }
+        else if (strcmp(argv[i], "--perfil-cerrojos") == 0)
+        {
+            perfil_cerrojos = true;
+        }
+        else if (strcmp(argv[i], "--mcts") == 0 && i + 1 < argc)
+        {
+            presupuesto_mcts = atoi(argv[++i]);
+            hilos_mcts = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                hilos_mcts = atoi(argv[++i]);
+            if (presupuesto_mcts <= 0 || hilos_mcts <= 0)
+                mostrar_uso(argv[0]);
+        }
+        else if (strcmp(argv[i], "--reproducir") == 0 && i + 1 < argc)
+        {
+            const char *ruta = argv[++i];
+            int repeticiones = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                repeticiones = atoi(argv[++i]);
+            if (repeticiones <= 0)
+                mostrar_uso(argv[0]);
+            return reproducir_bitacora(ruta, repeticiones);
+        }
+        else if (strcmp(argv[i], "--monitor") == 0 && i + 1 < argc)
+        {
+            const char *ruta = argv[++i];
+            int intervalo = 500;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                intervalo = atoi(argv[++i]);
+            if (intervalo <= 0)
+                mostrar_uso(argv[0]);
+            return monitorear_tabla(ruta, intervalo);
+        }
+        else
+        {
+            mostrar_uso(argv[0]);
         }
-
-        pthread_mutex_unlock(&mutex);
-        sleep(1);
     }
-    return NULL;
-}
 
-void mostrar_politica_actual() {
-    const char* politica = (modo == 'F') ? 
-        "FCFS (Turnos completos en orden de llegada)" : 
-        "Round Robin (Quantum de %d segundos)";
-    
-    if (modo == 'F') {
-        printf("\nPolítica actual: %s\n", politica);
-    } else {
-        printf("\nPolítica actual: ");
-        printf(politica, QUANTUM);
-        printf("\n");
+    if (!reglas_validas(&reglas))
+    {
+        fprintf(stderr, "Error: Reglas inválidas (%d jugadores de 2-%d, %d fichas iniciales, %d barajas de 1-%d, "
+                        "%d comodines de 0-%d; el mazo debe alcanzar para el reparto)\n",
+                reglas.num_jugadores, MAX_JUGADORES, reglas.fichas_iniciales, reglas.barajas, MAX_BARAJAS,
+                reglas.comodines, MAX_COMODINES);
+        exit(EXIT_FAILURE);
     }
-    printf("───────────────────────────────────────────────────────\n");
-}
 
-void elegir_politica()
-{
-    printf("\n╔════════════════════════════════════════════╗");
-    printf("\n║   SELECCIÓN DE POLÍTICA DE PLANIFICACIÓN   ║");
-    printf("\n╠════════════════════════════════════════════╣");
-    printf("\n║ F - First Come First Served (FCFS)         ║");
-    printf("\n║ R - Round Robin (Quantum %d segundos)      ║", QUANTUM);
-    printf("\n╚════════════════════════════════════════════╝");
-    printf("\nSeleccione política (F/R): ");
+    // El bot tiene una sola piscina de búsqueda: juega una partida a la vez
+    if (presupuesto_mcts > 0 && (operaciones_benchmark > 0 || direccion_cliente != NULL ||
+                                 direccion_servidor != NULL || mesas > 0 || hilos > 1))
+    {
+        fprintf(stderr, "Error: --mcts solo se puede usar en la partida interactiva o con --simular\n");
+        exit(EXIT_FAILURE);
+    }
 
-    char opcion;
-    scanf(" %c", &opcion);
-    getchar(); // Limpiar buffer
+    if (operaciones_benchmark > 0)
+        return benchmark_nucleos(operaciones_benchmark, semilla_fijada ? semilla : BENCHMARK_SEMILLA);
 
-    if (opcion == 'F' || opcion == 'f')
+    if (direccion_cliente != NULL)
     {
-        modo = 'F';
-        printf("\nPolítica cambiada a FCFS: Turnos completos en orden de llegada\n");
+        if (conexiones_cliente == 0)
+            conexiones_cliente = reglas.num_jugadores;
+        if (conexiones_cliente % reglas.num_jugadores != 0)
+        {
+            fprintf(stderr, "Error: Las conexiones deben llenar mesas de %d\n", reglas.num_jugadores);
+            exit(EXIT_FAILURE);
+        }
+        return cliente_carga(direccion_cliente, conexiones_cliente, reglas.num_jugadores);
     }
-    else if (opcion == 'R' || opcion == 'r')
+
+    if (direccion_servidor != NULL || mesas > 0)
     {
-        modo = 'R';
-        printf("\nPolítica cambiada a Round Robin: Quantum de %d segundos\n", QUANTUM);
+        inicializar_cerrojos();
+        if (perfil_cerrojos)
+            perfil_cerrojos_iniciar();
+        int estado = direccion_servidor != NULL ? servidor_mesas(direccion_servidor, mesas, semilla, &reglas)
+                                                : hospedar_mesas(mesas, semilla, espera_mesas_ms, &reglas);
+        perfil_cerrojos_informe(stderr);
+        liberar_cerrojos();
+        return estado;
     }
-    else
+
+    if (hilos != 0)
     {
-        printf("\nManteniendo política actual: %s\n",
-               (modo == 'F') ? "FCFS" : "Round Robin");
+        if (partidas <= 0 || hilos < 0)
+        {
+            fprintf(stderr, "Error: Número de partidas o de hilos inválido\n");
+            exit(EXIT_FAILURE);
+        }
+        if (ruta_bitacora != NULL && hilos != 1)
+        {
+            fprintf(stderr, "Error: La bitácora solo admite un hilo de simulación\n");
+            exit(EXIT_FAILURE);
+        }
+        if (ruta_bitacora != NULL)
+            bitacora_abrir(&bitacora, ruta_bitacora, &reglas);
+        if (presupuesto_mcts > 0)
+            mcts_iniciar(presupuesto_mcts, hilos_mcts, semilla);
+        int estado = simular_partidas(partidas, hilos, semilla, ruta_bitacora ? &bitacora : NULL, &reglas,
+                                      presupuesto_mcts > 0 ? 1 : 0);
+        mcts_informe(stdout);
+        mcts_detener();
+        bitacora_cerrar(&bitacora);
+        return estado;
+    }
+
+    // La bitácora rearma las partidas desde la semilla, no desde una instantánea
+    if (ruta_bitacora != NULL && ruta_restaurar != NULL)
+    {
+        fprintf(stderr, "Error: --bitacora no se puede usar con --restaurar\n");
+        exit(EXIT_FAILURE);
     }
 
-    mostrar_politica_actual();
-}
-
-// Función auxiliar para mostrar mensajes de robo de ficha
-void mostrar_robo_ficha(const ficha_t *ficha, bool es_automatico)
-{
-    printf("%s: %d de %s\n",
-           es_automatico ? "\nRobaste automáticamente" : "Robaste",
-           ficha->numero,
-           ficha->color);
-}
+    contexto_juego_t *ctx = &juego;
+    contexto_inicializar(ctx, &reglas);
+    ctx->semilla = semilla;
+    generador_sembrar(&ctx->generador, semilla);
+    if (ruta_bitacora != NULL)
+    {
+        bitacora_abrir(&bitacora, ruta_bitacora, &reglas);
+        ctx->bitacora = &bitacora;
+        bitacora_iniciar_partida(ctx);
+    }
 
-// ----------------------------------------------------------------------
-// Función Principal (Versión Mejorada)
-// ----------------------------------------------------------------------
-int main()
-{
-    // 1. Inicialización
-    srand(time(NULL));
-    pthread_mutex_init(&mutex, NULL);
-    pthread_mutex_init(&mutex_mesa, NULL);
-    pthread_mutex_init(&mutex_terminacion, NULL);
-    pthread_cond_init(&cond_turno, NULL);
+    // 1. Inicialización (los perfiles antes que cualquier hilo)
+    inicializar_cerrojos();
+    if (perfil_cerrojos)
+        perfil_cerrojos_iniciar();
+    if (ruta_histogramas_latencia != NULL)
+        histogramas_iniciar(ruta_histogramas_latencia);
+    if (presupuesto_mcts > 0)
+        mcts_iniciar(presupuesto_mcts, hilos_mcts, semilla);
 
     // 2. Estructuras de control
-    volatile bool juego_terminado = false;
     hilo_control_t control = {
-        .terminar_flag = &juego_terminado,
-        .mutex = &mutex_terminacion,
-        .cond = &cond_turno};
+        .terminar_flag = &ctx->terminado,
+        .mutex = &mutex_politica,
+        .cond = &cond_turno,
+        .contexto = ctx};
 
-    // 3. Inicializar juego
-    inicializar_mazo(&mazo);
-    barajar_mazo(&mazo);
-    banco_inicializar(&banco_apeadas);
-    inicializar_jugadores(&mazo);
-    inicializar_pcbs();
+    // 3. Inicializar juego (o continuar el de la instantánea)
+    if (ruta_tabla != NULL)
+        abrir_tabla_compartida(ruta_tabla);
 
-    // 4. Configurar nombres de jugadores
-    for (int i = 0; i < NUM_JUGADORES; i++)
+    if (ruta_restaurar != NULL)
     {
-        char nombre[MAX_NOMBRE];
-        printf("\nIngrese nombre para Jugador %d: ", i + 1);
+        static instantanea_t instantanea;
+        instantanea_cargar(&instantanea, ruta_restaurar);
+        instantanea_restaurar(ctx, &instantanea);
+        ctx->bots_mcts = presupuesto_mcts > 0 ? 1 : 0;
+        iniciar_escritor_pcb(intervalo_pcb);
 
-        if (fgets(nombre, MAX_NOMBRE, stdin) == NULL)
+        for (int i = 0; i < ctx->reglas.num_jugadores; i++)
+            escribir_pcb(ctx->pcbs[i]);
+        actualizar_tabla_procesos(ctx->pcbs, ctx->reglas.num_jugadores);
+
+        printf("\nPartida restaurada de %s (%d turnos jugados)\n", ruta_restaurar, ctx->turnos_terminados);
+        mostrar_politica_actual(ctx);
+        mostrar_estado_juego(ctx);
+    }
+    else
+    {
+        inicializar_mazo(&ctx->mazo, &ctx->reglas);
+        barajar_mazo(&ctx->mazo, &ctx->generador);
+        banco_inicializar(&ctx->banco_apeadas);
+        inicializar_jugadores(ctx);
+        iniciar_escritor_pcb(intervalo_pcb);
+        inicializar_pcbs(ctx);
+        ctx->bots_mcts = presupuesto_mcts > 0 ? 1 : 0;
+
+        // 4. Configurar nombres de jugadores
+        for (int i = 0; i < ctx->reglas.num_jugadores; i++)
         {
-            perror("Error leyendo nombre");
-            exit(EXIT_FAILURE);
-        }
+            char nombre[MAX_NOMBRE];
+            if (i < ctx->bots_mcts)
+                snprintf(nombre, sizeof(nombre), "MCTS %d", i + 1);
+            else
+                printf("\nIngrese nombre para Jugador %d: ", i + 1);
 
-        nombre[strcspn(nombre, "\n")] = '\0';
-        strncpy(jugadores[i].nombre, nombre, MAX_NOMBRE - 1);
-        jugadores[i].nombre[MAX_NOMBRE - 1] = '\0';
+            if (i >= ctx->bots_mcts && fgets(nombre, MAX_NOMBRE, stdin) == NULL)
+            {
+                perror("Error leyendo nombre");
+                exit(EXIT_FAILURE);
+            }
 
-        strncpy(pcbs[i].nombre, nombre, MAX_NOMBRE - 1);
-        pcbs[i].nombre[MAX_NOMBRE - 1] = '\0';
+            nombre[strcspn(nombre, "\n")] = '\0';
+            strncpy(ctx->jugadores[i].nombre, nombre, MAX_NOMBRE - 1);
+            ctx->jugadores[i].nombre[MAX_NOMBRE - 1] = '\0';
 
-        escribir_pcb(pcbs[i]);
-    }
+            strncpy(ctx->pcbs[i].nombre, nombre, MAX_NOMBRE - 1);
+            ctx->pcbs[i].nombre[MAX_NOMBRE - 1] = '\0';
 
-    mostrar_politica_actual();
-    // Elegir política de planificación
-    elegir_politica();
-    printf("\n=== JUEGO INICIADO CON POLÍTICA %s ===\n",
-           (modo == 'F') ? "FCFS" : "Round Robin");
+            escribir_pcb(ctx->pcbs[i]);
+        }
 
+        mostrar_politica_actual(ctx);
+        // Elegir política de planificación
+        elegir_politica(ctx);
+    }
+    printf("\n=== JUEGO INICIADO CON POLÍTICA %s ===\n",
+           (ctx->modo == 'F') ? "FCFS" : "Round Robin");
+    printf("Semilla de la partida: %llu\n", (unsigned long long)ctx->semilla);
     // 5. Crear hilos
     pthread_t hilo_es, hilo_planificador;
     if (pthread_create(&hilo_es, NULL, verificar_de_esperas, &control) != 0 ||
@@ -2947,6 +8423,7 @@ int main()
         perror("Error creando hilos");
         exit(EXIT_FAILURE);
     }
+    iniciar_concurrencia(ctx); // Un trabajador por jugador; el bucle les entrega los turnos
 
     // 6. Bucle principal del juego
     int ronda = 1;
@@ -2954,61 +8431,76 @@ int main()
 
     while (juego_activo)
     {
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1; // Timeout de 1 segundo
+        // Manejo de turnos: espera bloqueada hasta que haya un jugador listo
+        int jugador_actual = siguiente_turno(ctx);
+        if (jugador_actual == -1)
+            break;
+
+        jugar_turno(jugador_actual);
+        bitacora_vaciar(ctx);
+
+        // Avisar al planificador (cuenta los turnos: ninguno se pierde aunque
+        // esté ocupado al terminar este)
+        cerrojo_tomar(&mutex_politica);
+        ctx->turnos_terminados++;
+        pthread_cond_broadcast(&cond_turno);
+        cerrojo_soltar(&mutex_politica);
 
         // Verificar ganador
-        if (pthread_mutex_timedlock(&mutex, &ts) == 0)
+        cerrojo_tomar(&mutex_mazo);
+        bloquear_manos();
+        int ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, ctx->mazo.cantidad == 0);
+        desbloquear_manos();
+        cerrojo_soltar(&mutex_mazo);
+        if (ganador != -1)
         {
-            int ganador = determinar_ganador(jugadores, NUM_JUGADORES, mazo.cantidad == 0);
-            if (ganador != -1)
-            {
-                printf("\n¡Jugador %d (%s) ha ganado!\n", jugadores[ganador].id, jugadores[ganador].nombre);
-                juego_activo = false;
-            }
-            pthread_mutex_unlock(&mutex);
+            printf("\n¡Jugador %d (%s) ha ganado!\n", ctx->jugadores[ganador].id, ctx->jugadores[ganador].nombre);
+            juego_activo = false;
         }
-
-        // Manejo de turnos
-        int jugador_actual = siguiente_turno();
-        if (jugador_actual != -1)
+        else if (ctx->jugadores[jugador_actual - 1].en_juego)
         {
-            jugador_thread(&jugadores[jugador_actual - 1]);
+            mover_a_cola_de_esperas(ctx, jugador_actual);
+        }
 
-            // Control de rondas
-            static int turnos_en_ronda = 0;
-            if (++turnos_en_ronda >= NUM_JUGADORES)
-            {
-                printf("\n=== Fin de ronda %d ===\n", ronda++);
-                turnos_en_ronda = 0;
-                elegir_politica();
-                mostrar_estado_juego();
-            }
+        // Punto de control entre turnos: el escritor lo guarda sin frenar el juego
+        if (ruta_instantanea != NULL)
+        {
+            bloquear_partida();
+            programar_instantanea(ctx, ruta_instantanea);
+            desbloquear_partida();
         }
-        else
+
+        // Control de rondas
+        static int turnos_en_ronda = 0;
+        if (juego_activo && ++turnos_en_ronda >= ctx->reglas.num_jugadores)
         {
-            reiniciar_cola_listos();
-            nanosleep((const struct timespec[]){{0, 100000000}}, NULL); // 100ms
+            printf("\n=== Fin de ronda %d ===\n", ronda++);
+            turnos_en_ronda = 0;
+            elegir_politica(ctx);
+            mostrar_estado_juego(ctx);
         }
     }
 
     // 7. Finalización
-    pthread_mutex_lock(&mutex_terminacion);
-    juego_terminado = true;
-    pthread_mutex_unlock(&mutex_terminacion);
-
-    pthread_cond_broadcast(&cond_turno);
+    terminar_juego(ctx);
+    detener_concurrencia();
+    mcts_informe(stdout);
+    mcts_detener();
     pthread_join(hilo_es, NULL);
     pthread_join(hilo_planificador, NULL);
+    detener_escritor_pcb(); // Vuelca los últimos PCBs y la tabla
+    cerrar_tabla_compartida();
+    histogramas_terminar();
+    perfil_cerrojos_informe(stderr);
+
+    int ganador = determinar_ganador(ctx->jugadores, ctx->reglas.num_jugadores, ctx->mazo.cantidad == 0);
+    bitacora_registrar(ctx, EVENTO_FIN, ganador + 1, 0, ctx->mazo.cantidad == 0);
+    bitacora_cerrar(ctx->bitacora);
 
     // 8. Liberar recursos
-    banco_liberar(&banco_apeadas);
-    liberar_jugadores();
-    pthread_mutex_destroy(&mutex);
-    pthread_mutex_destroy(&mutex_mesa);
-    pthread_mutex_destroy(&mutex_terminacion);
-    pthread_cond_destroy(&cond_turno);
+    banco_liberar(&ctx->banco_apeadas);
+    liberar_jugadores(ctx);
+    liberar_cerrojos();
 
     return 0;
 }
\ No newline at end of file